@@ -0,0 +1,175 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Measures how fast the CPU core runs a workload, in emulated MHz not
+// counting cycles skipped in idle loops and in millions of instructions
+// retired per second. The machine runs unthrottled on its own thread while
+// this one types the workload's input and takes its output, as the UI
+// thread would. With -compare the workload
+// is run interpreted and then translated, and cpubench fails unless the JIT
+// comes out ahead. Built as cpubench-switch, it runs the core with the
+// switch dispatch instead of the threaded one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+#include "clock.h"
+#include "config.h"
+#include "configuration.h"
+#include "m6502.h"
+#include "memory.h"
+#include "pia6820.h"
+#include "terminal.h"
+
+#define DEFAULT_CYCLES 400000000LL
+
+#ifdef POM1_SWITCH_DISPATCH
+#define DISPATCH "switch"
+#else
+#define DISPATCH "threaded"
+#endif
+
+// The input is typed once, or over and over when repeat is set.
+typedef struct
+{
+	const char *name;
+	const char *input;
+	int repeat;
+} Workload;
+
+static const Workload workloads[] =
+{
+	// The monitor dumping the whole address space.
+	{ "monitor", "0.FFFF\r", 1 },
+	// Integer BASIC running nested loops of arithmetic for good.
+	{ "basic", "E000R\r10 FOR I=1 TO 100\r20 FOR J=1 TO 100\r30 A=I*J+A/7\r40 NEXT J\r50 NEXT I\r60 GOTO 10\rRUN\r", 0 }
+};
+
+static const Workload *findWorkload(const char *name)
+{
+	int i;
+
+	for (i = 0; i < (int)(sizeof(workloads) / sizeof(workloads[0])); i++)
+		if (!strcmp(workloads[i].name, name))
+			return &workloads[i];
+
+	return NULL;
+}
+
+// Types as much of the input from position on as the keyboard ring takes,
+// with bit 7 set as the keyboard would, and returns the new position.
+static int typeInput(Machine *machine, const Workload *workload, int position)
+{
+	unsigned char keys[PIA_RING_SIZE];
+	int length = (int)strlen(workload->input), count = 0;
+
+	while (count < PIA_RING_SIZE && (position + count < length || workload->repeat))
+	{
+		keys[count] = (unsigned char)(workload->input[(position + count) % length] | 0x80);
+		count++;
+	}
+
+	position += writeKeyboardInput(machine, keys, count);
+
+	return workload->repeat ? position % length : position;
+}
+
+// Runs the workload on a new machine and returns the instructions it
+// retired per second, or 0 if the machine could not be created.
+static double runWorkload(const Workload *workload, int jit, long long cycles)
+{
+	long long start, nanos, elapsed, instructions, skippedCycles, idleMillis;
+	unsigned int idleWaits;
+	int position = 0;
+	Machine *machine = createMachine();
+
+	if (!machine)
+		return 0;
+
+	resetMemory(machine);
+	setJit(machine, jit);
+	setSpeed(machine, 1000, 10);
+	setSpeedMultiplier(machine, 0);
+	resetM6502(machine);
+
+	start = readClock();
+	startM6502(machine);
+
+	while (getElapsedCycles(machine) < cycles)
+	{
+		position = typeInput(machine, workload, position);
+
+		while (updateTerminal(machine, PIA_RING_SIZE));
+
+		SDL_Delay(1);
+	}
+
+	// The counters are read once the CPU thread has stopped, so they cover
+	// the same stretch as the time.
+	stopM6502(machine);
+	nanos = readClock() - start;
+	elapsed = getElapsedCycles(machine);
+	instructions = getInstructionCount(machine);
+	getIdleCounters(machine, &skippedCycles, &idleMillis, &idleWaits);
+
+	printf("%s%s, %s dispatch: %lld cycles, %lld instructions in %.3f s, %.1f MHz, %.1f MIPS (%lld cycles skipped idle)\n", workload->name, getJit(machine) ? " (jit)" : "", DISPATCH, elapsed, instructions, nanos / 1e9, (elapsed - skippedCycles) * 1000.0 / nanos, instructions * 1000.0 / nanos, skippedCycles);
+
+	destroyMachine(machine);
+
+	return instructions * 1e9 / nanos;
+}
+
+int main(int argc, char *argv[])
+{
+	int jit = argc > 1 && !strcmp(argv[1], "-jit"), compare = argc > 1 && !strcmp(argv[1], "-compare"), failed = 0;
+	const Workload *workload = findWorkload(argc > 1 + jit + compare ? argv[1 + jit + compare] : "monitor");
+	long long cycles = argc > 2 + jit + compare ? atoll(argv[2 + jit + compare]) : DEFAULT_CYCLES;
+	double interpreted, translated;
+
+	if (!workload || cycles <= 0)
+	{
+		fprintf(stderr, "usage: cpubench [-jit|-compare] [monitor|basic] [cycles]\n");
+		return 1;
+	}
+
+	setRomDirectory(ROMDIR);
+
+	if (!compare)
+		failed = !runWorkload(workload, jit, cycles);
+	else
+	{
+		interpreted = runWorkload(workload, 0, cycles);
+		translated = runWorkload(workload, 1, cycles);
+
+		if (interpreted && translated)
+		{
+			printf("%s: the jit runs %.2f times as many instructions per second as the interpreter\n", workload->name, translated / interpreted);
+			failed = translated <= interpreted;
+		}
+		else
+			failed = 1;
+
+		if (failed)
+			fprintf(stderr, "cpubench: the jit is no faster than the interpreter\n");
+	}
+
+	freeRomDirectory();
+
+	return failed;
+}
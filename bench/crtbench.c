@@ -0,0 +1,129 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Times the CRT filter over the whole screen at scale 5, which is how a
+// 1920x1080 display shows the 280x192 screen, and at scale 6. Fails when
+// the median pass at either goes over CRT_BUDGET_NANOS.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "SDL.h"
+#include "clock.h"
+#include "crt.h"
+
+#define DEFAULT_PASSES 200
+
+typedef struct
+{
+	int scale, scanlines;
+} Setting;
+
+static const Setting settings[] =
+{
+	{ 5, 0 },
+	{ 5, 1 },
+	{ 6, 0 },
+	{ 6, 1 }
+};
+
+static Uint8 native[192][280];
+
+// About a third of the dots lit, in runs and gaps of varying length, as
+// a screen full of text would have them.
+static void fillNative(void)
+{
+	int x, y;
+
+	for (y = 0; y < 192; y++)
+		for (x = 0; x < 280; x++)
+			native[y][x] = (x * 7 + y * 3) % 11 < 4 && y % 8 != 7 ? 1 : 0;
+}
+
+static int compareNanos(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int runSetting(const Setting *setting, long long *nanos, int passes)
+{
+	int pitch = 280 * setting->scale, i;
+	Uint8 *pixels = (Uint8 *)malloc(pitch * 192 * setting->scale);
+	long long start, median;
+
+	if (!pixels)
+	{
+		fprintf(stderr, "stderr: Could not allocate memory block\n");
+		exit(1);
+	}
+
+	// The first pass builds the tables and touches the window for the
+	// first time, which a running emulator only does once.
+	filterCrt(pixels, pitch, native[0], 280, setting->scale, setting->scanlines, 0, 0, 280, 192);
+
+	for (i = 0; i < passes; i++)
+	{
+		start = readClock();
+		filterCrt(pixels, pitch, native[0], 280, setting->scale, setting->scanlines, 0, 0, 280, 192);
+		nanos[i] = readClock() - start;
+	}
+
+	free(pixels);
+
+	qsort(nanos, passes, sizeof(nanos[0]), compareNanos);
+	median = nanos[passes / 2];
+
+	printf("%dx%d%s: median %lld us, slowest %lld us, budget %lld us\n", 280 * setting->scale, 192 * setting->scale, setting->scanlines ? " with scanlines" : "", median / 1000, nanos[passes - 1] / 1000, CRT_BUDGET_NANOS / 1000);
+
+	return median <= CRT_BUDGET_NANOS;
+}
+
+int main(int argc, char *argv[])
+{
+	int i, passes = argc > 1 ? atoi(argv[1]) : DEFAULT_PASSES, failed = 0;
+	long long *nanos;
+
+	if (argc > 2 || passes < 1)
+	{
+		fprintf(stderr, "usage: crtbench [passes]\n");
+		return 1;
+	}
+
+	nanos = (long long *)malloc(passes * sizeof(nanos[0]));
+
+	if (!nanos)
+	{
+		fprintf(stderr, "stderr: Could not allocate memory block\n");
+		return 1;
+	}
+
+	fillNative();
+
+	for (i = 0; i < (int)(sizeof(settings) / sizeof(settings[0])); i++)
+		if (!runSetting(&settings[i], nanos, passes))
+			failed = 1;
+
+	stopCrt();
+	free(nanos);
+
+	if (failed)
+		fprintf(stderr, "crtbench: the CRT filter is over its budget\n");
+
+	return failed;
+}
@@ -0,0 +1,237 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Measures how long the renderer takes to draw the whole terminal again,
+// as it does after a mode change or a clear screen, with the line kernels
+// picked for this CPU and with the scalar ones, next to drawing it a dot at
+// a time with SDL_FillRect() as drawCharac() does. It then scrolls the
+// terminal a line at a time, with and without the CRT filter, and fails
+// unless the window ends up as a full redraw of the same frame draws it.
+// The renderer is private to screen.c, so it is built in here and drawn
+// into a surface of the size the window would have.
+
+#include "screen.c"
+
+#define DEFAULT_REDRAWS 2000
+#define SCROLLS 200
+
+typedef struct
+{
+	int pixelSize, scanlines;
+} Setting;
+
+static const Setting settings[] =
+{
+	{ 1, 0 },
+	{ 2, 0 },
+	{ 2, 1 },
+	{ 4, 0 },
+	{ 4, 1 },
+	{ 6, 0 },
+	{ 6, 1 }
+};
+
+// Every cell holds a different character from the one above or beside it,
+// so no row is drawn from a single glyph.
+static void fillFrame(Frame *frame)
+{
+	int i, j;
+
+	memset(frame, 0, sizeof(*frame));
+
+	for (j = 0; j < 24; j++)
+		for (i = 0; i < 40; i++)
+			frame->cells[j][i] = (unsigned char)(0xA0 + (i * 7 + j * 3) % 64);
+}
+
+static long long drawDots(const Frame *frame, int redraws)
+{
+	Uint32 color = SDL_MapRGB(screen->format, 0, 255, 0);
+	long long start = readClock();
+	int n, i, j;
+
+	for (n = 0; n < redraws; n++)
+	{
+		SDL_FillRect(screen, NULL, 0);
+
+		for (j = 0; j < 24; j++)
+			for (i = 0; i < 40; i++)
+				drawCharac(screen, i * 7 * pixelSize, j * 8 * pixelSize, color, frame->cells[j][i] & 0x7F);
+	}
+
+	return readClock() - start;
+}
+
+static long long drawFrames(Frame *frame, int redraws)
+{
+	SDL_Rect rects[24];
+	long long start = readClock();
+	int i;
+
+	for (i = 0; i < redraws; i++)
+	{
+		frame->redraws++;
+		renderFrame(frame, rects);
+	}
+
+	return readClock() - start;
+}
+
+static void createScreen(const Setting *setting)
+{
+	screen = SDL_CreateRGBSurface(0, 280 * setting->pixelSize, 192 * setting->pixelSize, 8, 0, 0, 0, 0);
+
+	if (!screen)
+	{
+		fprintf(stderr, "stderr: Could not create a %dx%d surface\n", 280 * setting->pixelSize, 192 * setting->pixelSize);
+		exit(1);
+	}
+}
+
+static void runSetting(const Setting *setting, int redraws)
+{
+	Frame frame;
+	long long nanos, scalarNanos, dotNanos;
+
+	createScreen(setting);
+
+	setScale();
+	fillFrame(&frame);
+	frame.scanlines = setting->scanlines;
+	memset(&shown, 0, sizeof(shown));
+
+	expandLine = expandLineScalar;
+	scaleLine = scaleLineScalar;
+	scalarNanos = drawFrames(&frame, redraws);
+	selectLineKernels();
+	nanos = drawFrames(&frame, redraws);
+
+	pixelSize = setting->pixelSize;
+	_scanlines = setting->scanlines;
+	dotNanos = drawDots(&frame, redraws);
+
+	printf("pixel size %d%s: %.1f us per full redraw, %.1f us with the scalar kernels, %.1f us a dot at a time\n", setting->pixelSize, setting->scanlines ? " with scanlines" : "", nanos / 1000.0 / redraws, scalarNanos / 1000.0 / redraws, dotNanos / 1000.0 / redraws);
+
+	SDL_FreeSurface(screen);
+	screen = NULL;
+}
+
+// Moves every row of the frame up a line and fills the new bottom one, as
+// output past the last line of the terminal does.
+static void scrollFrame(Frame *frame, int n)
+{
+	int i;
+
+	memmove(frame->cells[0], frame->cells[1], 23 * 40);
+
+	for (i = 0; i < 40; i++)
+		frame->cells[23][i] = (unsigned char)(i < n % 40 ? 0xA0 + (i * 5 + n) % 64 : 0xA0);
+
+	frame->topLine++;
+}
+
+static int runScroll(const Setting *setting, int crt)
+{
+	SDL_Rect rects[24];
+	Frame frame;
+	Uint8 *scrolled;
+	long long start, nanos = 0;
+	int i, size, mismatches = 0;
+
+	createScreen(setting);
+	size = screen->pitch * screen->h;
+	scrolled = (Uint8 *)malloc(size);
+
+	if (!scrolled)
+	{
+		fprintf(stderr, "stderr: Could not allocate memory block\n");
+		exit(1);
+	}
+
+	setScale();
+	selectLineKernels();
+	fillFrame(&frame);
+	frame.scanlines = setting->scanlines;
+	frame.crt = crt;
+	memset(&shown, 0, sizeof(shown));
+	frame.redraws++;
+	renderFrame(&frame, rects);
+
+	for (i = 0; i < SCROLLS; i++)
+	{
+		scrollFrame(&frame, i);
+
+		start = readClock();
+		renderFrame(&frame, rects);
+		nanos += readClock() - start;
+
+		memcpy(scrolled, screen->pixels, size);
+		frame.redraws++;
+		renderFrame(&frame, rects);
+
+		if (memcmp(scrolled, screen->pixels, size))
+			mismatches++;
+	}
+
+	printf("pixel size %d%s%s: %.1f us per line scrolled\n", setting->pixelSize, setting->scanlines ? " with scanlines" : "", crt ? " through the CRT filter" : "", nanos / 1000.0 / SCROLLS);
+
+	if (mismatches)
+		fprintf(stderr, "screenbench: pixel size %d%s%s: %d of %d scrolls differ from a full redraw\n", setting->pixelSize, setting->scanlines ? " with scanlines" : "", crt ? " through the CRT filter" : "", mismatches, SCROLLS);
+
+	free(scrolled);
+	SDL_FreeSurface(screen);
+	screen = NULL;
+
+	return !mismatches;
+}
+
+int main(int argc, char *argv[])
+{
+	int i, redraws = argc > 1 ? atoi(argv[1]) : DEFAULT_REDRAWS, failed = 0;
+
+	if (argc > 2 || redraws < 1)
+	{
+		fprintf(stderr, "usage: screenbench [redraws]\n");
+		return 1;
+	}
+
+	setRomDirectory(ROMDIR);
+
+	if (!loadCharMap())
+	{
+		fprintf(stderr, "stderr: Could not load character map\n");
+		return 1;
+	}
+
+	freeRomDirectory();
+
+	for (i = 0; i < (int)(sizeof(settings) / sizeof(settings[0])); i++)
+		runSetting(&settings[i], redraws);
+
+	for (i = 0; i < (int)(sizeof(settings) / sizeof(settings[0])); i++)
+	{
+		if (!runScroll(&settings[i], 0))
+			failed = 1;
+		if (settings[i].pixelSize > 1 && !runScroll(&settings[i], 1))
+			failed = 1;
+	}
+
+	stopCrt();
+
+	return failed;
+}
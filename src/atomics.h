@@ -0,0 +1,54 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef __ATOMICS_H__
+#define __ATOMICS_H__
+
+#include "config.h"
+
+// Indices shared between two threads without a lock: the PIA rings between
+// the CPU and UI threads, the frame slots between the UI and render threads,
+// and the CPU's deadline, which any thread may drop to 0.
+#if defined(HAVE_STDATOMIC_H) && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+typedef atomic_uint AtomicIndex;
+#define loadRelaxed(index) atomic_load_explicit(index, memory_order_relaxed)
+#define loadAcquire(index) atomic_load_explicit(index, memory_order_acquire)
+#define storeRelaxed(index, value) atomic_store_explicit(index, value, memory_order_relaxed)
+#define storeRelease(index, value) atomic_store_explicit(index, value, memory_order_release)
+#define exchange(index, value) atomic_exchange(index, value)
+#elif defined(__GNUC__)
+typedef unsigned int AtomicIndex;
+#define loadRelaxed(index) __atomic_load_n(index, __ATOMIC_RELAXED)
+#define loadAcquire(index) __atomic_load_n(index, __ATOMIC_ACQUIRE)
+#define storeRelaxed(index, value) __atomic_store_n(index, value, __ATOMIC_RELAXED)
+#define storeRelease(index, value) __atomic_store_n(index, value, __ATOMIC_RELEASE)
+#define exchange(index, value) __atomic_exchange_n(index, value, __ATOMIC_SEQ_CST)
+#elif defined(_WIN32)
+#include <windows.h>
+typedef volatile LONG AtomicIndex;
+#define loadRelaxed(index) ((unsigned int)*(index))
+#define loadAcquire(index) ((unsigned int)InterlockedCompareExchange(index, 0, 0))
+#define storeRelaxed(index, value) (*(index) = (LONG)(value))
+#define storeRelease(index, value) InterlockedExchange(index, (LONG)(value))
+#define exchange(index, value) ((unsigned int)InterlockedExchange(index, (LONG)(value)))
+#else
+#error "No atomic operations available"
+#endif
+
+#endif
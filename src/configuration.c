@@ -19,8 +19,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "crt.h"
 #include "screen.h"
 #include "memory.h"
+#include "terminal.h"
 
 static char *_romdir;
 
@@ -42,7 +44,7 @@ const char *getRomDirectory(void)
 	return _romdir;
 }
 
-void loadConfiguration(void)
+void loadConfiguration(Machine *machine)
 {
 	FILE *fp;
 	char *configdir, *filename, buffer[256], *value;
@@ -82,29 +84,33 @@ void loadConfiguration(void)
 			value = strrchr(buffer, '=') + 1;
 			*(strrchr(buffer, '=')) = '\0';
 
-			if (!strcmp(buffer, "pixelSize"))
-				setPixelSize(value[0] & 0x03);
+			if (!strcmp(buffer, "pixelSize") && atoi(value) >= 1 && atoi(value) <= MAX_PIXEL_SIZE)
+				setPixelSize(atoi(value));
 			else if (!strcmp(buffer, "scanlines"))
 				setScanlines(value[0] & 0x01);
 			else if (!strcmp(buffer, "terminalSpeed"))
 				setTerminalSpeed(atoi(value));
 			else if (!strcmp(buffer, "ram8k"))
-				setRam8k(value[0] & 0x01);
+				setRam8k(machine, value[0] & 0x01);
 			else if (!strcmp(buffer, "writeInRom"))
-				setWriteInRom(value[0] & 0x01);
+				setWriteInRom(machine, value[0] & 0x01);
 			else if (!strcmp(buffer, "fullscreen"))
 				setFullscreen(value[0] & 0x01);
 			else if (!strcmp(buffer, "blinkCursor"))
 				setBlinkCursor(value[0] & 0x01);
 			else if (!strcmp(buffer, "blockCursor"))
 				setBlockCursor(value[0] & 0x01);
+			else if (!strcmp(buffer, "crt"))
+				setCrt(value[0] & 0x01);
+			else if (!strcmp(buffer, "scrollback") && atoi(value) >= 0 && atoi(value) <= 10000)
+				setScrollback(machine, atoi(value));
 		}
 
 		fclose(fp);
 	}
 }
 
-void saveConfiguration(void)
+void saveConfiguration(Machine *machine)
 {
 	FILE *fp;
 	char *configdir, *filename, buffer[256];
@@ -136,9 +142,7 @@ void saveConfiguration(void)
 		fputs("// Pom1 Configuration\n", fp);
 
 		strcpy(buffer, "pixelSize=");
-		buffer[10] = getPixelSize() | 0x30;
-		buffer[11] = '\n';
-		buffer[12] = '\0';
+		sprintf(&buffer[10], "%d\n", getPixelSize());
 		fputs(buffer, fp);
 
 		strcpy(buffer, "scanlines=");
@@ -152,13 +156,13 @@ void saveConfiguration(void)
 		fputs(buffer, fp);
 
 		strcpy(buffer, "ram8k=");
-		buffer[6] = getRam8k() | 0x30;
+		buffer[6] = getRam8k(machine) | 0x30;
 		buffer[7] = '\n';
 		buffer[8] = '\0';
 		fputs(buffer, fp);
 
 		strcpy(buffer, "writeInRom=");
-		buffer[11] = getWriteInRom() | 0x30;
+		buffer[11] = getWriteInRom(machine) | 0x30;
 		buffer[12] = '\n';
 		buffer[13] = '\0';
 		fputs(buffer, fp);
@@ -181,6 +185,16 @@ void saveConfiguration(void)
 		buffer[14] = '\0';
 		fputs(buffer, fp);
 
+		strcpy(buffer, "crt=");
+		buffer[4] = getCrt() | 0x30;
+		buffer[5] = '\n';
+		buffer[6] = '\0';
+		fputs(buffer, fp);
+
+		strcpy(buffer, "scrollback=");
+		sprintf(&buffer[11], "%d\n", getScrollback(machine));
+		fputs(buffer, fp);
+
 		fclose(fp);
 	}
 }
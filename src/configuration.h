@@ -19,10 +19,12 @@
 #ifndef __CONFIGURATION_H__
 #define __CONFIGURATION_H__
 
+#include "machine.h"
+
 void freeRomDirectory(void);
 void setRomDirectory(const char *romdir);
 const char *getRomDirectory(void);
-void loadConfiguration(void);
-void saveConfiguration(void);
+void loadConfiguration(Machine *machine);
+void saveConfiguration(Machine *machine);
 
 #endif
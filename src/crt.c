@@ -0,0 +1,340 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <math.h>
+#include <string.h>
+#include "SDL.h"
+#include "clock.h"
+#include "crt.h"
+#include "display.h"
+#include "config.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define CRT_FIRST_COLOR 128
+#define CRT_SHADES 64
+#define CRT_MAX_WORKERS 4
+#define CRT_MIN_PARALLEL 4096
+
+#define CRT_BASE 0.8
+#define CRT_GLOW 0.5
+#define CRT_SPREAD 0.3
+
+static int _crt = 0;
+
+// Every output pixel is looked up from the 3x3 neighbourhood of the native
+// pixel it belongs to, as a 9 bit pattern, and its place within that pixel.
+// Each entry is padded to 16 bytes so most of them can be copied whole.
+static Uint8 lut[512][16][16];
+static int lutScale, lutScanlines;
+
+static SDL_Thread *workers[CRT_MAX_WORKERS - 1];
+static SDL_mutex *jobMutex;
+static SDL_cond *jobCond, *doneCond;
+static int workerCount, generation, pending, stopping;
+
+static struct
+{
+	Uint8 *pixels;
+	const Uint8 *native;
+	int pitch, nativePitch, scale, x, y, width, height, bands;
+} job;
+
+static unsigned int passes;
+static long long maxNanos;
+
+void setCrt(int crt)
+{
+	_crt = crt;
+}
+
+int getCrt(void)
+{
+	return _crt;
+}
+
+// Installs the phosphor shades in a range of the 8-bit palette the rest of
+// the emulator leaves alone. The brightest turn slightly white, as a real
+// tube blooms.
+void initCrt(SDL_Surface *screen)
+{
+	SDL_Color shades[CRT_SHADES];
+	int i, g;
+
+	if (!screen->format->palette)
+		return;
+
+	for (i = 0; i < CRT_SHADES; i++)
+	{
+		g = i * 255 / (CRT_SHADES - 1);
+		shades[i].r = shades[i].b = (Uint8)(g > 200 ? g - 200 : 0);
+		shades[i].g = (Uint8)g;
+	}
+
+	setDisplayColors(shades, CRT_FIRST_COLOR, CRT_SHADES);
+}
+
+// A lit pixel glows at CRT_BASE and every lit neighbour spreads light that
+// fades with the distance from its edge, so dense text blooms brighter and
+// dots bleed into the dark around them. The rows of each pixel dim towards
+// its top and bottom, more so with scanlines on.
+static void buildLut(int scale, int scanlines)
+{
+	double u, v, ex, ey, light, depth = scanlines ? 0.7 : 0.35;
+	int pattern, r, p, dx, dy, shade;
+
+	for (pattern = 0; pattern < 512; pattern++)
+	{
+		for (r = 0; r < scale; r++)
+		{
+			for (p = 0; p < scale; p++)
+			{
+				u = (p + 0.5) / scale - 0.5;
+				v = (r + 0.5) / scale - 0.5;
+				light = (pattern & 0x10) ? CRT_BASE : 0.0;
+
+				for (dy = -1; dy <= 1; dy++)
+				{
+					for (dx = -1; dx <= 1; dx++)
+					{
+						if ((!dx && !dy) || !(pattern & (1 << ((dy + 1) * 3 + dx + 1))))
+							continue;
+
+						ex = fabs(u - dx) - 0.5;
+						ey = fabs(v - dy) - 0.5;
+						ex = ex > 0.0 ? ex : 0.0;
+						ey = ey > 0.0 ? ey : 0.0;
+						light += CRT_GLOW * exp(-(ex * ex + ey * ey) / (CRT_SPREAD * CRT_SPREAD));
+					}
+				}
+
+				light *= 1.0 - depth * 4.0 * v * v;
+				shade = (int)((light > 1.0 ? 1.0 : light) * (CRT_SHADES - 1) + 0.5);
+				lut[pattern][r][p] = (Uint8)(shade ? CRT_FIRST_COLOR + shade : 0);
+			}
+		}
+	}
+
+	lutScale = scale;
+	lutScanlines = scanlines;
+}
+
+static int isLit(int x, int y)
+{
+	return x >= 0 && x < 280 && y >= 0 && y < 192 && job.native[y * job.nativePitch + x];
+}
+
+// Filters the native rows of one band of the job. Pixels are copied 16
+// bytes at a time left to right, each overwriting what the one before it
+// wrote past its own width; those too close to the right end of the
+// rectangle for that are copied exactly.
+static void filterBand(int band)
+{
+	int patterns[280], rows[3][282];
+	int from = job.y + job.height * band / job.bands, to = job.y + job.height * (band + 1) / job.bands;
+	int nx, ny, r, k, last = job.x + job.width - 1, wide = last + 1 - (15 + job.scale) / job.scale;
+	Uint8 *out;
+
+	for (ny = from; ny < to; ny++)
+	{
+		for (k = 0; k < 3; k++)
+			for (nx = job.x - 1; nx <= last + 1; nx++)
+				rows[k][nx + 1] = isLit(nx, ny + k - 1);
+
+		for (nx = job.x; nx <= last; nx++)
+			patterns[nx] = rows[0][nx] | rows[0][nx + 1] << 1 | rows[0][nx + 2] << 2 | rows[1][nx] << 3 | rows[1][nx + 1] << 4 | rows[1][nx + 2] << 5 | rows[2][nx] << 6 | rows[2][nx + 1] << 7 | rows[2][nx + 2] << 8;
+
+		for (r = 0; r < job.scale; r++)
+		{
+			out = job.pixels + (ny * job.scale + r) * job.pitch + job.x * job.scale;
+
+			for (nx = job.x; nx <= wide; nx++, out += job.scale)
+				memcpy(out, lut[patterns[nx]][r], 16);
+
+			for (; nx <= last; nx++, out += job.scale)
+				memcpy(out, lut[patterns[nx]][r], job.scale);
+		}
+	}
+}
+
+static int runWorker(void *data)
+{
+	int band = (int)(size_t)data, seen = 0;
+
+	SDL_mutexP(jobMutex);
+
+	while (1)
+	{
+		while (generation == seen && !stopping)
+			SDL_CondWait(jobCond, jobMutex);
+
+		if (stopping)
+			break;
+
+		seen = generation;
+		SDL_mutexV(jobMutex);
+
+		if (band < job.bands)
+			filterBand(band);
+
+		SDL_mutexP(jobMutex);
+
+		if (!--pending)
+			SDL_CondSignal(doneCond);
+	}
+
+	SDL_mutexV(jobMutex);
+
+	return 0;
+}
+
+static int countProcessors(void)
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+
+	return (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+	return 1;
+#endif
+}
+
+// One worker fewer than there are processors, up to CRT_MAX_WORKERS in all
+// with the calling thread, which always takes a band itself.
+static void startWorkers(void)
+{
+	int count = countProcessors();
+
+	if (count > CRT_MAX_WORKERS)
+		count = CRT_MAX_WORKERS;
+
+	jobMutex = SDL_CreateMutex();
+	jobCond = SDL_CreateCond();
+	doneCond = SDL_CreateCond();
+
+	for (workerCount = 0; workerCount < count - 1; workerCount++)
+	{
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+		workers[workerCount] = SDL_CreateThread(runWorker, "crt", (void *)(size_t)(workerCount + 1));
+#else
+		workers[workerCount] = SDL_CreateThread(runWorker, (void *)(size_t)(workerCount + 1));
+#endif
+
+		if (!workers[workerCount])
+			break;
+	}
+}
+
+void stopCrt(void)
+{
+	int i;
+
+	if (!jobMutex)
+		return;
+
+	SDL_mutexP(jobMutex);
+	stopping = 1;
+	SDL_CondBroadcast(jobCond);
+	SDL_mutexV(jobMutex);
+
+	for (i = 0; i < workerCount; i++)
+		SDL_WaitThread(workers[i], NULL);
+
+	SDL_DestroyCond(doneCond);
+	SDL_DestroyCond(jobCond);
+	SDL_DestroyMutex(jobMutex);
+	jobMutex = NULL;
+	workerCount = 0;
+}
+
+// Draws a rectangle of native pixels into the window, scale times over,
+// through the CRT filter. pixels points at the window pixel of native pixel
+// 0, 0. Rectangles big enough to be worth it are split into bands of rows
+// shared with the workers; whole screens are timed for getCrtStats().
+void filterCrt(Uint8 *pixels, int pitch, const Uint8 *native, int nativePitch, int scale, int scanlines, int x, int y, int width, int height)
+{
+	long long start, nanos;
+
+	if (width <= 0 || height <= 0)
+		return;
+
+	if (scale != lutScale || scanlines != lutScanlines)
+		buildLut(scale, scanlines);
+
+	if (!jobMutex && width * height >= CRT_MIN_PARALLEL)
+		startWorkers();
+
+	start = readClock();
+
+	job.pixels = pixels;
+	job.native = native;
+	job.pitch = pitch;
+	job.nativePitch = nativePitch;
+	job.scale = scale;
+	job.x = x;
+	job.y = y;
+	job.width = width;
+	job.height = height;
+	job.bands = width * height >= CRT_MIN_PARALLEL ? workerCount + 1 : 1;
+
+	if (job.bands > height)
+		job.bands = height;
+
+	if (job.bands == 1)
+		filterBand(0);
+	else
+	{
+		SDL_mutexP(jobMutex);
+		pending = workerCount;
+		generation++;
+		SDL_CondBroadcast(jobCond);
+		SDL_mutexV(jobMutex);
+
+		filterBand(0);
+
+		SDL_mutexP(jobMutex);
+
+		while (pending)
+			SDL_CondWait(doneCond, jobMutex);
+
+		SDL_mutexV(jobMutex);
+	}
+
+	if (width == 280 && height == 192)
+	{
+		nanos = readClock() - start;
+		passes++;
+
+		if (nanos > maxNanos)
+			maxNanos = nanos;
+	}
+}
+
+void getCrtStats(unsigned int *crtPasses, long long *crtMaxNanos)
+{
+	*crtPasses = passes;
+	*crtMaxNanos = maxNanos;
+}
@@ -0,0 +1,35 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef __CRT_H__
+#define __CRT_H__
+
+#include "SDL.h"
+
+// What filtering a whole screen may take at the scale a 1920x1080 display
+// gets, checked by bench/crtbench.
+#define CRT_BUDGET_NANOS 2000000LL
+
+void setCrt(int crt);
+int getCrt(void);
+void initCrt(SDL_Surface *screen);
+void filterCrt(Uint8 *pixels, int pitch, const Uint8 *native, int nativePitch, int scale, int scanlines, int x, int y, int width, int height);
+void getCrtStats(unsigned int *passes, long long *maxNanos);
+void stopCrt(void);
+
+#endif
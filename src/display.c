@@ -0,0 +1,321 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <string.h>
+#include "SDL.h"
+#include "clock.h"
+#include "display.h"
+#include "config.h"
+
+// The emulator draws into an 8-bit surface the size of the window either
+// way. SDL 1.2 shows that surface itself; with SDL 2 it is kept in memory
+// and uploaded to a streaming texture, which the renderer presents on the
+// display's refresh when it can.
+static long long updateStart, frameNanos, maxFrameNanos;
+static unsigned int frameCount;
+
+static void countFrame(void)
+{
+	long long nanos;
+
+	if (!updateStart)
+		return;
+
+	nanos = readClock() - updateStart;
+	frameNanos += nanos;
+
+	if (nanos > maxFrameNanos)
+		maxFrameNanos = nanos;
+
+	frameCount++;
+	updateStart = 0;
+}
+
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+static SDL_Window *window;
+static SDL_Renderer *renderer;
+static SDL_Texture *texture;
+static SDL_Surface *surface;
+static Uint32 colors[256], colorsVersion;
+static char title[64] = PACKAGE_NAME;
+
+void setDisplayCaption(const char *caption)
+{
+	strncpy(title, caption, sizeof(title) - 1);
+
+	if (window)
+		SDL_SetWindowTitle(window, title);
+}
+
+int getDesktopSize(int *width, int *height)
+{
+	SDL_DisplayMode mode;
+
+	if (SDL_GetDesktopDisplayMode(0, &mode) < 0)
+		return 0;
+
+	*width = mode.w;
+	*height = mode.h;
+
+	return 1;
+}
+
+// The palette SDL 1.2 gives an 8-bit video mode, 3 bits of red, 3 of green
+// and 2 of blue, so colors map to the same indices with either version.
+static void setDefaultColors(void)
+{
+	SDL_Color palette[256];
+	int i, r, g, b;
+
+	for (i = 0; i < 256; i++)
+	{
+		r = i & 0xE0;
+		g = i << 3 & 0xE0;
+		b = i & 0x03;
+		b |= b << 2;
+
+		palette[i].r = (Uint8)(r | r >> 3 | r >> 6);
+		palette[i].g = (Uint8)(g | g >> 3 | g >> 6);
+		palette[i].b = (Uint8)(b | b << 4);
+		palette[i].a = 255;
+	}
+
+	SDL_SetPaletteColors(surface->format->palette, palette, 0, 256);
+}
+
+// Presents are not synchronized with the display's refresh: they run on
+// the UI thread, which would otherwise block on every one instead of
+// handling input, and the render thread already paces frames to 60 a
+// second.
+static int openRenderer(void)
+{
+	SDL_RendererInfo info;
+
+	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+
+	// Without a GPU the software renderer still does.
+	if (!renderer)
+		renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+
+	if (!renderer)
+		return 0;
+
+	if (!SDL_GetRendererInfo(renderer, &info))
+		printf("stdout: renderer=%s\n", info.name);
+
+	return 1;
+}
+
+// Creates the window the first time and changes it afterwards. In
+// fullscreen it covers the desktop, whatever size is asked for. The surface
+// and texture are made again only when the size they must have changes.
+SDL_Surface *openDisplay(int width, int height, int fullscreen)
+{
+	if (!window)
+	{
+		window = SDL_CreateWindow(title, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height, SDL_WINDOW_RESIZABLE | (fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0));
+
+		if (!window || !openRenderer())
+			return NULL;
+
+		SDL_SetWindowMinimumSize(window, 280, 192);
+	}
+	else
+	{
+		SDL_SetWindowFullscreen(window, fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0);
+
+		if (!fullscreen)
+			SDL_SetWindowSize(window, width, height);
+	}
+
+	SDL_GetRendererOutputSize(renderer, &width, &height);
+
+	if (surface && surface->w == width && surface->h == height)
+		return surface;
+
+	if (texture)
+		SDL_DestroyTexture(texture);
+	if (surface)
+		SDL_FreeSurface(surface);
+
+	surface = SDL_CreateRGBSurface(0, width, height, 8, 0, 0, 0, 0);
+	texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+
+	if (!surface || !texture)
+		return NULL;
+
+	setDefaultColors();
+	colorsVersion = 0;
+
+	return surface;
+}
+
+SDL_Surface *getDisplaySurface(void)
+{
+	return surface;
+}
+
+void setDisplayColors(SDL_Color *colors, int first, int count)
+{
+	SDL_SetPaletteColors(surface->format->palette, colors, first, count);
+}
+
+// Converts a rectangle of the surface through the palette into the texture.
+// A streaming texture's locked pixels start out undefined, so every one of
+// them is written.
+static void uploadRect(const SDL_Rect *rect)
+{
+	const Uint8 *source = (const Uint8 *)surface->pixels + rect->y * surface->pitch + rect->x;
+	Uint32 *destination;
+	void *pixels;
+	int pitch, x, y;
+
+	if (SDL_LockTexture(texture, rect, &pixels, &pitch) < 0)
+		return;
+
+	for (y = 0; y < rect->h; y++, source += surface->pitch)
+	{
+		destination = (Uint32 *)((Uint8 *)pixels + y * pitch);
+
+		for (x = 0; x < rect->w; x++)
+			destination[x] = colors[source[x]];
+	}
+
+	SDL_UnlockTexture(texture);
+}
+
+// Uploads count rectangles of the surface, or all of it for a negative
+// count. Any change to the palette has it uploaded whole.
+void updateDisplay(SDL_Rect *rects, int count)
+{
+	SDL_Palette *palette = surface->format->palette;
+	SDL_Rect all;
+	int i;
+
+	updateStart = readClock();
+
+	if (palette->version != colorsVersion)
+	{
+		for (i = 0; i < 256; i++)
+			colors[i] = 0xFF000000 | palette->colors[i].r << 16 | palette->colors[i].g << 8 | palette->colors[i].b;
+
+		colorsVersion = palette->version;
+		count = -1;
+	}
+
+	if (count < 0)
+	{
+		all.x = all.y = 0;
+		all.w = surface->w;
+		all.h = surface->h;
+		uploadRect(&all);
+	}
+	else
+	{
+		for (i = 0; i < count; i++)
+			uploadRect(&rects[i]);
+	}
+}
+
+// Presents the texture.
+void flipDisplay(void)
+{
+	SDL_RenderCopy(renderer, texture, NULL, NULL);
+	SDL_RenderPresent(renderer);
+	countFrame();
+}
+#else
+void setDisplayCaption(const char *caption)
+{
+	SDL_WM_SetCaption(caption, NULL);
+}
+
+// Before the first mode is set the current one is the desktop's own, so it
+// is kept from then on.
+int getDesktopSize(int *width, int *height)
+{
+	static int desktopWidth, desktopHeight;
+
+	const SDL_VideoInfo *info;
+
+	if (!desktopWidth && (info = SDL_GetVideoInfo()))
+	{
+		desktopWidth = info->current_w;
+		desktopHeight = info->current_h;
+	}
+
+	*width = desktopWidth;
+	*height = desktopHeight;
+
+	return desktopWidth != 0;
+}
+
+SDL_Surface *openDisplay(int width, int height, int fullscreen)
+{
+	return SDL_SetVideoMode(width, height, 8, SDL_HWSURFACE | (fullscreen ? SDL_FULLSCREEN : SDL_RESIZABLE));
+}
+
+SDL_Surface *getDisplaySurface(void)
+{
+	return SDL_GetVideoSurface();
+}
+
+void setDisplayColors(SDL_Color *colors, int first, int count)
+{
+	SDL_SetColors(SDL_GetVideoSurface(), colors, first, count);
+}
+
+void updateDisplay(SDL_Rect *rects, int count)
+{
+	updateStart = readClock();
+
+	if (count < 0)
+		SDL_UpdateRect(SDL_GetVideoSurface(), 0, 0, 0, 0);
+	else
+		SDL_UpdateRects(SDL_GetVideoSurface(), count, rects);
+}
+
+void flipDisplay(void)
+{
+	countFrame();
+}
+#endif
+
+// Shows a rectangle of the surface at once, the whole of it when width and
+// height are 0, as SDL_UpdateRect() does.
+void updateDisplayRect(int x, int y, int width, int height)
+{
+	SDL_Rect rect;
+
+	rect.x = (Sint16)x;
+	rect.y = (Sint16)y;
+	rect.w = (Uint16)width;
+	rect.h = (Uint16)height;
+
+	updateDisplay(&rect, width && height ? 1 : -1);
+	flipDisplay();
+}
+
+// Counts the frames shown and the time taken from the start of an update to
+// the end of its flip.
+void getDisplayStats(unsigned int *frames, long long *totalNanos, long long *maxNanos)
+{
+	*frames = frameCount;
+	*totalNanos = frameNanos;
+	*maxNanos = maxFrameNanos;
+}
@@ -0,0 +1,34 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef __DISPLAY_H__
+#define __DISPLAY_H__
+
+#include "SDL.h"
+
+void setDisplayCaption(const char *caption);
+int getDesktopSize(int *width, int *height);
+SDL_Surface *openDisplay(int width, int height, int fullscreen);
+SDL_Surface *getDisplaySurface(void);
+void setDisplayColors(SDL_Color *colors, int first, int count);
+void updateDisplay(SDL_Rect *rects, int count);
+void updateDisplayRect(int x, int y, int width, int height);
+void flipDisplay(void);
+void getDisplayStats(unsigned int *frames, long long *totalNanos, long long *maxNanos);
+
+#endif
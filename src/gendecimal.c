@@ -0,0 +1,105 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Generates decimal.h, the lookup tables used by ADC and SBC in decimal
+// mode. Each table is indexed by (carry << 16) | (accumulator << 8) | operand
+// and holds the result in the low byte and the N, V, Z and C flags, laid out
+// as in the status register, in the high byte.
+
+#include <stdio.h>
+
+#define N 0x80
+#define V 0x40
+#define Z 0x02
+#define C 0x01
+
+static unsigned short decimalAdd(unsigned short Op1, unsigned short Op2, unsigned short carry)
+{
+	unsigned short tmp, flags = 0;
+	unsigned char accumulator;
+
+	if (!((Op1 + Op2 + carry) & 0xFF))
+		flags |= Z;
+
+	tmp = (Op1 & 0x0F) + (Op2 & 0x0F) + carry;
+	accumulator = tmp < 0x0A ? tmp : tmp + 6;
+	tmp = (Op1 & 0xF0) + (Op2 & 0xF0) + (tmp & 0xF0);
+
+	if (tmp & 0x80)
+		flags |= N;
+
+	if ((Op1 ^ tmp) & ~(Op1 ^ Op2) & 0x80)
+		flags |= V;
+
+	tmp = (accumulator & 0x0F) | (tmp < 0xA0 ? tmp : tmp + 0x60);
+
+	if (tmp & 0x100)
+		flags |= C;
+
+	return flags << 8 | (tmp & 0xFF);
+}
+
+// Decimal SBC leaves V alone, so its entries never have V set.
+static unsigned short decimalSubtract(unsigned short Op1, unsigned short Op2, unsigned short carry)
+{
+	unsigned short tmp, flags = 0;
+	unsigned char accumulator;
+
+	tmp = (Op1 & 0x0F) - (Op2 & 0x0F) - (carry ^ 1);
+	accumulator = !(tmp & 0x10) ? tmp : tmp - 6;
+	tmp = (Op1 & 0xF0) - (Op2 & 0xF0) - (accumulator & 0x10);
+	accumulator = (accumulator & 0x0F) | (!(tmp & 0x100) ? tmp : tmp - 0x60);
+	tmp = Op1 - Op2 - (carry ^ 1);
+
+	if (!(tmp & 0x100))
+		flags |= C;
+
+	if (tmp & 0x80)
+		flags |= N;
+
+	if (!(tmp & 0xFF))
+		flags |= Z;
+
+	return flags << 8 | accumulator;
+}
+
+static void writeTable(const char *name, unsigned short (*function)(unsigned short, unsigned short, unsigned short))
+{
+	unsigned int i;
+
+	printf("static const unsigned short %s[131072] =\n{\n", name);
+
+	for (i = 0; i < 131072; i++)
+		printf("%s0x%04X,%s", i % 12 ? " " : "\t", function((i >> 8) & 0xFF, i & 0xFF, i >> 16), i % 12 == 11 || i == 131071 ? "\n" : "");
+
+	printf("};\n");
+}
+
+int main(void)
+{
+	printf("// Generated by gendecimal, do not edit\n\n");
+	printf("#ifndef __DECIMAL_H__\n#define __DECIMAL_H__\n\n");
+
+	writeTable("decimalAddTable", decimalAdd);
+	printf("\n");
+	writeTable("decimalSubtractTable", decimalSubtract);
+
+	printf("\n#endif\n");
+
+	return 0;
+}
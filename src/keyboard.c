@@ -17,6 +17,9 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "SDL.h"
+#include "crt.h"
+#include "display.h"
+#include "keyboard.h"
 #include "m6502.h"
 #include "memory.h"
 #include "options.h"
@@ -25,7 +28,7 @@
 
 static FILE *_fp;
 static const char *_filename;
-static char buffer[1024];
+static unsigned char buffer[1024];
 static int i, length;
 
 void setInputFile(FILE *fp, const char *filename)
@@ -54,29 +57,102 @@ const char *getInputFileName(void)
 	return _filename;
 }
 
-int handleInput(void)
+static void pushEvent(int code, void *data)
 {
 	SDL_Event event;
+
+	event.type = SDL_USEREVENT;
+	event.user.code = code;
+	event.user.data1 = data;
+	event.user.data2 = NULL;
+
+	SDL_PushEvent(&event);
+}
+
+// Wakes the main loop from another thread: the cursor timer posts
+// EVENT_BLINK and the frame timer EVENT_FRAME. The render thread posts
+// EVENT_PRESENT once a frame is ready to be shown.
+void postEvent(int code)
+{
+	pushEvent(code, NULL);
+}
+
+// The machine's notifier. Its events carry the machine, so the main loop
+// leaves alone those of any other.
+void postMachineEvent(Machine *machine, int event)
+{
+	pushEvent(event, machine);
+}
+
+// Returns the character an event types, or 0 for none. SDL 2 delivers text
+// apart from keys, so there only the keys typing a control character are
+// taken from key events.
+int getTypedCharacter(const SDL_Event *event)
+{
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+	SDL_Keycode sym;
+
+	if (event->type == SDL_TEXTINPUT)
+		return !(event->text.text[0] & 0x80) && !event->text.text[1] ? event->text.text[0] : 0;
+
+	if (event->type != SDL_KEYDOWN)
+		return 0;
+
+	sym = event->key.keysym.sym;
+
+	if (event->key.keysym.mod & KMOD_CTRL && sym >= SDLK_a && sym <= SDLK_z)
+		return sym & 0x1F;
+
+	if (sym == SDLK_RETURN || sym == SDLK_BACKSPACE || sym == SDLK_TAB || sym == SDLK_ESCAPE)
+		return sym;
+
+	return 0;
+#else
+	if (event->type == SDL_KEYDOWN && !(event->key.keysym.unicode & 0xFF80))
+		return event->key.keysym.unicode;
+
+	return 0;
+#endif
+}
+
+// Keys are stored uppercase with bit 7 set, as the keyboard would deliver
+// them. A carriage return is taken to start a CR LF pair and the byte after
+// it is skipped.
+static int convertInput(unsigned char *data, int size)
+{
 	unsigned char tmp;
+	int j, count = 0;
+
+	for (j = 0; j < size; j++)
+	{
+		tmp = data[j];
+
+		if (tmp >= 0x61 && tmp <= 0x7A)
+			tmp &= 0x5F;
+		else if (tmp == 0x0D)
+			j++;
+		else if (tmp == 0x0A)
+			tmp = 0x0D;
+
+		if (tmp < 0x60)
+			data[count++] = (unsigned char)(tmp | 0x80);
+	}
 
-	if (readKbdCr() == 0x27 && _fp)
+	return count;
+}
+
+// Fills the keyboard ring from the input file. The CPU posts EVENT_KEYBOARD
+// once it has read half of it, which brings the main loop back here.
+static void feedInputFile(Machine *machine)
+{
+	while (_fp)
 	{
 		if (i < length)
 		{
-			tmp = buffer[i++];
+			i += writeKeyboardInput(machine, &buffer[i], length - i);
 
-			if (tmp >= 0x61 && tmp <= 0x7A)
-				tmp &= 0x5F;
-			else if (tmp == 0x0D)
-				i++;
-			else if (tmp == 0x0A)
-				tmp = 0x0D;
-			
-			if (tmp < 0x60)
-			{
-				writeKbd((unsigned char)(tmp | 0x80));
-				writeKbdCr(0xA7);
-			}
+			if (i < length)
+				break;
 		}
 		else if (feof(_fp))
 		{
@@ -86,48 +162,97 @@ int handleInput(void)
 		else
 		{
 			i = 0;
-			length = fread(buffer, 1, 1024, _fp);
+			length = convertInput(buffer, (int)fread(buffer, 1, 1024, _fp));
 		}
 	}
+}
+
+static void showHalted(Machine *machine)
+{
+	unsigned short address;
+	long long cycles;
+
+	if (getHalted(machine, &address, &cycles))
+		printf("stdout: CPU halted at $%04X after %lld cycles\n", address, cycles);
+}
+
+int handleInput(Machine *machine)
+{
+	SDL_Event event;
+	unsigned char tmp;
 
-	while (SDL_PollEvent(&event))
+	feedInputFile(machine);
+
+	if (!SDL_WaitEvent(&event))
+		return 0;
+
+	do
 	{
 		if (event.type == SDL_QUIT)
 			return 0;
 
+		if (event.type == SDL_USEREVENT && event.user.data1 && event.user.data1 != machine)
+			continue;
+
+		if (event.type == SDL_USEREVENT && event.user.code == EVENT_HALT)
+			showHalted(machine);
+		else if (event.type == SDL_USEREVENT && event.user.code == EVENT_BLINK)
+			blinkCursor(machine);
+		else if (event.type == SDL_USEREVENT && event.user.code == EVENT_SPEED)
+			showSpeed(machine);
+		else if (event.type == SDL_USEREVENT && event.user.code == EVENT_FRAME)
+			frameElapsed();
+		else if (event.type == SDL_USEREVENT && event.user.code == EVENT_PRESENT)
+			presentScreen();
+
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+		if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+			resizeScreen(machine, event.window.data1, event.window.data2);
+		else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_EXPOSED)
+			flipDisplay();
+#else
+		if (event.type == SDL_VIDEORESIZE)
+			resizeScreen(machine, event.resize.w, event.resize.h);
+#endif
+
+		if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_PAGEUP)
+			scrollScreen(machine, 12);
+		else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_PAGEDOWN)
+			scrollScreen(machine, -12);
+
 		if (event.type == SDL_KEYDOWN && event.key.keysym.mod & KMOD_CTRL)
 		{
 			if (event.key.keysym.sym == SDLK_l)
 			{
-				loadMemory();
+				loadMemory(machine);
 				return 1;
 			}
 			else if (event.key.keysym.sym == SDLK_s)
 			{
-				saveMemory();
+				saveMemory(machine);
 				return 1;
 			}
 			else if (event.key.keysym.sym == SDLK_q)
 				return 0;
 			else if (event.key.keysym.sym == SDLK_r)
 			{
-				resetPia6820();
-				resetM6502();
+				resetPia6820(machine);
+				resetM6502(machine);
 				return 1;
 			}
 			else if (event.key.keysym.sym == SDLK_h)
 			{
-				stopM6502();
-				resetM6502();
-				resetScreen();
-				resetPia6820();
-				resetMemory();
-				startM6502();
+				stopM6502(machine);
+				resetM6502(machine);
+				resetScreen(machine);
+				resetPia6820(machine);
+				resetMemory(machine);
+				startM6502(machine);
 				return 1;
 			}
 			else if (event.key.keysym.sym == SDLK_p)
 			{
-				changePixelSize();
+				changePixelSize(machine);
 				return 1;
 			}
 			else if (event.key.keysym.sym == SDLK_n)
@@ -136,78 +261,93 @@ int handleInput(void)
 				{
 					setScanlines(!getScanlines());
 					printf("stdout: scanlines=%d\n", getScanlines());
-					redrawScreen();
+					redrawScreen(machine);
 				}
 
 				return 1;
 			}
 			else if (event.key.keysym.sym == SDLK_t)
 			{
-				changeTerminalSpeed();
+				changeTerminalSpeed(machine);
 				return 1;
 			}
 			else if (event.key.keysym.sym == SDLK_e)
 			{
-				setRam8k(!getRam8k());
-				printf("stdout: ram8k=%d\n", getRam8k());
+				stopM6502(machine);
+				setRam8k(machine, !getRam8k(machine));
+				startM6502(machine);
+				printf("stdout: ram8k=%d\n", getRam8k(machine));
 				return 1;
 			}
 			else if (event.key.keysym.sym == SDLK_w)
 			{
-				setWriteInRom(!getWriteInRom());
-				printf("stdout: writeInRom=%d\n", getWriteInRom());
+				stopM6502(machine);
+				setWriteInRom(machine, !getWriteInRom(machine));
+				startM6502(machine);
+				printf("stdout: writeInRom=%d\n", getWriteInRom(machine));
 				return 1;
 			}
 			else if (event.key.keysym.sym == SDLK_v)
 			{
-				setIrqBrkVector();
+				setIrqBrkVector(machine);
 				return 1;
 			}
 			else if (event.key.keysym.sym == SDLK_f)
 			{
 				setFullscreen(!getFullscreen());
 				printf("stdout: fullscreen=%d\n", getFullscreen());
-				SDL_SetVideoMode(280 * getPixelSize(), 192 * getPixelSize(), 8, SDL_HWSURFACE | (getFullscreen() ? SDL_FULLSCREEN : 0));
-				initScreen();
+				setVideoMode();
 				SDL_ShowCursor(!getFullscreen());
-				redrawScreen();
+				redrawScreen(machine);
 				return 1;
 			}
 			else if (event.key.keysym.sym == SDLK_b)
 			{
 				setBlinkCursor(!getBlinkCursor());
 				printf("stdout: blinkCursor=%d\n", getBlinkCursor());
-				redrawScreen();
+				redrawScreen(machine);
 				return 1;
 			}
 			else if (event.key.keysym.sym == SDLK_c)
 			{
 				setBlockCursor(!getBlockCursor());
 				printf("stdout: blockCursor=%d\n", getBlockCursor());
-				redrawScreen();
+				redrawScreen(machine);
+				return 1;
+			}
+			else if (event.key.keysym.sym == SDLK_g)
+			{
+				setCrt(!getCrt());
+				printf("stdout: crt=%d\n", getCrt());
+				redrawScreen(machine);
 				return 1;
 			}
 			else if (event.key.keysym.sym == SDLK_a)
 			{
-				showAbout();
+				showAbout(machine);
+				return 1;
+			}
+			else if (event.key.keysym.sym == SDLK_u)
+			{
+				setTurbo(machine, !getTurbo(machine));
+				printf("stdout: turbo=%d\n", getTurbo(machine));
+				showSpeed(machine);
 				return 1;
 			}
 		}
 
-		if (readKbdCr() == 0x27 && !_fp && event.type == SDL_KEYDOWN && !(event.key.keysym.unicode & 0xFF80) && event.key.keysym.unicode)
+		if (!_fp && (tmp = (unsigned char)getTypedCharacter(&event)))
 		{
-			tmp = event.key.keysym.unicode & 0x7F;
-
 			if (tmp >= 0x61 && tmp <= 0x7A)
 				tmp &= 0x5F;
 
 			if (tmp < 0x60)
 			{
-				writeKbd((unsigned char)(tmp | 0x80));
-				writeKbdCr(0xA7);
+				tmp |= 0x80;
+				writeKeyboardInput(machine, &tmp, 1);
 			}
 		}
-	}
+	} while (SDL_PollEvent(&event));
 
 	return 1;
 }
@@ -19,10 +19,21 @@
 #ifndef __KEYBOARD_H__
 #define __KEYBOARD_H__
 
+#include "SDL.h"
+#include "machine.h"
+
+#define EVENT_BLINK 3
+#define EVENT_SPEED 5
+#define EVENT_FRAME 6
+#define EVENT_PRESENT 7
+
 void setInputFile(FILE *fd, const char *filename);
 void closeInputFile(void);
 int isInputFileOpen(void);
 const char *getInputFileName(void);
-int handleInput(void);
+int handleInput(Machine *machine);
+void postEvent(int code);
+void postMachineEvent(Machine *machine, int event);
+int getTypedCharacter(const SDL_Event *event);
 
 #endif
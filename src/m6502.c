@@ -17,7 +17,26 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "SDL.h"
+#include "atomics.h"
+#include "clock.h"
+#include "decimal.h"
+#include "m6502.h"
 #include "memory.h"
+#include "opcodes.h"
+#include "pia6820.h"
+#include "recompiler.h"
+#include "scheduler.h"
+#include "config.h"
+
+#ifdef HAVE_DLFCN_H
+#include <dlfcn.h>
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(_WIN32)
+#define M6502_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #define N 0x80
 #define V 0x40
@@ -27,1790 +46,2813 @@
 #define Z 0x02
 #define C 0x01
 
-static unsigned char accumulator, xRegister, yRegister, statusRegister = 0x24, stackPointer;
-static int IRQ = 0, NMI = 0;
-static unsigned short programCounter;
-static unsigned char btmp;
-static unsigned short op, opH, opL, ptr, ptrH, ptrL, tmp;
-static long lastTime;
-static int cycles, cyclesBeforeSynchro, _synchroMillis;
-static SDL_Thread *thread;
-static int running;
+#define MICRO_OPS 65536
+#define BLOCK_LENGTH 64
+
+#define NATIVE_SIZE 0x400000
+// Room for the longest translation, STA ($nn),Y at 270 bytes, and the
+// block's entry and exit.
+#define NATIVE_OP_SIZE 320
+#define NATIVE_THRESHOLD 32
+
+#define CATCH_UP_NANOS 100000000LL
+
+// Keeps rarely taken paths out of the flattened dispatch loop.
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+typedef struct
+{
+	unsigned short operand, next;
+	unsigned char opcode, cycles, last, idle;
+} MicroOp;
+
+typedef int (*NativeBlock)(M6502 *cpu);
+
+struct M6502
+{
+	unsigned char accumulator, xRegister, yRegister, statusRegister, stackPointer;
+	unsigned char negative, overflow, zero, carry;
+	unsigned short programCounter, operand;
+	int IRQ, NMI;
+	int cycles, cyclesBeforeSynchro, synchroMillis, frequency;
+	AtomicIndex deadline;
+	int multiplier, turbo, resync;
+	int running;
+	long long paceStart, paceCycles;
+	long long paceDrift, paceMaxLate, paceDropped;
+	unsigned int paceSlices, paceLateSlices;
+	SDL_Thread *thread;
+	SDL_mutex *idleMutex;
+	SDL_cond *idleCond;
+	int idle, halted;
+	unsigned int wakeups, idleWakeups, idleWaits;
+	long long skippedCycles, idleMillis;
+	long long elapsedCycles, haltCycles, nextEvent, instructions;
+	unsigned short haltAddress;
+	Machine *machine;
+	const MicroOp *microOp;
+	unsigned int microOpCount;
+	int blockInvalidated;
+	unsigned char *nativeCode, *emit;
+	unsigned int nativeSize;
+	int jit;
+	const RecompilerModule *recompiledModule;
+	RecompilerState recompilerState;
+	unsigned char recompiledPages[256], validPages[256];
+	unsigned int recompiledIndex[257];
+	MicroOp microOps[MICRO_OPS], uncachedOp;
+	unsigned int blocks[65536];
+	NativeBlock nativeBlocks[65536];
+	unsigned char blockHits[65536], recompiledEntries[65536];
+};
+
+// N, V, Z and C are kept apart from statusRegister: negative holds the last
+// result for N, zero is non-zero unless Z is set, overflow is 0 or V and
+// carry is 0 or 1. The full register is only assembled when it is pushed,
+// dumped or handed to a recompiled module.
+static unsigned char getStatusRegister(M6502 *cpu)
+{
+	return cpu->statusRegister | (cpu->negative & N) | cpu->overflow | (cpu->zero ? 0 : Z) | cpu->carry;
+}
+
+static void setStatusRegister(M6502 *cpu, unsigned char value)
+{
+	cpu->statusRegister = value & ~(N | V | Z | C);
+	cpu->negative = value;
+	cpu->overflow = value & V;
+	cpu->zero = ~value & Z;
+	cpu->carry = value & C;
+}
+
+static unsigned short memReadAbsolute(M6502 *cpu, unsigned short adr)
+{
+	return (memRead(cpu->machine, adr) | memRead(cpu->machine, (unsigned short)(adr + 1)) << 8);
+}
+
+static void resynchronize(M6502 *cpu)
+{
+	cpu->paceStart = readClock();
+	cpu->paceCycles = 0;
+}
+
+// Called after each slice. The deadline is derived from every cycle run
+// since the last resynchronize(), so rounding and oversleeping never add
+// up. A late slice is caught up by running the next ones back to back; if
+// the host stalled for longer than CATCH_UP_NANOS the excess is dropped.
+static void synchronize(M6502 *cpu)
+{
+	long long deadline, late;
+
+	if (cpu->resync)
+	{
+		cpu->resync = 0;
+		resynchronize(cpu);
+		return;
+	}
 
-static unsigned short memReadAbsolute(unsigned short adr)
-{
-	return (memRead(adr) | memRead((unsigned short)(adr + 1)) << 8);
+	if (cpu->turbo || !cpu->multiplier)
+		return;
+
+	cpu->paceCycles += cpu->cycles;
+	deadline = cpu->paceStart + cpu->paceCycles * 1000000 / ((long long)cpu->frequency * cpu->multiplier);
+	late = readClock() - deadline;
+
+	cpu->paceSlices++;
+	cpu->paceDrift = late;
+
+	if (late > 0)
+	{
+		cpu->paceLateSlices++;
+
+		if (late > cpu->paceMaxLate)
+			cpu->paceMaxLate = late;
+	}
+
+	if (late > CATCH_UP_NANOS)
+	{
+		cpu->paceDropped += late - CATCH_UP_NANOS;
+		cpu->paceStart += late - CATCH_UP_NANOS;
+	}
+	else if (late < 0)
+		sleepUntil(deadline);
 }
 
-static void synchronize(void)
+static void pushProgramCounter(M6502 *cpu)
 {
-	int realTimeMillis = SDL_GetTicks() - lastTime;
-	int sleepMillis = _synchroMillis - realTimeMillis;
-
-	if (sleepMillis < 0)
-		sleepMillis = 5;
+	memWrite(cpu->machine, (unsigned short)(cpu->stackPointer + 0x100), (unsigned char)(cpu->programCounter >> 8));
+	cpu->stackPointer--;
+	memWrite(cpu->machine, (unsigned short)(cpu->stackPointer + 0x100), (unsigned char)cpu->programCounter);
+	cpu->stackPointer--;
+}
 
-	SDL_Delay(sleepMillis);
+static void popProgramCounter(M6502 *cpu)
+{
+	cpu->stackPointer++;
+	cpu->programCounter = memRead(cpu->machine, (unsigned short)(cpu->stackPointer + 0x100));
+	cpu->stackPointer++;
+	cpu->programCounter += memRead(cpu->machine, (unsigned short)(cpu->stackPointer + 0x100)) << 8;
+}
 
-	lastTime = SDL_GetTicks();
+static void handleIRQ(M6502 *cpu)
+{
+	pushProgramCounter(cpu);
+	memWrite(cpu->machine, (unsigned short)(0x100 + cpu->stackPointer), (unsigned char)(getStatusRegister(cpu) & ~0x10));
+	cpu->stackPointer--;
+	cpu->statusRegister |= I;
+	cpu->programCounter = memReadAbsolute(cpu, 0xFFFE);
+	cpu->cycles += 10;
 }
 
-static void pushProgramCounter(void)
+static void handleNMI(M6502 *cpu)
 {
-	memWrite((unsigned short)(stackPointer + 0x100), (unsigned char)(programCounter >> 8));
-	stackPointer--;
-	memWrite((unsigned short)(stackPointer + 0x100), (unsigned char)programCounter);
-	stackPointer--;
-	cycles += 2;
+	pushProgramCounter(cpu);
+	memWrite(cpu->machine, (unsigned short)(0x100 + cpu->stackPointer), (unsigned char)(getStatusRegister(cpu) & ~0x10));
+	cpu->stackPointer--;
+	cpu->statusRegister |= I;
+	cpu->NMI = 0;
+	cpu->programCounter = memReadAbsolute(cpu, 0xFFFA);
+	cpu->cycles += 10;
 }
 
-static void popProgramCounter(void)
+// The deadline is read on every dispatch, written by the CPU thread and
+// dropped to 0 by rescheduleM6502() from any thread.
+static int getDeadline(M6502 *cpu)
 {
-	stackPointer++;
-	programCounter = memRead((unsigned short)(stackPointer + 0x100));
-	stackPointer++;
-	programCounter += memRead((unsigned short)(stackPointer + 0x100)) << 8;
-	cycles += 2;
+	return (int)loadRelaxed(&cpu->deadline);
 }
 
-static void handleIRQ(void)
+// Called once the deadline is reached. Runs the events that are due, takes
+// a pending interrupt and moves the deadline to the next event or to the
+// end of the slice, whichever comes first. The deadline is set to the end of
+// the slice first, so a 0 found there at the end was stored by another
+// thread in the meantime and is put back.
+static NOINLINE void serviceEvents(M6502 *cpu)
 {
-	pushProgramCounter();
-	memWrite((unsigned short)(0x100 + stackPointer), (unsigned char)(statusRegister & ~0x10));
-	stackPointer--;
-	statusRegister |= I;
-	programCounter = memReadAbsolute(0xFFFE);
-	cycles += 8;
+	long long next;
+	int deadline;
+
+	exchange(&cpu->deadline, cpu->cyclesBeforeSynchro);
+
+	next = runEvents(cpu->machine, cpu->elapsedCycles + cpu->cycles);
+
+	if (!(cpu->statusRegister & I) && cpu->IRQ)
+		handleIRQ(cpu);
+	if (cpu->NMI)
+		handleNMI(cpu);
+
+	cpu->nextEvent = next;
+
+	if (next - cpu->elapsedCycles < cpu->cyclesBeforeSynchro)
+		deadline = (int)(next - cpu->elapsedCycles);
+	else
+		deadline = cpu->cyclesBeforeSynchro;
+
+	if (eventsPosted(cpu->machine) || !cpu->running)
+		deadline = 0;
+
+	if (!exchange(&cpu->deadline, deadline))
+		storeRelaxed(&cpu->deadline, 0);
 }
 
-static void handleNMI(void)
+// Interrupts are only looked at when the deadline is reached, so clearing I
+// while an IRQ is held has to bring it forward.
+static void checkIRQ(M6502 *cpu)
 {
-	pushProgramCounter();
-	memWrite((unsigned short)(0x100 + stackPointer), (unsigned char)(statusRegister & ~0x10));
-	stackPointer--;
-	statusRegister |= I;
-	NMI = 0;
-	programCounter = memReadAbsolute(0xFFFA);
-	cycles += 8;
+	if (cpu->IRQ && !(cpu->statusRegister & I))
+		storeRelaxed(&cpu->deadline, 0);
 }
 
-static void Imp(void)
+static unsigned short Imp(M6502 *cpu)
 {
-	cycles++;
+	return 0;
 }
 
-static void Imm(void)
+static unsigned short Imm(M6502 *cpu)
 {
-	op = programCounter++;
+	return cpu->operand;
 }
 
-static void Zero(void)
+static unsigned short Zero(M6502 *cpu)
 {
-	op = memRead(programCounter++);
-	cycles++;
+	return cpu->operand;
 }
 
-static void ZeroX(void)
+static unsigned short ZeroX(M6502 *cpu)
 {
-	op = memRead(programCounter++) + xRegister & 0xFF;
-	cycles++;
+	return cpu->operand + cpu->xRegister & 0xFF;
 }
 
-static void ZeroY(void)
+static unsigned short ZeroY(M6502 *cpu)
 {
-	op = memRead(programCounter++) + yRegister & 0xFF;
-	cycles++;
+	return cpu->operand + cpu->yRegister & 0xFF;
 }
 
-static void Abs(void)
+static unsigned short Abs(M6502 *cpu)
 {
-	op = memReadAbsolute(programCounter);
-	programCounter += 2;
-	cycles += 2;
+	return cpu->operand;
 }
 
-static void AbsX(void)
+static unsigned short AbsX(M6502 *cpu)
 {
-	opL = memRead(programCounter++) + xRegister;
-	opH = memRead(programCounter++) << 8;
-	cycles += 2;
+	unsigned short opL = (cpu->operand & 0xFF) + cpu->xRegister;
 
 	if (opL & 0x100)
-		cycles++;
+		cpu->cycles++;
 
-	op = opH + opL;
+	return (cpu->operand & 0xFF00) + opL;
 }
 
-static void AbsY(void)
+static unsigned short AbsY(M6502 *cpu)
 {
-	opL = memRead(programCounter++) + yRegister;
-	opH = memRead(programCounter++) << 8;
-	cycles += 2;
+	unsigned short opL = (cpu->operand & 0xFF) + cpu->yRegister;
 
 	if (opL & 0x100)
-		cycles++;
+		cpu->cycles++;
 
-	op = opH + opL;
+	return (cpu->operand & 0xFF00) + opL;
 }
 
-static void Ind(void)
+static unsigned short Ind(M6502 *cpu)
 {
-	ptrL = memRead(programCounter++);
-	ptrH = memRead(programCounter++) << 8;
-	op = memRead((unsigned short)(ptrH + ptrL));
+	unsigned short ptrL = cpu->operand & 0xFF, ptrH = cpu->operand & 0xFF00, op;
+
+	op = memRead(cpu->machine, (unsigned short)(ptrH + ptrL));
 	ptrL = ptrL + 1 & 0xFF;
-	op += memRead((unsigned short)(ptrH + ptrL)) << 8;
-	cycles += 4;
-}
 
-static void IndZeroX(void)
-{
-	ptr = memRead(programCounter++) + xRegister & 0xFF;
-	op = memRead(ptr);
-	op += memRead((unsigned short)(ptr + 1 & 0xFF)) << 8;
-	cycles += 3;
+	return op + (memRead(cpu->machine, (unsigned short)(ptrH + ptrL)) << 8);
 }
 
-static void IndZeroY(void)
+static unsigned short IndZeroX(M6502 *cpu)
 {
-	ptr = memRead(programCounter++);
-	opL = memRead(ptr) + yRegister;
-	opH = memRead((unsigned short)(ptr + 1 & 0xFF)) << 8;
-	cycles += 3;
+	unsigned short ptr = cpu->operand + cpu->xRegister & 0xFF, op;
 
-	if (opL & 0x100)
-		cycles++;
+	op = memRead(cpu->machine, ptr);
 
-	op = opH + opL;
+	return op + (memRead(cpu->machine, (unsigned short)(ptr + 1 & 0xFF)) << 8);
 }
 
-static void Rel(void)
+static unsigned short IndZeroY(M6502 *cpu)
 {
-	op = memRead(programCounter++);
+	unsigned short opL, opH;
 
-	if (op & 0x80)
-		op |= 0xFF00;
+	opL = memRead(cpu->machine, cpu->operand) + cpu->yRegister;
+	opH = memRead(cpu->machine, (unsigned short)(cpu->operand + 1 & 0xFF)) << 8;
+
+	if (opL & 0x100)
+		cpu->cycles++;
 
-	op += programCounter;
-	cycles++;
+	return opH + opL;
 }
 
-static void WAbsX(void)
+static unsigned short Rel(M6502 *cpu)
 {
-	opL = memRead(programCounter++) + xRegister;
-	opH = memRead(programCounter++) << 8;
-	cycles += 3;
-	op = opH + opL;
+	return cpu->operand;
 }
 
-static void WAbsY(void)
+static unsigned short WAbsX(M6502 *cpu)
 {
-	opL = memRead(programCounter++) + yRegister;
-	opH = memRead(programCounter++) << 8;
-	cycles += 3;
-	op = opH + opL;
+	return cpu->operand + cpu->xRegister;
 }
 
-static void WIndZeroY(void)
+static unsigned short WAbsY(M6502 *cpu)
 {
-	ptr = memRead(programCounter++);
-	opL = memRead(ptr) + yRegister;
-	opH = memRead((unsigned short)(ptr + 1 & 0xFF)) << 8;
-	cycles += 4;
-	op = opH + opL;
+	return cpu->operand + cpu->yRegister;
 }
 
-static void setStatusRegisterNZ(unsigned char val)
+static unsigned short WIndZeroY(M6502 *cpu)
 {
-	if (val & 0x80)
-		statusRegister |= N;
-	else
-		statusRegister &= ~N;
+	unsigned short opL, opH;
 
-	if (!val)
-		statusRegister |= Z;
-	else
-		statusRegister &= ~Z;
+	opL = memRead(cpu->machine, cpu->operand) + cpu->yRegister;
+	opH = memRead(cpu->machine, (unsigned short)(cpu->operand + 1 & 0xFF)) << 8;
+
+	return opH + opL;
 }
 
-static void LDA(void)
+static void setStatusRegisterNZ(M6502 *cpu, unsigned char val)
 {
-	accumulator = memRead(op);
-	setStatusRegisterNZ(accumulator);
-	cycles++;
+	cpu->negative = cpu->zero = val;
 }
 
-static void LDX(void)
+static void LDA(M6502 *cpu, unsigned short op)
 {
-	xRegister = memRead(op);
-	setStatusRegisterNZ(xRegister);
-	cycles++;
+	cpu->accumulator = memRead(cpu->machine, op);
+	setStatusRegisterNZ(cpu, cpu->accumulator);
 }
 
-static void LDY(void)
+static void LDX(M6502 *cpu, unsigned short op)
 {
-	yRegister = memRead(op);
-	setStatusRegisterNZ(yRegister);
-	cycles++;
+	cpu->xRegister = memRead(cpu->machine, op);
+	setStatusRegisterNZ(cpu, cpu->xRegister);
 }
 
-static void STA(void)
+static void LDY(M6502 *cpu, unsigned short op)
 {
-	memWrite(op, accumulator);
-	cycles++;
+	cpu->yRegister = memRead(cpu->machine, op);
+	setStatusRegisterNZ(cpu, cpu->yRegister);
 }
 
-static void STX(void)
+static void STA(M6502 *cpu, unsigned short op)
 {
-	memWrite(op, xRegister);
-	cycles++;
+	memWrite(cpu->machine, op, cpu->accumulator);
 }
 
-static void STY(void)
+static void STX(M6502 *cpu, unsigned short op)
 {
-	memWrite(op, yRegister);
-	cycles++;
+	memWrite(cpu->machine, op, cpu->xRegister);
 }
 
-static void setFlagCarry(unsigned short val)
+static void STY(M6502 *cpu, unsigned short op)
 {
-	if (val & 0x100)
-		statusRegister |= C;
-	else
-		statusRegister &= ~C;
+	memWrite(cpu->machine, op, cpu->yRegister);
 }
 
-static void ADC(void)
+static void setFlagCarry(M6502 *cpu, unsigned short val)
 {
-	unsigned short Op1 = accumulator, Op2 = memRead(op);
-	cycles++;
-
-	if (statusRegister & D)
-	{
-		if (!(Op1 + Op2 + (statusRegister & C ? 1 : 0) & 0xFF))
-			statusRegister |= Z;
-		else
-			statusRegister &= ~Z;
-
-		tmp = (Op1 & 0x0F) + (Op2 & 0x0F) + (statusRegister & C ? 1 : 0);
-		accumulator = tmp < 0x0A ? tmp : tmp + 6;
-		tmp = (Op1 & 0xF0) + (Op2 & 0xF0) + (tmp & 0xF0);
-		
-		if (tmp & 0x80)
-			statusRegister |= N;
-		else
-			statusRegister &= ~N;
+	cpu->carry = val >> 8 & 1;
+}
 
-		if ((Op1 ^ tmp) & ~(Op1 ^ Op2) & 0x80)
-			statusRegister |= V;
-		else
-			statusRegister &= ~V;
+static void setDecimalResult(M6502 *cpu, unsigned short entry)
+{
+	cpu->accumulator = (unsigned char)entry;
+	cpu->negative = entry >> 8;
+	cpu->zero = ~entry >> 8 & Z;
+	cpu->carry = entry >> 8 & C;
+}
 
-		tmp = (accumulator & 0x0F) | (tmp < 0xA0 ? tmp : tmp + 0x60);
-		
-		if (tmp & 0x100)
-			statusRegister |= C;
-		else
-			statusRegister &= ~C;
+static void ADC(M6502 *cpu, unsigned short op)
+{
+	unsigned short Op1 = cpu->accumulator, Op2 = memRead(cpu->machine, op);
+	unsigned short tmp;
 
-		accumulator = tmp & 0xFF;
+	if (cpu->statusRegister & D)
+	{
+		tmp = decimalAddTable[cpu->carry << 16 | Op1 << 8 | Op2];
+		cpu->overflow = tmp >> 8 & V;
+		setDecimalResult(cpu, tmp);
 	}
 	else
 	{
-		tmp = Op1 + Op2 + (statusRegister & C ? 1 : 0);
-		accumulator = tmp & 0xFF;
-		
-		if ((Op1 ^ accumulator) & ~(Op1 ^ Op2) & 0x80)
-			statusRegister |= V;
-		else
-			statusRegister &= ~V;
-
-		setFlagCarry(tmp);
-		setStatusRegisterNZ(accumulator);
+		tmp = Op1 + Op2 + cpu->carry;
+		cpu->accumulator = tmp & 0xFF;
+		cpu->overflow = (Op1 ^ cpu->accumulator) & ~(Op1 ^ Op2) & 0x80 ? V : 0;
+		setFlagCarry(cpu, tmp);
+		setStatusRegisterNZ(cpu, cpu->accumulator);
 	}
 }
 
-static void setFlagBorrow(unsigned short val)
+static void setFlagBorrow(M6502 *cpu, unsigned short val)
 {
-	if (!(val & 0x100))
-		statusRegister |= C;
-	else
-		statusRegister &= ~C;
+	cpu->carry = ~val >> 8 & 1;
 }
 
-static void SBC(void)
+static void SBC(M6502 *cpu, unsigned short op)
 {
-	unsigned short Op1 = accumulator, Op2 = memRead(op);
-	cycles++;
+	unsigned short Op1 = cpu->accumulator, Op2 = memRead(cpu->machine, op);
+	unsigned short tmp;
 
-	if (statusRegister & D)
-	{
-		tmp = (Op1 & 0x0F) - (Op2 & 0x0F) - (statusRegister & C ? 0 : 1);
-		accumulator = !(tmp & 0x10) ? tmp : tmp - 6;
-		tmp = (Op1 & 0xF0) - (Op2 & 0xF0) - (accumulator & 0x10);
-		accumulator = (accumulator & 0x0F) | (!(tmp & 0x100) ? tmp : tmp - 0x60);
-		tmp = Op1 - Op2 - (statusRegister & C ? 0 : 1);
-		setFlagBorrow(tmp);
-		setStatusRegisterNZ((unsigned char)tmp);
-	}
+	if (cpu->statusRegister & D)
+		setDecimalResult(cpu, decimalSubtractTable[cpu->carry << 16 | Op1 << 8 | Op2]);
 	else
 	{
-		tmp = Op1 - Op2 - (statusRegister & C ? 0 : 1);
-		accumulator = tmp & 0xFF;
+		tmp = Op1 - Op2 - (cpu->carry ^ 1);
+		cpu->accumulator = tmp & 0xFF;
 
-		if ((Op1 ^ Op2) & (Op1 ^ accumulator) & 0x80)
-			statusRegister |= V;
-		else
-			statusRegister &= ~V;
-		
-		setFlagBorrow(tmp);
-		setStatusRegisterNZ(accumulator);
+		cpu->overflow = (Op1 ^ Op2) & (Op1 ^ cpu->accumulator) & 0x80 ? V : 0;
+		setFlagBorrow(cpu, tmp);
+		setStatusRegisterNZ(cpu, cpu->accumulator);
 	}
 }
 
-static void CMP(void)
+static void CMP(M6502 *cpu, unsigned short op)
 {
-	tmp = accumulator - memRead(op);
-	cycles++;
-	setFlagBorrow(tmp);
-	setStatusRegisterNZ((unsigned char)tmp);
+	unsigned short tmp;
+
+	tmp = cpu->accumulator - memRead(cpu->machine, op);
+	setFlagBorrow(cpu, tmp);
+	setStatusRegisterNZ(cpu, (unsigned char)tmp);
 }
 
-static void CPX(void)
+static void CPX(M6502 *cpu, unsigned short op)
 {
-	tmp = xRegister - memRead(op);
-	cycles++;
-	setFlagBorrow(tmp);
-	setStatusRegisterNZ((unsigned char)tmp);
+	unsigned short tmp;
+
+	tmp = cpu->xRegister - memRead(cpu->machine, op);
+	setFlagBorrow(cpu, tmp);
+	setStatusRegisterNZ(cpu, (unsigned char)tmp);
 }
 
-static void CPY(void)
+static void CPY(M6502 *cpu, unsigned short op)
 {
-	tmp = yRegister - memRead(op);
-	cycles++;
-	setFlagBorrow(tmp);
-	setStatusRegisterNZ((unsigned char)tmp);
+	unsigned short tmp;
+
+	tmp = cpu->yRegister - memRead(cpu->machine, op);
+	setFlagBorrow(cpu, tmp);
+	setStatusRegisterNZ(cpu, (unsigned char)tmp);
 }
 
-static void AND(void)
+static void AND(M6502 *cpu, unsigned short op)
 {
-	accumulator &= memRead(op);
-	cycles++;
-	setStatusRegisterNZ(accumulator);
+	cpu->accumulator &= memRead(cpu->machine, op);
+	setStatusRegisterNZ(cpu, cpu->accumulator);
 }
 
-static void ORA(void)
+static void ORA(M6502 *cpu, unsigned short op)
 {
-	accumulator |= memRead(op);
-	cycles++;
-	setStatusRegisterNZ(accumulator);
+	cpu->accumulator |= memRead(cpu->machine, op);
+	setStatusRegisterNZ(cpu, cpu->accumulator);
 }
 
-static void EOR(void)
+static void EOR(M6502 *cpu, unsigned short op)
 {
-	accumulator ^= memRead(op);
-	cycles++;
-	setStatusRegisterNZ(accumulator);
+	cpu->accumulator ^= memRead(cpu->machine, op);
+	setStatusRegisterNZ(cpu, cpu->accumulator);
 }
 
-static void ASL(void)
+static void ASL(M6502 *cpu, unsigned short op)
 {
-	btmp = memRead(op);
-	
-	if (btmp & 0x80)
-		statusRegister |= C;
-	else
-		statusRegister &= ~C;
+	unsigned char btmp;
 
+	btmp = memRead(cpu->machine, op);
+	cpu->carry = btmp >> 7;
 	btmp <<= 1;
-	setStatusRegisterNZ(btmp);
-	memWrite(op, btmp);
-	cycles += 3;
+	setStatusRegisterNZ(cpu, btmp);
+	memWrite(cpu->machine, op, btmp);
 }
 
-static void ASL_A(void)
+static void ASL_A(M6502 *cpu, unsigned short op)
 {
-	tmp = accumulator << 1;
-	accumulator = tmp & 0xFF;
-	setFlagCarry(tmp);
-	setStatusRegisterNZ(accumulator);
+	unsigned short tmp;
+
+	tmp = cpu->accumulator << 1;
+	cpu->accumulator = tmp & 0xFF;
+	setFlagCarry(cpu, tmp);
+	setStatusRegisterNZ(cpu, cpu->accumulator);
 }
 
-static void LSR(void)
+static void LSR(M6502 *cpu, unsigned short op)
 {
-	btmp = memRead(op);
-	
-	if (btmp & 1)
-		statusRegister |= C;
-	else
-		statusRegister &= ~C;
+	unsigned char btmp;
 
+	btmp = memRead(cpu->machine, op);
+	cpu->carry = btmp & 1;
 	btmp >>= 1;
-	setStatusRegisterNZ(btmp);
-	memWrite(op, btmp);
-	cycles += 3;
+	setStatusRegisterNZ(cpu, btmp);
+	memWrite(cpu->machine, op, btmp);
 }
 
-static void LSR_A(void)
+static void LSR_A(M6502 *cpu, unsigned short op)
 {
-	if (accumulator & 1)
-		statusRegister |= C;
-	else
-		statusRegister &= ~C;
-
-	accumulator >>= 1;
-	setStatusRegisterNZ(accumulator);
+	cpu->carry = cpu->accumulator & 1;
+	cpu->accumulator >>= 1;
+	setStatusRegisterNZ(cpu, cpu->accumulator);
 }
 
-static void ROL(void)
+static void ROL(M6502 *cpu, unsigned short op)
 {
 	int newCarry;
+	unsigned char btmp;
 
-	btmp = memRead(op);
+	btmp = memRead(cpu->machine, op);
 	newCarry = btmp & 0x80;
-	btmp = (btmp << 1) | (statusRegister & C ? 1 : 0);
-
-	if (newCarry)
-		statusRegister |= C;
-	else
-		statusRegister &= ~C;
-	
-	setStatusRegisterNZ(btmp);
-	memWrite(op, btmp);
-	cycles += 3;
+	btmp = (btmp << 1) | cpu->carry;
+	cpu->carry = newCarry >> 7;
+	setStatusRegisterNZ(cpu, btmp);
+	memWrite(cpu->machine, op, btmp);
 }
 
-static void ROL_A(void)
+static void ROL_A(M6502 *cpu, unsigned short op)
 {
-	tmp = (accumulator << 1) | (statusRegister & C ? 1 : 0);
-	accumulator = tmp & 0xFF;
-	setFlagCarry(tmp);
-	setStatusRegisterNZ(accumulator);
+	unsigned short tmp;
+
+	tmp = (cpu->accumulator << 1) | cpu->carry;
+	cpu->accumulator = tmp & 0xFF;
+	setFlagCarry(cpu, tmp);
+	setStatusRegisterNZ(cpu, cpu->accumulator);
 }
 
-static void ROR(void)
+static void ROR(M6502 *cpu, unsigned short op)
 {
 	int newCarry;
+	unsigned char btmp;
 
-	btmp = memRead(op);
+	btmp = memRead(cpu->machine, op);
 	newCarry = btmp & 1;
-	btmp = (btmp >> 1) | (statusRegister & C ? 0x80 : 0);
-	
-	if (newCarry)
-		statusRegister |= C;
-	else
-		statusRegister &= ~C;
-
-	setStatusRegisterNZ(btmp);
-	memWrite(op, btmp);
-	cycles += 3;
+	btmp = (btmp >> 1) | cpu->carry << 7;
+	cpu->carry = newCarry;
+	setStatusRegisterNZ(cpu, btmp);
+	memWrite(cpu->machine, op, btmp);
 }
 
-static void ROR_A(void)
+static void ROR_A(M6502 *cpu, unsigned short op)
 {
-	tmp = accumulator | (statusRegister & C ? 0x100 : 0);
-	
-	if (accumulator & 1)
-		statusRegister |= C;
-	else
-		statusRegister &= ~C;
+	unsigned short tmp;
 
-	accumulator = tmp >> 1;
-	setStatusRegisterNZ(accumulator);
+	tmp = cpu->accumulator | cpu->carry << 8;
+	cpu->carry = cpu->accumulator & 1;
+	cpu->accumulator = tmp >> 1;
+	setStatusRegisterNZ(cpu, cpu->accumulator);
 }
 
-static void INC(void)
+static void INC(M6502 *cpu, unsigned short op)
 {
-	btmp = memRead(op);
+	unsigned char btmp;
+
+	btmp = memRead(cpu->machine, op);
 	btmp++;
-	setStatusRegisterNZ(btmp);
-	memWrite(op, btmp);
-	cycles += 2;
+	setStatusRegisterNZ(cpu, btmp);
+	memWrite(cpu->machine, op, btmp);
 }
 
-static void DEC(void)
+static void DEC(M6502 *cpu, unsigned short op)
 {
-	btmp = memRead(op);
+	unsigned char btmp;
+
+	btmp = memRead(cpu->machine, op);
 	btmp--;
-	setStatusRegisterNZ(btmp);
-	memWrite(op, btmp);
-	cycles += 2;
+	setStatusRegisterNZ(cpu, btmp);
+	memWrite(cpu->machine, op, btmp);
 }
 
-static void INX(void)
+static void INX(M6502 *cpu, unsigned short op)
 {
-	xRegister++;
-	setStatusRegisterNZ(xRegister);
+	cpu->xRegister++;
+	setStatusRegisterNZ(cpu, cpu->xRegister);
 }
 
-static void INY(void)
+static void INY(M6502 *cpu, unsigned short op)
 {
-	yRegister++;
-	setStatusRegisterNZ(yRegister);
+	cpu->yRegister++;
+	setStatusRegisterNZ(cpu, cpu->yRegister);
 }
 
-static void DEX(void)
+static void DEX(M6502 *cpu, unsigned short op)
 {
-	xRegister--;
-	setStatusRegisterNZ(xRegister);
+	cpu->xRegister--;
+	setStatusRegisterNZ(cpu, cpu->xRegister);
 }
 
-static void DEY(void)
+static void DEY(M6502 *cpu, unsigned short op)
 {
-	yRegister--;
-	setStatusRegisterNZ(yRegister);
+	cpu->yRegister--;
+	setStatusRegisterNZ(cpu, cpu->yRegister);
 }
 
-static void BIT(void)
+static void BIT(M6502 *cpu, unsigned short op)
 {
-	btmp = memRead(op);
-
-	if (btmp & 0x40)
-		statusRegister |= V;
-	else
-		statusRegister &= ~V;
-	
-	if (btmp & 0x80)
-		statusRegister |= N;
-	else
-		statusRegister &= ~N;
+	unsigned char btmp;
 
-	if (!(btmp & accumulator))
-		statusRegister |= Z;
-	else
-		statusRegister &= ~Z;
-
-	cycles++;
+	btmp = memRead(cpu->machine, op);
+	cpu->overflow = btmp & V;
+	cpu->negative = btmp;
+	cpu->zero = btmp & cpu->accumulator;
 }
 
-static void PHA(void)
+static void PHA(M6502 *cpu, unsigned short op)
 {
-	memWrite((unsigned short)(0x100 + stackPointer), accumulator);
-	stackPointer--;
-	cycles++;
+	memWrite(cpu->machine, (unsigned short)(0x100 + cpu->stackPointer), cpu->accumulator);
+	cpu->stackPointer--;
 }
 
-static void PHP(void)
+static void PHP(M6502 *cpu, unsigned short op)
 {
-	memWrite((unsigned short)(0x100 + stackPointer), statusRegister);
-	stackPointer--;
-	cycles++;
+	memWrite(cpu->machine, (unsigned short)(0x100 + cpu->stackPointer), getStatusRegister(cpu));
+	cpu->stackPointer--;
 }
 
-static void PLA(void)
+static void PLA(M6502 *cpu, unsigned short op)
 {
-	stackPointer++;
-	accumulator = memRead((unsigned short)(stackPointer + 0x100));
-	setStatusRegisterNZ(accumulator);
-	cycles += 2;
+	cpu->stackPointer++;
+	cpu->accumulator = memRead(cpu->machine, (unsigned short)(cpu->stackPointer + 0x100));
+	setStatusRegisterNZ(cpu, cpu->accumulator);
 }
 
-static void PLP(void)
+static void PLP(M6502 *cpu, unsigned short op)
 {
-	stackPointer++;
-	statusRegister = memRead((unsigned short)(stackPointer + 0x100));
-	cycles += 2;
+	cpu->stackPointer++;
+	setStatusRegister(cpu, memRead(cpu->machine, (unsigned short)(cpu->stackPointer + 0x100)));
+	checkIRQ(cpu);
 }
 
-static void BRK(void)
+static void BRK(M6502 *cpu, unsigned short op)
 {
-	pushProgramCounter();
-	PHP();
-	statusRegister |= B;
-	programCounter = memReadAbsolute(0xFFFE);
-	cycles += 3;
+	pushProgramCounter(cpu);
+	PHP(cpu, op);
+	cpu->statusRegister |= B;
+	cpu->programCounter = memReadAbsolute(cpu, 0xFFFE);
 }
 
-static void RTI(void)
+static void RTI(M6502 *cpu, unsigned short op)
 {
-	PLP();
-	popProgramCounter();
-	cycles++;
+	PLP(cpu, op);
+	popProgramCounter(cpu);
 }
 
-static void JMP(void)
+static void JMP(M6502 *cpu, unsigned short op)
 {
-	programCounter = op;
+	cpu->programCounter = op;
 }
 
-static void RTS(void)
+static void RTS(M6502 *cpu, unsigned short op)
 {
-	popProgramCounter();
-	programCounter++;
-	cycles += 2;
+	popProgramCounter(cpu);
+	cpu->programCounter++;
 }
 
-static void JSR(void)
+static void JSR(M6502 *cpu, unsigned short op)
 {
-	opL = memRead(programCounter++);
-	pushProgramCounter();
-	programCounter = opL + (memRead(programCounter) << 8);
-	cycles += 3;
+	cpu->programCounter--;
+	pushProgramCounter(cpu);
+	cpu->programCounter = op;
 }
 
-static void branch(void)
+static void branch(M6502 *cpu, unsigned short op)
 {
-	cycles++;
+	cpu->cycles++;
 
-	if ((programCounter & 0xFF00) != (op & 0xFF00))
-		cycles++;
+	if ((cpu->programCounter & 0xFF00) != (op & 0xFF00))
+		cpu->cycles++;
 
-	programCounter = op;
+	cpu->programCounter = op;
 }
 
-static void BNE(void)
+static void BNE(M6502 *cpu, unsigned short op)
 {
-	if (!(statusRegister & Z))
-		branch();
+	if (cpu->zero)
+		branch(cpu, op);
 }
 
-static void BEQ(void)
+static void BEQ(M6502 *cpu, unsigned short op)
 {
-	if (statusRegister & Z)
-		branch();
+	if (!cpu->zero)
+		branch(cpu, op);
 }
 
-static void BVC(void)
+static void BVC(M6502 *cpu, unsigned short op)
 {
-	if (!(statusRegister & V))
-		branch();
+	if (!cpu->overflow)
+		branch(cpu, op);
 }
 
-static void BVS(void)
+static void BVS(M6502 *cpu, unsigned short op)
 {
-	if (statusRegister & V)
-		branch();
+	if (cpu->overflow)
+		branch(cpu, op);
 }
 
-static void BCC(void)
+static void BCC(M6502 *cpu, unsigned short op)
 {
-	if (!(statusRegister & C))
-		branch();
+	if (!cpu->carry)
+		branch(cpu, op);
 }
 
-static void BCS(void)
+static void BCS(M6502 *cpu, unsigned short op)
 {
-	if (statusRegister & C)
-		branch();
+	if (cpu->carry)
+		branch(cpu, op);
 }
 
-static void BPL(void)
+static void BPL(M6502 *cpu, unsigned short op)
 {
-	if (!(statusRegister & N))
-		branch();
+	if (!(cpu->negative & N))
+		branch(cpu, op);
 }
 
-static void BMI(void)
+static void BMI(M6502 *cpu, unsigned short op)
 {
-	if (statusRegister & N)
-		branch();
+	if (cpu->negative & N)
+		branch(cpu, op);
 }
 
-static void TAX(void)
+static void TAX(M6502 *cpu, unsigned short op)
 {
-	xRegister = accumulator;
-	setStatusRegisterNZ(accumulator);
+	cpu->xRegister = cpu->accumulator;
+	setStatusRegisterNZ(cpu, cpu->accumulator);
 }
 
-static void TXA(void)
+static void TXA(M6502 *cpu, unsigned short op)
 {
-	accumulator = xRegister;
-	setStatusRegisterNZ(accumulator);
+	cpu->accumulator = cpu->xRegister;
+	setStatusRegisterNZ(cpu, cpu->accumulator);
 }
 
-static void TAY(void)
+static void TAY(M6502 *cpu, unsigned short op)
 {
-	yRegister = accumulator;
-	setStatusRegisterNZ(accumulator);
+	cpu->yRegister = cpu->accumulator;
+	setStatusRegisterNZ(cpu, cpu->accumulator);
 }
 
-static void TYA(void)
+static void TYA(M6502 *cpu, unsigned short op)
 {
-	accumulator = yRegister;
-	setStatusRegisterNZ(accumulator);
+	cpu->accumulator = cpu->yRegister;
+	setStatusRegisterNZ(cpu, cpu->accumulator);
 }
 
-static void TXS(void)
+static void TXS(M6502 *cpu, unsigned short op)
 {
-	stackPointer = xRegister;
+	cpu->stackPointer = cpu->xRegister;
 }
 
-static void TSX(void)
+static void TSX(M6502 *cpu, unsigned short op)
 {
-	xRegister = stackPointer;
-	setStatusRegisterNZ(xRegister);
+	cpu->xRegister = cpu->stackPointer;
+	setStatusRegisterNZ(cpu, cpu->xRegister);
 }
 
-static void CLC(void)
+static void CLC(M6502 *cpu, unsigned short op)
 {
-	statusRegister &= ~C;
+	cpu->carry = 0;
 }
 
-static void SEC(void)
+static void SEC(M6502 *cpu, unsigned short op)
 {
-	statusRegister |= C;
+	cpu->carry = 1;
 }
 
-static void CLI(void)
+static void CLI(M6502 *cpu, unsigned short op)
 {
-	statusRegister &= ~I;
+	cpu->statusRegister &= ~I;
+	checkIRQ(cpu);
 }
 
-static void SEI(void)
+static void SEI(M6502 *cpu, unsigned short op)
 {
-	statusRegister |= I;
+	cpu->statusRegister |= I;
 }
 
-static void CLV(void)
+static void CLV(M6502 *cpu, unsigned short op)
 {
-	statusRegister &= ~V;
+	cpu->overflow = 0;
 }
 
-static void CLD(void)
+static void CLD(M6502 *cpu, unsigned short op)
 {
-	statusRegister &= ~D;
+	cpu->statusRegister &= ~D;
 }
 
-static void SED(void)
+static void SED(M6502 *cpu, unsigned short op)
 {
-	statusRegister |= D;
+	cpu->statusRegister |= D;
 }
 
-static void NOP(void)
+static void NOP(M6502 *cpu, unsigned short op)
 {
 }
 
-static void Unoff(void)
+static void Unoff(M6502 *cpu, unsigned short op)
 {
 }
 
-static void Unoff1(void)
+static void Unoff1(M6502 *cpu, unsigned short op)
 {
 }
 
-static void Unoff2(void)
+// KIL locks up the processor until it is reset. Instead of spinning on the
+// opcode the slice ends here and runM6502() parks the thread.
+static void Hang(M6502 *cpu, unsigned short op)
 {
-	programCounter++;
-}
+	cpu->programCounter--;
 
-static void Unoff3(void)
-{
-	programCounter += 2;
+	SDL_mutexP(cpu->idleMutex);
+	cpu->halted = 1;
+	cpu->haltAddress = cpu->programCounter;
+	cpu->haltCycles = cpu->elapsedCycles + cpu->cycles;
+	SDL_mutexV(cpu->idleMutex);
+
+	storeRelaxed(&cpu->deadline, 0);
 }
 
-static void Hang(void)
+#define OPCODE_MODE(code, mode, operation, baseCycles) mode##Mode,
+#define OPCODE_CYCLES(code, mode, operation, baseCycles) baseCycles,
+
+static const unsigned char opcodeModes[256] = { OPCODES(OPCODE_MODE) };
+static const unsigned char opcodeCycles[256] = { OPCODES(OPCODE_CYCLES) };
+
+static unsigned short decodeOpcode(M6502 *cpu, MicroOp *microOp, unsigned short address)
 {
-	programCounter--;
+	unsigned char opcode = memRead(cpu->machine, address);
+
+	microOp->opcode = opcode;
+	microOp->cycles = opcodeCycles[opcode];
+	microOp->last = microOp->idle = 0;
+
+	switch (opcodeModes[opcode])
+	{
+	case ImpMode:
+		microOp->operand = 0;
+		microOp->next = address + 1;
+		break;
+	case ImmMode:
+		microOp->operand = address + 1;
+		microOp->next = address + 2;
+		break;
+	case RelMode:
+		microOp->operand = memRead(cpu->machine, (unsigned short)(address + 1));
+
+		if (microOp->operand & 0x80)
+			microOp->operand |= 0xFF00;
+
+		microOp->next = address + 2;
+		microOp->operand += microOp->next;
+		break;
+	case AbsMode:
+	case AbsXMode:
+	case AbsYMode:
+	case IndMode:
+	case WAbsXMode:
+	case WAbsYMode:
+		microOp->operand = memReadAbsolute(cpu, (unsigned short)(address + 1));
+		microOp->next = address + 3;
+		break;
+	default:
+		microOp->operand = memRead(cpu->machine, (unsigned short)(address + 1));
+		microOp->next = address + 2;
+		break;
+	}
+
+	return microOp->next;
 }
 
-static void executeOpcode(void)
+static int endsBlock(unsigned char opcode)
 {
-	unsigned char opcode = memRead(programCounter++);
-
 	switch (opcode)
 	{
 	case 0x00:
-	    Imm();
-	    BRK();
-	    break;
-	case 0x01:
-	    IndZeroX();
-	    ORA();
-	    break;
 	case 0x02:
-	    Hang();
-	    break;
-	case 0x03:
-	    Unoff();
-	    break;
-	case 0x04:
-	    Unoff2();
-	    break;
-	case 0x05:
-	    Zero();
-	    ORA();
-	    break;
-	case 0x06:
-	    Zero();
-	    ASL();
-	    break;
-	case 0x07:
-	    Unoff();
-	    break;
-	case 0x08:
-	    Imp();
-	    PHP();
-	    break;
-	case 0x09:
-	    Imm();
-	    ORA();
-	    break;
-	case 0x0A:
-	    Imp();
-	    ASL_A();
-	    break;
-	case 0x0B:
-	    Imm();
-	    AND();
-	    break;
-	case 0x0C:
-	    Unoff3();
-	    break;
-	case 0x0D:
-	    Abs();
-	    ORA();
-	    break;
-	case 0x0E:
-	    Abs();
-	    ASL();
-	    break;
-	case 0x0F:
-	    Unoff();
-	    break;
-	case 0x10:
-	    Rel();
-	    BPL();
-	    break;
-	case 0x11:
-	    IndZeroY();
-	    ORA();
-	    break;
 	case 0x12:
-	    Hang();
-	    break;
-	case 0x13:
-	    Unoff();
-	    break;
-	case 0x14:
-	    Unoff2();
-	    break;
-	case 0x15:
-	    ZeroX();
-	    ORA();
-	    break;
-	case 0x16:
-	    ZeroX();
-	    ASL();
-	    break;
-	case 0x17:
-	    Unoff();
-	    break;
-	case 0x18:
-	    Imp();
-	    CLC();
-	    break;
-	case 0x19:
-	    AbsY();
-	    ORA();
-	    break;
-	case 0x1A:
-	    Unoff1();
-	    break;
-	case 0x1B:
-	    Unoff();
-	    break;
-	case 0x1C:
-	    Unoff3();
-	    break;
-	case 0x1D:
-	    AbsX();
-	    ORA();
-	    break;
-	case 0x1E:
-	    WAbsX();
-	    ASL();
-	    break;
-	case 0x1F:
-	    Unoff();
-	    break;
 	case 0x20:
-	    JSR();
-	    break;
-	case 0x21:
-	    IndZeroX();
-	    AND();
-	    break;
 	case 0x22:
-	    Hang();
-	    break;
-	case 0x23:
-	    Unoff();
-	    break;
-	case 0x24:
-	    Zero();
-	    BIT();
-	    break;
-	case 0x25:
-	    Zero();
-	    AND();
-	    break;
-	case 0x26:
-	    Zero();
-	    ROL();
-	    break;
-	case 0x27:
-	    Unoff();
-	    break;
-	case 0x28:
-	    Imp();
-	    PLP();
-	    break;
-	case 0x29:
-	    Imm();
-	    AND();
-	    break;
-	case 0x2A:
-	    Imp();
-	    ROL_A();
-	    break;
-	case 0x2B:
-	    Imm();
-	    AND();
-	    break;
-	case 0x2C:
-	    Abs();
-	    BIT();
-	    break;
-	case 0x2D:
-	    Abs();
-	    AND();
-	    break;
-	case 0x2E:
-	    Abs();
-	    ROL();
-	    break;
-	case 0x2F:
-	    Unoff();
-	    break;
-	case 0x30:
-	    Rel();
-	    BMI();
-	    break;
-	case 0x31:
-	    IndZeroY();
-	    AND();
-	    break;
 	case 0x32:
-	    Hang();
-	    break;
-	case 0x33:
-	    Unoff();
-	    break;
-	case 0x34:
-	    Unoff2();
-	    break;
-	case 0x35:
-	    ZeroX();
-	    AND();
-	    break;
-	case 0x36:
-	    ZeroX();
-	    ROL();
-	    break;
-	case 0x37:
-	    Unoff();
-	    break;
-	case 0x38:
-	    Imp();
-	    SEC();
-	    break;
-	case 0x39:
-	    AbsY();
-	    AND();
-	    break;
-	case 0x3A:
-	    Unoff1();
-	    break;
-	case 0x3B:
-	    Unoff();
-	    break;
-	case 0x3C:
-	    Unoff3();
-	    break;
-	case 0x3D:
-	    AbsX();
-	    AND();
-	    break;
-	case 0x3E:
-	    WAbsX();
-	    ROL();
-	    break;
-	case 0x3F:
-	    Unoff();
-	    break;
 	case 0x40:
-	    Imp();
-	    RTI();
-	    break;
-	case 0x41:
-	    IndZeroX();
-	    EOR();
-	    break;
 	case 0x42:
-	    Hang();
-	    break;
-	case 0x43:
-	    Unoff();
-	    break;
-	case 0x44:
-	    Unoff2();
-	    break;
-	case 0x45:
-	    Zero();
-	    EOR();
-	    break;
-	case 0x46:
-	    Zero();
-	    LSR();
-	    break;
-	case 0x47:
-	    Unoff();
-	    break;
-	case 0x48:
-	    Imp();
-	    PHA();
-	    break;
-	case 0x49:
-	    Imm();
-	    EOR();
-	    break;
-	case 0x4A:
-	    Imp();
-	    LSR_A();
-	    break;
-	case 0x4B:
-	    Unoff();
-	    break;
 	case 0x4C:
-	    Abs();
-	    JMP();
-	    break;
-	case 0x4D:
-	    Abs();
-	    EOR();
-	    break;
-	case 0x4E:
-	    Abs();
-	    LSR();
-	    break;
-	case 0x4F:
-	    Unoff();
-	    break;
-	case 0x50:
-	    Rel();
-	    BVC();
-	    break;
-	case 0x51:
-	    IndZeroY();
-	    EOR();
-	    break;
 	case 0x52:
-	    Hang();
-	    break;
-	case 0x53:
-	    Unoff();
-	    break;
-	case 0x54:
-	    Unoff2();
-	    break;
-	case 0x55:
-	    ZeroX();
-	    EOR();
-	    break;
-	case 0x56:
-	    ZeroX();
-	    LSR();
-	    break;
-	case 0x57:
-	    Unoff();
-	    break;
-	case 0x58:
-	    Imp();
-	    CLI();
-	    break;
-	case 0x59:
-	    AbsY();
-	    EOR();
-	    break;
-	case 0x5A:
-	    Unoff1();
-	    break;
-	case 0x5B:
-	    Unoff();
-	    break;
-	case 0x5C:
-	    Unoff3();
-	    break;
-	case 0x5D:
-	    AbsX();
-	    EOR();
-	    break;
-	case 0x5E:
-	    WAbsX();
-	    LSR();
-	    break;
-	case 0x5F:
-	    Unoff();
-	    break;
 	case 0x60:
-	    Imp();
-	    RTS();
-	    break;
-	case 0x61:
-	    IndZeroX();
-	    ADC();
-	    break;
 	case 0x62:
-	    Hang();
-	    break;
-	case 0x63:
-	    Unoff();
-	    break;
-	case 0x64:
-	    Unoff2();
-	    break;
-	case 0x65:
-	    Zero();
-	    ADC();
-	    break;
-	case 0x66:
-	    Zero();
-	    ROR();
-	    break;
-	case 0x67:
-	    Unoff();
-	    break;
-	case 0x68:
-	    Imp();
-	    PLA();
-	    break;
-	case 0x69:
-	    Imm();
-	    ADC();
-	    break;
-	case 0x6A:
-	    Imp();
-	    ROR_A();
-	    break;
-	case 0x6B:
-	    Unoff();
-	    break;
 	case 0x6C:
-	    Ind();
-	    JMP();
-	    break;
-	case 0x6D:
-	    Abs();
-	    ADC();
-	    break;
-	case 0x6E:
-	    Abs();
-	    ROR();
-	    break;
-	case 0x6F:
-	    Unoff();
-	    break;
-	case 0x70:
-	    Rel();
-	    BVS();
-	    break;
-	case 0x71:
-	    IndZeroY();
-	    ADC();
-	    break;
 	case 0x72:
-	    Hang();
-	    break;
-	case 0x73:
-	    Unoff();
-	    break;
-	case 0x74:
-	    Unoff2();
-	    break;
-	case 0x75:
-	    ZeroX();
-	    ADC();
-	    break;
-	case 0x76:
-	    ZeroX();
-	    ROR();
-	    break;
-	case 0x77:
-	    Unoff();
-	    break;
-	case 0x78:
-	    Imp();
-	    SEI();
-	    break;
-	case 0x79:
-	    AbsY();
-	    ADC();
-	    break;
-	case 0x7A:
-	    Unoff1();
-	    break;
-	case 0x7B:
-	    Unoff();
-	    break;
-	case 0x7C:
-	    Unoff3();
-	    break;
-	case 0x7D:
-	    AbsX();
-	    ADC();
-	    break;
-	case 0x7E:
-	    WAbsX();
-	    ROR();
-	    break;
-	case 0x7F:
-	    Unoff();
-	    break;
-	case 0x80:
-	    Unoff2();
-	    break;
-	case 0x81:
-	    IndZeroX();
-	    STA();
-	    break;
-	case 0x82:
-	    Unoff2();
-	    break;
-	case 0x83:
-	    Unoff();
-	    break;
-	case 0x84:
-	    Zero();
-	    STY();
-	    break;
-	case 0x85:
-	    Zero();
-	    STA();
-	    break;
-	case 0x86:
-	    Zero();
-	    STX();
-	    break;
-	case 0x87:
-	    Unoff();
-	    break;
-	case 0x88:
-	    Imp();
-	    DEY();
-	    break;
-	case 0x89:
-	    Unoff2();
-	    break;
-	case 0x8A:
-	    Imp();
-	    TXA();
-	    break;
-	case 0x8B:
-	    Unoff();
-	    break;
-	case 0x8C:
-	    Abs();
-	    STY();
-	    break;
-	case 0x8D:
-	    Abs();
-	    STA();
-	    break;
-	case 0x8E:
-	    Abs();
-	    STX();
-	    break;
-	case 0x8F:
-	    Unoff();
-	    break;
-	case 0x90:
-	    Rel();
-	    BCC();
-	    break;
-	case 0x91:
-	    WIndZeroY();
-	    STA();
-	    break;
 	case 0x92:
-	    Hang();
-	    break;
-	case 0x93:
-	    Unoff();
-	    break;
-	case 0x94:
-	    ZeroX();
-	    STY();
-	    break;
-	case 0x95:
-	    ZeroX();
-	    STA();
-	    break;
-	case 0x96:
-	    ZeroY();
-	    STX();
-	    break;
-	case 0x97:
-	    Unoff();
-	    break;
-	case 0x98:
-	    Imp();
-	    TYA();
-	    break;
-	case 0x99:
-	    WAbsY();
-	    STA();
-	    break;
-	case 0x9A:
-	    Imp();
-	    TXS();
-	    break;
-	case 0x9B:
-	    Unoff();
-	    break;
-	case 0x9C:
-	    Unoff();
-	    break;
-	case 0x9D:
-	    WAbsX();
-	    STA();
-	    break;
-	case 0x9E:
-	    Unoff();
-	    break;
-	case 0x9F:
-	    Unoff();
-	    break;
-	case 0xA0:
-	    Imm();
-	    LDY();
-	    break;
-	case 0xA1:
-	    IndZeroX();
-	    LDA();
-	    break;
-	case 0xA2:
-	    Imm();
-	    LDX();
-	    break;
-	case 0xA3:
-	    Unoff();
-	    break;
-	case 0xA4:
-	    Zero();
-	    LDY();
-	    break;
-	case 0xA5:
-	    Zero();
-	    LDA();
-	    break;
-	case 0xA6:
-	    Zero();
-	    LDX();
-	    break;
-	case 0xA7:
-	    Unoff();
-	    break;
-	case 0xA8:
-	    Imp();
-	    TAY();
-	    break;
-	case 0xA9:
-	    Imm();
-	    LDA();
-	    break;
-	case 0xAA:
-	    Imp();
-	    TAX();
-	    break;
-	case 0xAB:
-	    Unoff();
-	    break;
-	case 0xAC:
-	    Abs();
-	    LDY();
-	    break;
-	case 0xAD:
-	    Abs();
-	    LDA();
-	    break;
-	case 0xAE:
-	    Abs();
-	    LDX();
-	    break;
-	case 0xAF:
-	    Unoff();
-	    break;
-	case 0xB0:
-	    Rel();
-	    BCS();
-	    break;
-	case 0xB1:
-	    IndZeroY();
-	    LDA();
-	    break;
 	case 0xB2:
-	    Hang();
-	    break;
-	case 0xB3:
-	    Unoff();
-	    break;
-	case 0xB4:
-	    ZeroX();
-	    LDY();
-	    break;
-	case 0xB5:
-	    ZeroX();
-	    LDA();
-	    break;
-	case 0xB6:
-	    ZeroY();
-	    LDX();
-	    break;
-	case 0xB7:
-	    Unoff();
-	    break;
-	case 0xB8:
-	    Imp();
-	    CLV();
-	    break;
-	case 0xB9:
-	    AbsY();
-	    LDA();
-	    break;
-	case 0xBA:
-	    Imp();
-	    TSX();
-	    break;
-	case 0xBB:
-	    Unoff();
-	    break;
-	case 0xBC:
-	    AbsX();
-	    LDY();
-	    break;
-	case 0xBD:
-	    AbsX();
-	    LDA();
-	    break;
-	case 0xBE:
-	    AbsY();
-	    LDX();
-	    break;
-	case 0xBF:
-	    Unoff();
-	    break;
-	case 0xC0:
-	    Imm();
-	    CPY();
-	    break;
-	case 0xC1:
-	    IndZeroX();
-	    CMP();
-	    break;
-	case 0xC2:
-	    Unoff2();
-	    break;
-	case 0xC3:
-	    Unoff();
-	    break;
-	case 0xC4:
-	    Zero();
-	    CPY();
-	    break;
-	case 0xC5:
-	    Zero();
-	    CMP();
-	    break;
-	case 0xC6:
-	    Zero();
-	    DEC();
-	    break;
-	case 0xC7:
-	    Unoff();
-	    break;
-	case 0xC8:
-	    Imp();
-	    INY();
-	    break;
-	case 0xC9:
-	    Imm();
-	    CMP();
-	    break;
-	case 0xCA:
-	    Imp();
-	    DEX();
-	    break;
-	case 0xCB:
-	    Unoff();
-	    break;
-	case 0xCC:
-	    Abs();
-	    CPY();
-	    break;
-	case 0xCD:
-	    Abs();
-	    CMP();
-	    break;
-	case 0xCE:
-	    Abs();
-	    DEC();
-	    break;
-	case 0xCF:
-	    Unoff();
-	    break;
-	case 0xD0:
-	    Rel();
-	    BNE();
-	    break;
-	case 0xD1:
-	    IndZeroY();
-	    CMP();
-	    break;
 	case 0xD2:
-	    Hang();
-	    break;
-	case 0xD3:
-	    Unoff();
-	    break;
-	case 0xD4:
-	    Unoff2();
-	    break;
-	case 0xD5:
-	    ZeroX();
-	    CMP();
-	    break;
-	case 0xD6:
-	    ZeroX();
-	    DEC();
-	    break;
-	case 0xD7:
-	    Unoff();
-	    break;
-	case 0xD8:
-	    Imp();
-	    CLD();
-	    break;
-	case 0xD9:
-	    AbsY();
-	    CMP();
-	    break;
-	case 0xDA:
-	    Unoff1();
-	    break;
-	case 0xDB:
-	    Unoff();
-	    break;
-	case 0xDC:
-	    Unoff3();
-	    break;
-	case 0xDD:
-	    AbsX();
-	    CMP();
-	    break;
-	case 0xDE:
-	    WAbsX();
-	    DEC();
-	    break;
-	case 0xDF:
-	    Unoff();
-	    break;
-	case 0xE0:
-	    Imm();
-	    CPX();
-	    break;
-	case 0xE1:
-	    IndZeroX();
-	    SBC();
-	    break;
-	case 0xE2:
-	    Unoff2();
-	    break;
-	case 0xE3:
-	    Unoff();
-	    break;
-	case 0xE4:
-	    Zero();
-	    CPX();
-	    break;
-	case 0xE5:
-	    Zero();
-	    SBC();
-	    break;
-	case 0xE6:
-	    Zero();
-	    INC();
-	    break;
-	case 0xE7:
-	    Unoff();
-	    break;
-	case 0xE8:
-	    Imp();
-	    INX();
-	    break;
-	case 0xE9:
-	    Imm();
-	    SBC();
-	    break;
-	case 0xEA:
-	    Imp();
-	    NOP();
-	    break;
-	case 0xEB:
-	    Imm();
-	    SBC();
-	    break;
-	case 0xEC:
-	    Abs();
-	    CPX();
-	    break;
-	case 0xED:
-	    Abs();
-	    SBC();
-	    break;
-	case 0xEE:
-	    Abs();
-	    INC();
-	    break;
-	case 0xEF:
-	    Unoff();
-	    break;
-	case 0xF0:
-	    Rel();
-	    BEQ();
-	    break;
-	case 0xF1:
-	    IndZeroY();
-	    SBC();
-	    break;
 	case 0xF2:
-	    Hang();
-	    break;
-	case 0xF3:
-	    Unoff();
-	    break;
-	case 0xF4:
-	    Unoff2();
-	    break;
-	case 0xF5:
-	    ZeroX();
-	    SBC();
-	    break;
-	case 0xF6:
-	    ZeroX();
-	    INC();
-	    break;
-	case 0xF7:
-	    Unoff();
-	    break;
-	case 0xF8:
-	    Imp();
-	    SED();
-	    break;
-	case 0xF9:
-	    AbsY();
-	    SBC();
-	    break;
-	case 0xFA:
-	    Unoff1();
-	    break;
-	case 0xFB:
-	    Unoff();
-	    break;
-	case 0xFC:
-	    Unoff3();
-	    break;
-	case 0xFD:
-	    AbsX();
-	    SBC();
-	    break;
-	case 0xFE:
-	    WAbsX();
-	    INC();
-	    break;
-	case 0xFF:
-	    Unoff();
-	    break;
+		return 1;
 	}
+
+	return 0;
 }
 
-static int runM6502(void *data)
+// LDA $D011 or BIT $D011 followed by a BPL back to itself: the monitor and
+// BASIC wait for a key this way and nothing else happens until one arrives.
+static int isIdleLoop(const MicroOp *block, unsigned short address)
+{
+	return (block[0].opcode == 0xAD || block[0].opcode == 0x2C) && block[0].operand == 0xD011 && !block[0].last && block[1].opcode == 0x10 && block[1].operand == address;
+}
+
+static void flushBlocks(M6502 *cpu)
+{
+	memset(cpu->blocks, 0, sizeof(cpu->blocks));
+	memset(cpu->nativeBlocks, 0, sizeof(cpu->nativeBlocks));
+	memset(cpu->blockHits, 0, sizeof(cpu->blockHits));
+	cpu->microOpCount = 0;
+	cpu->nativeSize = 0;
+}
+
+static const MicroOp *fetchBlock(M6502 *cpu)
+{
+	unsigned short address = cpu->programCounter, next;
+	unsigned char page = address >> 8;
+	MicroOp *block;
+	int length = 0;
+
+	cpu->blockInvalidated = 0;
+
+	if (cpu->blocks[address])
+		return &cpu->microOps[cpu->blocks[address] - 1];
+
+	if (isDevicePage(cpu->machine, page))
+	{
+		decodeOpcode(cpu, &cpu->uncachedOp, address);
+		cpu->uncachedOp.last = 1;
+		return &cpu->uncachedOp;
+	}
+
+	if (cpu->microOpCount + BLOCK_LENGTH > MICRO_OPS || cpu->nativeSize + BLOCK_LENGTH * NATIVE_OP_SIZE > NATIVE_SIZE)
+		flushBlocks(cpu);
+
+	block = &cpu->microOps[cpu->microOpCount];
+
+	do
+	{
+		next = decodeOpcode(cpu, &block[length], address);
+
+		if ((unsigned short)(next - 1) >> 8 != page)
+			break;
+
+		address = next;
+	}
+	while (!endsBlock(block[length++].opcode) && length < BLOCK_LENGTH && address >> 8 == page);
+
+	if (!length)
+	{
+		block->last = 1;
+		cpu->uncachedOp = *block;
+		return &cpu->uncachedOp;
+	}
+
+	block[length - 1].last = 1;
+	block->idle = isIdleLoop(block, cpu->programCounter);
+	cpu->blocks[cpu->programCounter] = cpu->microOpCount + 1;
+	cpu->microOpCount += length;
+	setCodePage(cpu->machine, page);
+
+	return block;
+}
+
+void invalidateCodePage(Machine *machine, unsigned char page)
 {
-	while (running)
+	M6502 *cpu = machine->cpu;
+
+	memset(&cpu->blocks[page << 8], 0, 256 * sizeof(cpu->blocks[0]));
+	memset(&cpu->nativeBlocks[page << 8], 0, 256 * sizeof(cpu->nativeBlocks[0]));
+	memset(&cpu->blockHits[page << 8], 0, 256 * sizeof(cpu->blockHits[0]));
+	cpu->blockInvalidated = 1;
+	cpu->validPages[page] = 0;
+
+	if (cpu->recompiledPages[page])
+		cpu->recompiledPages[page] = 1;
+}
+
+static int validateRecompiledPage(M6502 *cpu, unsigned char page)
+{
+	const unsigned char *memory = getMemory(cpu->machine);
+	unsigned int i;
+
+	if (isDevicePage(cpu->machine, page))
+	{
+		cpu->recompiledPages[page] = 2;
+		return 0;
+	}
+
+	setCodePage(cpu->machine, page);
+
+	for (i = cpu->recompiledIndex[page]; i < cpu->recompiledIndex[page + 1]; i++)
 	{
-		synchronize();
-		
-		cycles = 0;
-		
-		while (running && cycles < cyclesBeforeSynchro)
+		if (memory[cpu->recompiledModule->addresses[i]] != cpu->recompiledModule->bytes[i])
 		{
-			if (!(statusRegister & I) && IRQ)
-				handleIRQ();
-			if (NMI)
-				handleNMI();
-			
-			executeOpcode();
+			cpu->recompiledPages[page] = 2;
+			return 0;
 		}
 	}
 
-	return 0;
+	cpu->validPages[page] = 1;
+
+	return 1;
+}
+
+static int runRecompiled(M6502 *cpu)
+{
+	RecompilerState *state = &cpu->recompilerState;
+	int executed;
+
+	if (!cpu->validPages[cpu->programCounter >> 8] && (cpu->recompiledPages[cpu->programCounter >> 8] != 1 || !validateRecompiledPage(cpu, cpu->programCounter >> 8)))
+		return 0;
+
+	state->accumulator = cpu->accumulator;
+	state->xRegister = cpu->xRegister;
+	state->yRegister = cpu->yRegister;
+	state->statusRegister = getStatusRegister(cpu);
+	state->stackPointer = cpu->stackPointer;
+	state->programCounter = cpu->programCounter;
+	state->cycles = cpu->cycles;
+
+	executed = cpu->recompiledModule->run(state);
+
+	cpu->accumulator = state->accumulator;
+	cpu->xRegister = state->xRegister;
+	cpu->yRegister = state->yRegister;
+	setStatusRegister(cpu, state->statusRegister);
+	cpu->stackPointer = state->stackPointer;
+	cpu->programCounter = state->programCounter;
+	cpu->cycles = state->cycles;
+	cpu->instructions += executed;
+
+	return executed;
 }
 
-void startM6502(void)
+static unsigned char readRecompiled(void *machine, unsigned short address)
 {
-	running = 1;
-	lastTime = SDL_GetTicks();
-	thread = SDL_CreateThread(runM6502, NULL);
+	return memRead((Machine *)machine, address);
 }
 
-void stopM6502(void)
+static void writeRecompiled(void *machine, unsigned short address, unsigned char value)
+{
+	memWrite((Machine *)machine, address, value);
+}
+
+#ifdef M6502_JIT
+
+#define OPCODE_FUNCTION(code, mode, operation, baseCycles) static void function##code(M6502 *cpu) { operation(cpu, mode(cpu)); }
+#define OPCODE_POINTER(code, mode, operation, baseCycles) function##code,
+
+OPCODES(OPCODE_FUNCTION)
+
+static void (*const opcodeFunctions[256])(M6502 *cpu) = { OPCODES(OPCODE_POINTER) };
+
+static void emitByte(M6502 *cpu, unsigned char value)
 {
-	running = 0;
-	SDL_WaitThread(thread, NULL);
+	*cpu->emit++ = value;
 }
 
-void resetM6502(void)
+static void emitWord(M6502 *cpu, unsigned short value)
 {
-	statusRegister |= I;
-	stackPointer = 0xFF;
-	programCounter = memReadAbsolute(0xFFFC);
+	emitByte(cpu, (unsigned char)value);
+	emitByte(cpu, (unsigned char)(value >> 8));
 }
 
-void setSpeed(int freq, int synchroMillis)
+static void emitLong(M6502 *cpu, unsigned int value)
 {
-	cyclesBeforeSynchro = synchroMillis * freq;
-	_synchroMillis = synchroMillis;
+	emitWord(cpu, (unsigned short)value);
+	emitWord(cpu, (unsigned short)(value >> 16));
 }
 
-void setIRQ(int state)
+static void emitQuad(M6502 *cpu, unsigned long long value)
 {
-	IRQ = state;
+	emitLong(cpu, (unsigned int)value);
+	emitLong(cpu, (unsigned int)(value >> 32));
 }
 
-void setNMI(void)
+// Every field is addressed relative to rbx, which holds the cpu pointer.
+static void emitDisplacement(M6502 *cpu, const void *field)
 {
-	NMI = 1;
+	emitLong(cpu, (unsigned int)((const char *)field - (const char *)cpu));
 }
 
-int *dumpState(void)
+static unsigned char *emitJump(M6502 *cpu, unsigned char condition)
 {
-	int *state = (int *)malloc(sizeof(int) * 6);
+	emitByte(cpu, 0x0F);
+	emitByte(cpu, condition);
+	emitLong(cpu, 0);
 
-	state[0] = programCounter;
-	state[1] = statusRegister;
-	state[2] = accumulator;
-	state[3] = xRegister;
-	state[4] = yRegister;
-	state[5] = stackPointer;
+	return cpu->emit - 4;
+}
 
-	return state;
+static void emitStoreProgramCounter(M6502 *cpu, unsigned short value)
+{
+	emitByte(cpu, 0x66);					// mov word [programCounter], value
+	emitByte(cpu, 0xC7);
+	emitByte(cpu, 0x83);
+	emitDisplacement(cpu, &cpu->programCounter);
+	emitWord(cpu, value);
+}
+
+static void patchJump(unsigned char *jump, const unsigned char *target)
+{
+	unsigned int displacement = (unsigned int)(target - (jump + 4));
+
+	jump[0] = (unsigned char)displacement;
+	jump[1] = (unsigned char)(displacement >> 8);
+	jump[2] = (unsigned char)(displacement >> 16);
+	jump[3] = (unsigned char)(displacement >> 24);
+}
+
+static void emitLoad(M6502 *cpu, const unsigned char *field)
+{
+	emitByte(cpu, 0x0F);					// movzx eax, byte [field]
+	emitByte(cpu, 0xB6);
+	emitByte(cpu, 0x83);
+	emitDisplacement(cpu, field);
+}
+
+static void emitStore(M6502 *cpu, const unsigned char *field)
+{
+	emitByte(cpu, 0x88);					// mov byte [field], al
+	emitByte(cpu, 0x83);
+	emitDisplacement(cpu, field);
+}
+
+static void emitStatusRegisterNZ(M6502 *cpu)
+{
+	emitStore(cpu, &cpu->negative);
+	emitStore(cpu, &cpu->zero);
+}
+
+static void emitStatusRegisterFlag(M6502 *cpu, int set, unsigned char flag)
+{
+	emitByte(cpu, 0x80);					// or/and byte [statusRegister], flag
+	emitByte(cpu, set ? 0x8B : 0xA3);
+	emitDisplacement(cpu, &cpu->statusRegister);
+	emitByte(cpu, set ? flag : (unsigned char)~flag);
+}
+
+static void emitStoreImmediate(M6502 *cpu, unsigned char *field, unsigned char value)
+{
+	emitByte(cpu, 0xC6);					// mov byte [field], value
+	emitByte(cpu, 0x83);
+	emitDisplacement(cpu, field);
+	emitByte(cpu, value);
+}
+
+static void emitTransfer(M6502 *cpu, const unsigned char *source, unsigned char *destination, int flags)
+{
+	emitLoad(cpu, source);
+	emitStore(cpu, destination);
+
+	if (flags)
+		emitStatusRegisterNZ(cpu);
+}
+
+static void emitIncrement(M6502 *cpu, unsigned char *field, int decrement)
+{
+	emitLoad(cpu, field);
+	emitByte(cpu, 0xFE);					// inc/dec al
+	emitByte(cpu, decrement ? 0xC8 : 0xC0);
+	emitStore(cpu, field);
+	emitStatusRegisterNZ(cpu);
+}
+
+static void emitLoadImmediate(M6502 *cpu, unsigned char *field, unsigned char value)
+{
+	emitStoreImmediate(cpu, field, value);
+	emitStoreImmediate(cpu, &cpu->negative, value);
+	emitStoreImmediate(cpu, &cpu->zero, value);
+}
+
+// Where the exits of the block being translated are, and the cycles and
+// instructions it has run since they were last added to the counters. The
+// counters are only brought up to date where something can look at them:
+// around calls into C and on the way out.
+typedef struct
+{
+	unsigned char *exits[BLOCK_LENGTH * 4], *body;
+	int exitCount, cycles, instructions, bound;
+	unsigned short start;
+} Translation;
+
+#define OPCODE_OPERATION(code, mode, operation, baseCycles) operation,
+
+static void (*const opcodeOperations[256])(M6502 *cpu, unsigned short op) = { OPCODES(OPCODE_OPERATION) };
+
+static unsigned char *emitGoto(M6502 *cpu)
+{
+	emitByte(cpu, 0xE9);					// jmp
+	emitLong(cpu, 0);
+
+	return cpu->emit - 4;
+}
+
+static void emitAddCycles(M6502 *cpu, int cycles)
+{
+	if (!cycles)
+		return;
+
+	emitByte(cpu, 0x81);					// add dword [cycles], cycles
+	emitByte(cpu, 0x83);
+	emitDisplacement(cpu, &cpu->cycles);
+	emitLong(cpu, (unsigned int)cycles);
+}
+
+static void emitFlushCounters(M6502 *cpu, const Translation *t, int cycles)
+{
+	emitAddCycles(cpu, t->cycles + cycles);
+	emitByte(cpu, 0x48);					// add qword [instructions], instructions
+	emitByte(cpu, 0x83);
+	emitByte(cpu, 0x83);
+	emitDisplacement(cpu, &cpu->instructions);
+	emitByte(cpu, (unsigned char)t->instructions);
+}
+
+// Leaves the block with programCounter set to address, or as it is when
+// address is negative. cycles is what the way out adds to the block's own.
+static void emitExit(M6502 *cpu, Translation *t, int cycles, int address)
+{
+	emitFlushCounters(cpu, t, cycles);
+
+	if (address >= 0)
+		emitStoreProgramCounter(cpu, (unsigned short)address);
+
+	t->exits[t->exitCount++] = emitGoto(cpu);
 }
 
-void loadState(int *state)
+// A branch or jump back to the start of the block goes round again as long
+// as the deadline allows.
+static void emitLoop(M6502 *cpu, Translation *t, int cycles)
 {
-	programCounter = state[0];
-	statusRegister = state[1];
-	accumulator = state[2];
-	xRegister = state[3];
-	yRegister = state[4];
-	stackPointer = state[5];
+	emitFlushCounters(cpu, t, cycles);
+	emitByte(cpu, 0x8B);					// mov eax, [cycles]
+	emitByte(cpu, 0x83);
+	emitDisplacement(cpu, &cpu->cycles);
+	emitByte(cpu, 0x05);					// add eax, bound
+	emitLong(cpu, (unsigned int)t->bound);
+	emitByte(cpu, 0x3B);					// cmp eax, [deadline]
+	emitByte(cpu, 0x83);
+	emitDisplacement(cpu, &cpu->deadline);
+	patchJump(emitJump(cpu, 0x8C), t->body);		// jl body
+	emitStoreProgramCounter(cpu, t->start);
+	t->exits[t->exitCount++] = emitGoto(cpu);
+}
+
+static void emitCall(M6502 *cpu, const Translation *t, const void *function)
+{
+	emitAddCycles(cpu, t->cycles);
+	emitByte(cpu, 0x48);					// mov rax, function
+	emitByte(cpu, 0xB8);
+	emitQuad(cpu, (unsigned long long)function);
+	emitByte(cpu, 0xFF);					// call rax
+	emitByte(cpu, 0xD0);
+	emitAddCycles(cpu, -t->cycles);
+}
+
+static void emitLoadMachine(M6502 *cpu)
+{
+	emitByte(cpu, 0x48);					// mov rdi, [machine]
+	emitByte(cpu, 0x8B);
+	emitByte(cpu, 0xBB);
+	emitDisplacement(cpu, &cpu->machine);
+}
+
+// Runs the instruction through the interpreter's handler.
+static void emitHandler(M6502 *cpu, const Translation *t, const MicroOp *block)
+{
+	if (opcodeModes[block->opcode] != ImpMode)
+	{
+		emitByte(cpu, 0x66);				// mov word [operand], operand
+		emitByte(cpu, 0xC7);
+		emitByte(cpu, 0x83);
+		emitDisplacement(cpu, &cpu->operand);
+		emitWord(cpu, block->operand);
+	}
+
+	emitByte(cpu, 0x48);					// mov rdi, rbx
+	emitByte(cpu, 0x89);
+	emitByte(cpu, 0xDF);
+	emitCall(cpu, t, (const void *)opcodeFunctions[block->opcode]);
+}
+
+// A store that went through memWrite() may have hit the page the block is
+// on, in which case the rest of it must not run.
+static void emitInvalidationCheck(M6502 *cpu, Translation *t, unsigned short next)
+{
+	unsigned char *valid;
+
+	emitByte(cpu, 0x83);					// cmp dword [blockInvalidated], 0
+	emitByte(cpu, 0xBB);
+	emitDisplacement(cpu, &cpu->blockInvalidated);
+	emitByte(cpu, 0x00);
+	valid = emitJump(cpu, 0x84);				// je valid
+	emitExit(cpu, t, 0, next);
+	patchJump(valid, cpu->emit);
+}
+
+// r12 and r13 hold the read and write page tables, r14 the effective address
+// when it is only known at run time. A page without a pointer goes through
+// memRead() or memWrite(), as it would in the interpreter.
+static void emitLookup(M6502 *cpu, int write, int address)
+{
+	if (address >= 0)
+	{
+		emitByte(cpu, 0x49);				// mov rax/rdx, [r12/r13 + page * 8]
+		emitByte(cpu, 0x8B);
+		emitByte(cpu, write ? 0x94 : 0x84);
+		emitByte(cpu, write ? 0x25 : 0x24);
+		emitLong(cpu, (unsigned int)(address >> 8) * 8);
+	}
+	else
+	{
+		emitByte(cpu, 0x44);				// mov ecx, r14d
+		emitByte(cpu, 0x89);
+		emitByte(cpu, 0xF1);
+		emitByte(cpu, 0xC1);				// shr ecx, 8
+		emitByte(cpu, 0xE9);
+		emitByte(cpu, 0x08);
+		emitByte(cpu, 0x49);				// mov rax/rdx, [r12/r13 + rcx * 8]
+
+		if (write)
+		{
+			emitByte(cpu, 0x8B);
+			emitByte(cpu, 0x54);
+			emitByte(cpu, 0xCD);
+			emitByte(cpu, 0x00);
+		}
+		else
+		{
+			emitByte(cpu, 0x8B);
+			emitByte(cpu, 0x04);
+			emitByte(cpu, 0xCC);
+		}
+	}
+
+	emitByte(cpu, 0x48);					// test rax/rdx, rax/rdx
+	emitByte(cpu, 0x85);
+	emitByte(cpu, write ? 0xD2 : 0xC0);
+}
+
+static void emitAddressArgument(M6502 *cpu, int address)
+{
+	if (address >= 0)
+	{
+		emitByte(cpu, 0xBE);				// mov esi, address
+		emitLong(cpu, (unsigned int)address);
+	}
+	else
+	{
+		emitByte(cpu, 0x44);				// mov esi, r14d
+		emitByte(cpu, 0x89);
+		emitByte(cpu, 0xF6);
+	}
+}
+
+// Leaves the byte at address, or at r14 when address is negative, in eax.
+static void emitRead(M6502 *cpu, const Translation *t, int address)
+{
+	unsigned char *slow, *done;
+
+	emitLookup(cpu, 0, address);
+	slow = emitJump(cpu, 0x84);				// jz slow
+
+	if (address >= 0)
+	{
+		emitByte(cpu, 0x0F);				// movzx eax, byte [rax + offset]
+		emitByte(cpu, 0xB6);
+		emitByte(cpu, 0x80);
+		emitLong(cpu, (unsigned int)address & 0xFF);
+	}
+	else
+	{
+		emitByte(cpu, 0x41);				// movzx ecx, r14b
+		emitByte(cpu, 0x0F);
+		emitByte(cpu, 0xB6);
+		emitByte(cpu, 0xCE);
+		emitByte(cpu, 0x0F);				// movzx eax, byte [rax + rcx]
+		emitByte(cpu, 0xB6);
+		emitByte(cpu, 0x04);
+		emitByte(cpu, 0x08);
+	}
+
+	done = emitGoto(cpu);
+	patchJump(slow, cpu->emit);
+	emitLoadMachine(cpu);
+	emitAddressArgument(cpu, address);
+	emitCall(cpu, t, (const void *)memRead);
+	emitByte(cpu, 0x0F);					// movzx eax, al
+	emitByte(cpu, 0xB6);
+	emitByte(cpu, 0xC0);
+	patchJump(done, cpu->emit);
+}
+
+// Stores al at address, or at r14 when address is negative.
+static void emitWrite(M6502 *cpu, Translation *t, int address, unsigned short next)
+{
+	unsigned char *slow, *done;
+
+	emitLookup(cpu, 1, address);
+	slow = emitJump(cpu, 0x84);				// jz slow
+
+	if (address >= 0)
+	{
+		emitByte(cpu, 0x88);				// mov [rdx + offset], al
+		emitByte(cpu, 0x82);
+		emitLong(cpu, (unsigned int)address & 0xFF);
+	}
+	else
+	{
+		emitByte(cpu, 0x41);				// movzx ecx, r14b
+		emitByte(cpu, 0x0F);
+		emitByte(cpu, 0xB6);
+		emitByte(cpu, 0xCE);
+		emitByte(cpu, 0x88);				// mov [rdx + rcx], al
+		emitByte(cpu, 0x04);
+		emitByte(cpu, 0x0A);
+	}
+
+	done = emitGoto(cpu);
+	patchJump(slow, cpu->emit);
+	emitByte(cpu, 0x89);					// mov edx, eax
+	emitByte(cpu, 0xC2);
+	emitLoadMachine(cpu);
+	emitAddressArgument(cpu, address);
+	emitCall(cpu, t, (const void *)memWrite);
+	emitInvalidationCheck(cpu, t, next);
+	patchJump(done, cpu->emit);
+}
+
+static void emitPageCrossing(M6502 *cpu, unsigned int limit)
+{
+	unsigned char *same;
+
+	emitByte(cpu, 0x41);					// cmp r14d, limit
+	emitByte(cpu, 0x81);
+	emitByte(cpu, 0xFE);
+	emitLong(cpu, limit);
+	same = emitJump(cpu, 0x86);				// jbe same
+	emitByte(cpu, 0x83);					// add dword [cycles], 1
+	emitByte(cpu, 0x83);
+	emitDisplacement(cpu, &cpu->cycles);
+	emitByte(cpu, 1);
+	patchJump(same, cpu->emit);
+}
+
+static void emitIndexed(M6502 *cpu, const MicroOp *block, const unsigned char *index, int crossing)
+{
+	emitByte(cpu, 0x44);					// movzx r14d, byte [index]
+	emitByte(cpu, 0x0F);
+	emitByte(cpu, 0xB6);
+	emitByte(cpu, 0xB3);
+	emitDisplacement(cpu, index);
+	emitByte(cpu, 0x41);					// add r14d, operand
+	emitByte(cpu, 0x81);
+	emitByte(cpu, 0xC6);
+	emitLong(cpu, block->operand);
+
+	if (crossing && (block->operand & 0xFF))
+		emitPageCrossing(cpu, block->operand | 0xFF);
+
+	emitByte(cpu, 0x45);					// movzx r14d, r14w
+	emitByte(cpu, 0x0F);
+	emitByte(cpu, 0xB7);
+	emitByte(cpu, 0xF6);
+}
+
+static void emitZeroIndexed(M6502 *cpu, const MicroOp *block, const unsigned char *index)
+{
+	emitByte(cpu, 0x44);					// movzx r14d, byte [index]
+	emitByte(cpu, 0x0F);
+	emitByte(cpu, 0xB6);
+	emitByte(cpu, 0xB3);
+	emitDisplacement(cpu, index);
+	emitByte(cpu, 0x41);					// add r14b, operand
+	emitByte(cpu, 0x80);
+	emitByte(cpu, 0xC6);
+	emitByte(cpu, (unsigned char)block->operand);
+}
+
+// The pointers of the indirect modes are read straight from the zero page,
+// or the whole instruction goes to the handler if it has no pointer.
+static unsigned char *emitZeroPage(M6502 *cpu)
+{
+	emitByte(cpu, 0x49);					// mov rax, [r12]
+	emitByte(cpu, 0x8B);
+	emitByte(cpu, 0x04);
+	emitByte(cpu, 0x24);
+	emitByte(cpu, 0x48);					// test rax, rax
+	emitByte(cpu, 0x85);
+	emitByte(cpu, 0xC0);
+
+	return emitJump(cpu, 0x84);				// jz handler
+}
+
+static unsigned char *emitIndirectX(M6502 *cpu, const MicroOp *block)
+{
+	unsigned char *handler = emitZeroPage(cpu);
+
+	emitByte(cpu, 0x0F);					// movzx ecx, byte [xRegister]
+	emitByte(cpu, 0xB6);
+	emitByte(cpu, 0x8B);
+	emitDisplacement(cpu, &cpu->xRegister);
+	emitByte(cpu, 0x80);					// add cl, operand
+	emitByte(cpu, 0xC1);
+	emitByte(cpu, (unsigned char)block->operand);
+	emitByte(cpu, 0x44);					// movzx r14d, byte [rax + rcx]
+	emitByte(cpu, 0x0F);
+	emitByte(cpu, 0xB6);
+	emitByte(cpu, 0x34);
+	emitByte(cpu, 0x08);
+	emitByte(cpu, 0xFE);					// inc cl
+	emitByte(cpu, 0xC1);
+	emitByte(cpu, 0x0F);					// movzx ecx, byte [rax + rcx]
+	emitByte(cpu, 0xB6);
+	emitByte(cpu, 0x0C);
+	emitByte(cpu, 0x08);
+	emitByte(cpu, 0xC1);					// shl ecx, 8
+	emitByte(cpu, 0xE1);
+	emitByte(cpu, 0x08);
+	emitByte(cpu, 0x41);					// or r14d, ecx
+	emitByte(cpu, 0x09);
+	emitByte(cpu, 0xCE);
+
+	return handler;
+}
+
+static unsigned char *emitIndirectY(M6502 *cpu, const MicroOp *block, int crossing)
+{
+	unsigned char *handler = emitZeroPage(cpu);
+
+	emitByte(cpu, 0x44);					// movzx r14d, byte [rax + pointer]
+	emitByte(cpu, 0x0F);
+	emitByte(cpu, 0xB6);
+	emitByte(cpu, 0xB0);
+	emitLong(cpu, block->operand & 0xFF);
+	emitByte(cpu, 0x0F);					// movzx ecx, byte [rax + pointer + 1]
+	emitByte(cpu, 0xB6);
+	emitByte(cpu, 0x88);
+	emitLong(cpu, (block->operand + 1) & 0xFF);
+	emitByte(cpu, 0x0F);					// movzx edx, byte [yRegister]
+	emitByte(cpu, 0xB6);
+	emitByte(cpu, 0x93);
+	emitDisplacement(cpu, &cpu->yRegister);
+	emitByte(cpu, 0x41);					// add r14d, edx
+	emitByte(cpu, 0x01);
+	emitByte(cpu, 0xD6);
+
+	if (crossing)
+		emitPageCrossing(cpu, 0xFF);
+
+	emitByte(cpu, 0xC1);					// shl ecx, 8
+	emitByte(cpu, 0xE1);
+	emitByte(cpu, 0x08);
+	emitByte(cpu, 0x41);					// add r14d, ecx
+	emitByte(cpu, 0x01);
+	emitByte(cpu, 0xCE);
+	emitByte(cpu, 0x45);					// movzx r14d, r14w
+	emitByte(cpu, 0x0F);
+	emitByte(cpu, 0xB7);
+	emitByte(cpu, 0xF6);
+
+	return handler;
+}
+
+// Emits the effective address of the instruction. Returns it when it is
+// known now, or -1 when it is left in r14. handler is set to a jump that has
+// to be patched to the instruction's handler, if one was needed.
+static int emitAddress(M6502 *cpu, const MicroOp *block, unsigned char **handler)
+{
+	*handler = NULL;
+
+	switch (opcodeModes[block->opcode])
+	{
+	case ZeroMode:
+	case AbsMode:
+		return block->operand;
+	case ZeroXMode:
+		emitZeroIndexed(cpu, block, &cpu->xRegister);
+		break;
+	case ZeroYMode:
+		emitZeroIndexed(cpu, block, &cpu->yRegister);
+		break;
+	case AbsXMode:
+	case WAbsXMode:
+		emitIndexed(cpu, block, &cpu->xRegister, opcodeModes[block->opcode] == AbsXMode);
+		break;
+	case AbsYMode:
+	case WAbsYMode:
+		emitIndexed(cpu, block, &cpu->yRegister, opcodeModes[block->opcode] == AbsYMode);
+		break;
+	case IndZeroXMode:
+		*handler = emitIndirectX(cpu, block);
+		break;
+	case IndZeroYMode:
+	case WIndZeroYMode:
+		*handler = emitIndirectY(cpu, block, opcodeModes[block->opcode] == IndZeroYMode);
+		break;
+	}
+
+	return -1;
+}
+
+static void emitCarryIn(M6502 *cpu, int borrow)
+{
+	emitByte(cpu, 0x8A);					// mov dl, [carry]
+	emitByte(cpu, 0x93);
+	emitDisplacement(cpu, &cpu->carry);
+
+	if (borrow)
+	{
+		emitByte(cpu, 0x80);				// xor dl, 1
+		emitByte(cpu, 0xF2);
+		emitByte(cpu, 0x01);
+	}
+
+	emitByte(cpu, 0xD0);					// shr dl, 1
+	emitByte(cpu, 0xEA);
+}
+
+static void emitSetCarry(M6502 *cpu, int borrow)
+{
+	emitByte(cpu, 0x0F);					// setc/setnc byte [carry]
+	emitByte(cpu, borrow ? 0x93 : 0x92);
+	emitByte(cpu, 0x83);
+	emitDisplacement(cpu, &cpu->carry);
+}
+
+// ADC and SBC in binary mode: x86's carry and overflow are the 6502's, with
+// the carry inverted for SBC.
+static void emitArithmetic(M6502 *cpu, int subtract)
+{
+	emitByte(cpu, 0x0F);					// movzx ecx, byte [accumulator]
+	emitByte(cpu, 0xB6);
+	emitByte(cpu, 0x8B);
+	emitDisplacement(cpu, &cpu->accumulator);
+	emitCarryIn(cpu, subtract);
+	emitByte(cpu, subtract ? 0x18 : 0x10);			// sbb/adc cl, al
+	emitByte(cpu, 0xC1);
+	emitSetCarry(cpu, subtract);
+	emitByte(cpu, 0x0F);					// seto dl
+	emitByte(cpu, 0x90);
+	emitByte(cpu, 0xC2);
+	emitByte(cpu, 0xC0);					// shl dl, 6
+	emitByte(cpu, 0xE2);
+	emitByte(cpu, 0x06);
+	emitByte(cpu, 0x88);					// mov [overflow], dl
+	emitByte(cpu, 0x93);
+	emitDisplacement(cpu, &cpu->overflow);
+	emitByte(cpu, 0x88);					// mov [accumulator], cl
+	emitByte(cpu, 0x8B);
+	emitDisplacement(cpu, &cpu->accumulator);
+	emitByte(cpu, 0x88);					// mov [negative], cl
+	emitByte(cpu, 0x8B);
+	emitDisplacement(cpu, &cpu->negative);
+	emitByte(cpu, 0x88);					// mov [zero], cl
+	emitByte(cpu, 0x8B);
+	emitDisplacement(cpu, &cpu->zero);
+}
+
+static void emitCompare(M6502 *cpu, const unsigned char *field)
+{
+	emitByte(cpu, 0x0F);					// movzx ecx, byte [field]
+	emitByte(cpu, 0xB6);
+	emitByte(cpu, 0x8B);
+	emitDisplacement(cpu, field);
+	emitByte(cpu, 0x28);					// sub cl, al
+	emitByte(cpu, 0xC1);
+	emitSetCarry(cpu, 1);
+	emitByte(cpu, 0x88);					// mov [negative], cl
+	emitByte(cpu, 0x8B);
+	emitDisplacement(cpu, &cpu->negative);
+	emitByte(cpu, 0x88);					// mov [zero], cl
+	emitByte(cpu, 0x8B);
+	emitDisplacement(cpu, &cpu->zero);
+}
+
+static void emitLogical(M6502 *cpu, unsigned char instruction)
+{
+	emitByte(cpu, instruction);				// and/or/xor al, [accumulator]
+	emitByte(cpu, 0x83);
+	emitDisplacement(cpu, &cpu->accumulator);
+	emitStore(cpu, &cpu->accumulator);
+	emitStatusRegisterNZ(cpu);
+}
+
+static void emitBit(M6502 *cpu)
+{
+	emitStore(cpu, &cpu->negative);
+	emitByte(cpu, 0x88);					// mov cl, al
+	emitByte(cpu, 0xC1);
+	emitByte(cpu, 0x80);					// and cl, V
+	emitByte(cpu, 0xE1);
+	emitByte(cpu, V);
+	emitByte(cpu, 0x88);					// mov [overflow], cl
+	emitByte(cpu, 0x8B);
+	emitDisplacement(cpu, &cpu->overflow);
+	emitByte(cpu, 0x22);					// and al, [accumulator]
+	emitByte(cpu, 0x83);
+	emitDisplacement(cpu, &cpu->accumulator);
+	emitStore(cpu, &cpu->zero);
+}
+
+// Shifts and rotates al. x86's carry comes out as the 6502's.
+static void emitShift(M6502 *cpu, void (*operation)(M6502 *cpu, unsigned short op))
+{
+	if (operation == ROL || operation == ROL_A || operation == ROR || operation == ROR_A)
+		emitCarryIn(cpu, 0);
+
+	emitByte(cpu, 0xD0);					// shl/shr/rcl/rcr al, 1
+	emitByte(cpu, operation == ASL || operation == ASL_A ? 0xE0 : operation == LSR || operation == LSR_A ? 0xE8 : operation == ROL || operation == ROL_A ? 0xD0 : 0xD8);
+	emitSetCarry(cpu, 0);
+	emitStatusRegisterNZ(cpu);
+}
+
+static int isMemoryOperation(void (*operation)(M6502 *cpu, unsigned short op))
+{
+	return operation == LDA || operation == LDX || operation == LDY || operation == STA || operation == STX || operation == STY ||
+		operation == ADC || operation == SBC || operation == CMP || operation == CPX || operation == CPY ||
+		operation == AND || operation == ORA || operation == EOR || operation == BIT ||
+		operation == INC || operation == DEC || operation == ASL || operation == LSR || operation == ROL || operation == ROR;
+}
+
+// Loads, stores, arithmetic and read-modify-write instructions in every
+// addressing mode but (ind), which only JMP uses. Decimal mode ADC and SBC
+// are left to the handler.
+static int emitMemory(M6502 *cpu, Translation *t, const MicroOp *block)
+{
+	void (*operation)(M6502 *cpu, unsigned short op) = opcodeOperations[block->opcode];
+	int mode = opcodeModes[block->opcode], address = -1, reads, writes;
+	unsigned char *handlers[2] = { NULL, NULL }, *done;
+
+	if (!isMemoryOperation(operation) || mode == ImpMode || mode == IndMode || mode == RelMode)
+		return 0;
+
+	reads = operation != STA && operation != STX && operation != STY;
+	writes = !reads || operation == INC || operation == DEC || operation == ASL || operation == LSR || operation == ROL || operation == ROR;
+
+	if (operation == ADC || operation == SBC)
+	{
+		emitByte(cpu, 0xF6);				// test byte [statusRegister], D
+		emitByte(cpu, 0x83);
+		emitDisplacement(cpu, &cpu->statusRegister);
+		emitByte(cpu, D);
+		handlers[0] = emitJump(cpu, 0x85);		// jnz handler
+	}
+
+	if (mode == ImmMode)
+	{
+		emitByte(cpu, 0xB8);				// mov eax, value
+		emitLong(cpu, memRead(cpu->machine, block->operand));
+	}
+	else
+	{
+		address = emitAddress(cpu, block, &handlers[1]);
+
+		if (reads)
+			emitRead(cpu, t, address);
+	}
+
+	if (operation == LDA || operation == LDX || operation == LDY)
+	{
+		emitStore(cpu, operation == LDA ? &cpu->accumulator : operation == LDX ? &cpu->xRegister : &cpu->yRegister);
+		emitStatusRegisterNZ(cpu);
+	}
+	else if (operation == STA || operation == STX || operation == STY)
+		emitLoad(cpu, operation == STA ? &cpu->accumulator : operation == STX ? &cpu->xRegister : &cpu->yRegister);
+	else if (operation == ADC || operation == SBC)
+		emitArithmetic(cpu, operation == SBC);
+	else if (operation == CMP || operation == CPX || operation == CPY)
+		emitCompare(cpu, operation == CMP ? &cpu->accumulator : operation == CPX ? &cpu->xRegister : &cpu->yRegister);
+	else if (operation == AND || operation == ORA || operation == EOR)
+		emitLogical(cpu, operation == AND ? 0x22 : operation == ORA ? 0x0A : 0x32);
+	else if (operation == BIT)
+		emitBit(cpu);
+	else if (operation == INC || operation == DEC)
+	{
+		emitByte(cpu, 0xFE);				// inc/dec al
+		emitByte(cpu, operation == DEC ? 0xC8 : 0xC0);
+		emitStatusRegisterNZ(cpu);
+	}
+	else
+		emitShift(cpu, operation);
+
+	if (writes)
+		emitWrite(cpu, t, address, block->next);
+
+	if (handlers[0] || handlers[1])
+	{
+		done = emitGoto(cpu);
+
+		if (handlers[0])
+			patchJump(handlers[0], cpu->emit);
+		if (handlers[1])
+			patchJump(handlers[1], cpu->emit);
+
+		emitHandler(cpu, t, block);
+
+		if (writes)
+			emitInvalidationCheck(cpu, t, block->next);
+
+		patchJump(done, cpu->emit);
+	}
+
+	return 1;
+}
+
+static unsigned char *emitStackPage(M6502 *cpu, int write)
+{
+	emitLookup(cpu, write, 0x100);
+
+	return emitJump(cpu, 0x84);				// jz handler
+}
+
+// PHA, PLA, JSR and RTS use the stack page directly when it has a pointer.
+static int emitStack(M6502 *cpu, Translation *t, const MicroOp *block)
+{
+	unsigned short returnAddress = block->next - 1;
+	unsigned char *handler, *done;
+
+	switch (block->opcode)
+	{
+	case 0x48:
+		handler = emitStackPage(cpu, 1);
+		emitByte(cpu, 0x0F);				// movzx ecx, byte [stackPointer]
+		emitByte(cpu, 0xB6);
+		emitByte(cpu, 0x8B);
+		emitDisplacement(cpu, &cpu->stackPointer);
+		emitLoad(cpu, &cpu->accumulator);
+		emitByte(cpu, 0x88);				// mov [rdx + rcx], al
+		emitByte(cpu, 0x04);
+		emitByte(cpu, 0x0A);
+		emitByte(cpu, 0xFE);				// dec byte [stackPointer]
+		emitByte(cpu, 0x8B);
+		emitDisplacement(cpu, &cpu->stackPointer);
+		break;
+	case 0x68:
+		handler = emitStackPage(cpu, 0);
+		emitByte(cpu, 0xFE);				// inc byte [stackPointer]
+		emitByte(cpu, 0x83);
+		emitDisplacement(cpu, &cpu->stackPointer);
+		emitByte(cpu, 0x0F);				// movzx ecx, byte [stackPointer]
+		emitByte(cpu, 0xB6);
+		emitByte(cpu, 0x8B);
+		emitDisplacement(cpu, &cpu->stackPointer);
+		emitByte(cpu, 0x0F);				// movzx eax, byte [rax + rcx]
+		emitByte(cpu, 0xB6);
+		emitByte(cpu, 0x04);
+		emitByte(cpu, 0x08);
+		emitStore(cpu, &cpu->accumulator);
+		emitStatusRegisterNZ(cpu);
+		break;
+	case 0x20:
+		handler = emitStackPage(cpu, 1);
+		emitByte(cpu, 0x0F);				// movzx ecx, byte [stackPointer]
+		emitByte(cpu, 0xB6);
+		emitByte(cpu, 0x8B);
+		emitDisplacement(cpu, &cpu->stackPointer);
+		emitByte(cpu, 0xC6);				// mov byte [rdx + rcx], high
+		emitByte(cpu, 0x04);
+		emitByte(cpu, 0x0A);
+		emitByte(cpu, (unsigned char)(returnAddress >> 8));
+		emitByte(cpu, 0xFE);				// dec cl
+		emitByte(cpu, 0xC9);
+		emitByte(cpu, 0xC6);				// mov byte [rdx + rcx], low
+		emitByte(cpu, 0x04);
+		emitByte(cpu, 0x0A);
+		emitByte(cpu, (unsigned char)returnAddress);
+		emitByte(cpu, 0xFE);				// dec cl
+		emitByte(cpu, 0xC9);
+		emitByte(cpu, 0x88);				// mov [stackPointer], cl
+		emitByte(cpu, 0x8B);
+		emitDisplacement(cpu, &cpu->stackPointer);
+		emitStoreProgramCounter(cpu, block->operand);
+		break;
+	case 0x60:
+		handler = emitStackPage(cpu, 0);
+		emitByte(cpu, 0x0F);				// movzx ecx, byte [stackPointer]
+		emitByte(cpu, 0xB6);
+		emitByte(cpu, 0x8B);
+		emitDisplacement(cpu, &cpu->stackPointer);
+		emitByte(cpu, 0xFE);				// inc cl
+		emitByte(cpu, 0xC1);
+		emitByte(cpu, 0x8A);				// mov dl, [rax + rcx]
+		emitByte(cpu, 0x14);
+		emitByte(cpu, 0x08);
+		emitByte(cpu, 0xFE);				// inc cl
+		emitByte(cpu, 0xC1);
+		emitByte(cpu, 0x8A);				// mov dh, [rax + rcx]
+		emitByte(cpu, 0x34);
+		emitByte(cpu, 0x08);
+		emitByte(cpu, 0x88);				// mov [stackPointer], cl
+		emitByte(cpu, 0x8B);
+		emitDisplacement(cpu, &cpu->stackPointer);
+		emitByte(cpu, 0x66);				// inc dx
+		emitByte(cpu, 0xFF);
+		emitByte(cpu, 0xC2);
+		emitByte(cpu, 0x66);				// mov [programCounter], dx
+		emitByte(cpu, 0x89);
+		emitByte(cpu, 0x93);
+		emitDisplacement(cpu, &cpu->programCounter);
+		break;
+	default:
+		return 0;
+	}
+
+	done = emitGoto(cpu);
+	patchJump(handler, cpu->emit);
+	emitHandler(cpu, t, block);
+
+	if (block->opcode == 0x48)
+		emitInvalidationCheck(cpu, t, block->next);
+
+	patchJump(done, cpu->emit);
+
+	return 1;
+}
+
+// A branch that is not taken carries on with the block. One that is taken
+// leaves it, or goes round again when it leads back to the start.
+static int emitBranch(M6502 *cpu, Translation *t, const MicroOp *block)
+{
+	const unsigned char *field;
+	unsigned char skip, *notTaken;
+	int cycles = (block->next ^ block->operand) & 0xFF00 ? 2 : 1;
+
+	switch (block->opcode)
+	{
+	case 0x10:
+		field = &cpu->negative;
+		skip = 0x85;
+		break;
+	case 0x30:
+		field = &cpu->negative;
+		skip = 0x84;
+		break;
+	case 0x50:
+		field = &cpu->overflow;
+		skip = 0x85;
+		break;
+	case 0x70:
+		field = &cpu->overflow;
+		skip = 0x84;
+		break;
+	case 0x90:
+		field = &cpu->carry;
+		skip = 0x85;
+		break;
+	case 0xB0:
+		field = &cpu->carry;
+		skip = 0x84;
+		break;
+	case 0xD0:
+		field = &cpu->zero;
+		skip = 0x84;
+		break;
+	case 0xF0:
+		field = &cpu->zero;
+		skip = 0x85;
+		break;
+	default:
+		return 0;
+	}
+
+	if (field == &cpu->negative)
+	{
+		emitByte(cpu, 0xF6);				// test byte [negative], N
+		emitByte(cpu, 0x83);
+		emitDisplacement(cpu, field);
+		emitByte(cpu, N);
+	}
+	else
+	{
+		emitByte(cpu, 0x80);				// cmp byte [field], 0
+		emitByte(cpu, 0xBB);
+		emitDisplacement(cpu, field);
+		emitByte(cpu, 0x00);
+	}
+
+	notTaken = emitJump(cpu, skip);
+
+	if (block->operand == t->start)
+		emitLoop(cpu, t, cycles);
+	else
+		emitExit(cpu, t, cycles, block->operand);
+
+	patchJump(notTaken, cpu->emit);
+
+	return 1;
+}
+
+// Register and flag instructions are emitted inline. Returns 0 for the
+// ones that are not.
+static int emitRegister(M6502 *cpu, const MicroOp *block)
+{
+	switch (block->opcode)
+	{
+	case 0x18:
+		emitStoreImmediate(cpu, &cpu->carry, 0);
+		break;
+	case 0x38:
+		emitStoreImmediate(cpu, &cpu->carry, 1);
+		break;
+	case 0x78:
+		emitStatusRegisterFlag(cpu, 1, I);
+		break;
+	case 0xB8:
+		emitStoreImmediate(cpu, &cpu->overflow, 0);
+		break;
+	case 0xD8:
+		emitStatusRegisterFlag(cpu, 0, D);
+		break;
+	case 0xF8:
+		emitStatusRegisterFlag(cpu, 1, D);
+		break;
+	case 0x88:
+		emitIncrement(cpu, &cpu->yRegister, 1);
+		break;
+	case 0xC8:
+		emitIncrement(cpu, &cpu->yRegister, 0);
+		break;
+	case 0xCA:
+		emitIncrement(cpu, &cpu->xRegister, 1);
+		break;
+	case 0xE8:
+		emitIncrement(cpu, &cpu->xRegister, 0);
+		break;
+	case 0x8A:
+		emitTransfer(cpu, &cpu->xRegister, &cpu->accumulator, 1);
+		break;
+	case 0x98:
+		emitTransfer(cpu, &cpu->yRegister, &cpu->accumulator, 1);
+		break;
+	case 0x9A:
+		emitTransfer(cpu, &cpu->xRegister, &cpu->stackPointer, 0);
+		break;
+	case 0xA8:
+		emitTransfer(cpu, &cpu->accumulator, &cpu->yRegister, 1);
+		break;
+	case 0xAA:
+		emitTransfer(cpu, &cpu->accumulator, &cpu->xRegister, 1);
+		break;
+	case 0xBA:
+		emitTransfer(cpu, &cpu->stackPointer, &cpu->xRegister, 1);
+		break;
+	case 0x0A:
+	case 0x2A:
+	case 0x4A:
+	case 0x6A:
+		emitLoad(cpu, &cpu->accumulator);
+		emitShift(cpu, opcodeOperations[block->opcode]);
+		emitStore(cpu, &cpu->accumulator);
+		break;
+	default:
+		// NOP and the undocumented opcodes, which do nothing.
+		if (opcodeOperations[block->opcode] != NOP && opcodeOperations[block->opcode] != Unoff && opcodeOperations[block->opcode] != Unoff1)
+			return 0;
+	}
+
+	return 1;
+}
+
+// The buffer is never writable and executable at once. The pages the next
+// block goes to are made writable while it is translated and executable
+// again afterwards.
+static int protectNative(M6502 *cpu, int prot)
+{
+	unsigned int page = (unsigned int)sysconf(_SC_PAGESIZE), from = cpu->nativeSize / page * page;
+
+	if (!mprotect(cpu->nativeCode + from, cpu->nativeSize + BLOCK_LENGTH * NATIVE_OP_SIZE - from, prot))
+		return 1;
+
+	fprintf(stderr, "stderr: Could not change native code protection, translation is turned off\n");
+	cpu->jit = 0;
+
+	return 0;
+}
+
+// The deadline is checked on entry and on every loop back to the start, so
+// inside the block only branches and stores to code pages can force an
+// early exit. CLI and PLP end the translation to let a pending IRQ in
+// before the next instruction. Whatever is not emitted inline calls the
+// interpreter's handler.
+static NativeBlock translateBlock(M6502 *cpu, const MicroOp *block)
+{
+	unsigned char *start = &cpu->nativeCode[cpu->nativeSize], *bail;
+	const MicroOp *microOp;
+	Translation t;
+	int i, last;
+
+	// Blocks cached while there was room may all be translated later on; the
+	// ones that no longer fit run in the interpreter until the next flush.
+	if (cpu->nativeSize + BLOCK_LENGTH * NATIVE_OP_SIZE > NATIVE_SIZE || !protectNative(cpu, PROT_READ | PROT_WRITE))
+		return NULL;
+
+	t.exitCount = t.cycles = t.instructions = t.bound = 0;
+	t.start = cpu->programCounter;
+
+	for (microOp = block; ; microOp++)
+	{
+		t.bound += microOp->cycles + 2;
+
+		if (microOp->last)
+			break;
+	}
+
+	cpu->emit = start;
+
+	emitByte(cpu, 0x8B);					// mov eax, [rdi + cycles]
+	emitByte(cpu, 0x87);
+	emitDisplacement(cpu, &cpu->cycles);
+	emitByte(cpu, 0x05);					// add eax, bound
+	emitLong(cpu, (unsigned int)t.bound);
+	emitByte(cpu, 0x3B);					// cmp eax, [rdi + deadline]
+	emitByte(cpu, 0x87);
+	emitDisplacement(cpu, &cpu->deadline);
+	bail = emitJump(cpu, 0x8D);				// jge bail
+
+	emitByte(cpu, 0x53);					// push rbx
+	emitByte(cpu, 0x41);					// push r12
+	emitByte(cpu, 0x54);
+	emitByte(cpu, 0x41);					// push r13
+	emitByte(cpu, 0x55);
+	emitByte(cpu, 0x41);					// push r14
+	emitByte(cpu, 0x56);
+	emitByte(cpu, 0x48);					// sub rsp, 8
+	emitByte(cpu, 0x83);
+	emitByte(cpu, 0xEC);
+	emitByte(cpu, 0x08);
+	emitByte(cpu, 0x48);					// mov rbx, rdi
+	emitByte(cpu, 0x89);
+	emitByte(cpu, 0xFB);
+	emitByte(cpu, 0x49);					// mov r12, readPages
+	emitByte(cpu, 0xBC);
+	emitQuad(cpu, (unsigned long long)getReadPages(cpu->machine));
+	emitByte(cpu, 0x49);					// mov r13, writePages
+	emitByte(cpu, 0xBD);
+	emitQuad(cpu, (unsigned long long)getWritePages(cpu->machine));
+
+	t.body = cpu->emit;
+
+	for (;;)
+	{
+		last = block->last || block->opcode == 0x28 || block->opcode == 0x58;
+		t.cycles += block->cycles;
+		t.instructions++;
+
+		if (last)
+			emitStoreProgramCounter(cpu, block->next);
+
+		if (block->opcode == 0x4C)
+		{
+			if (block->operand == t.start)
+				emitLoop(cpu, &t, 0);
+			else
+				emitStoreProgramCounter(cpu, block->operand);
+		}
+		else if (!emitRegister(cpu, block) && !emitMemory(cpu, &t, block) && !emitStack(cpu, &t, block) && !emitBranch(cpu, &t, block))
+		{
+			emitHandler(cpu, &t, block);
+
+			if (!last && (block->opcode == 0x08 || opcodeModes[block->opcode] != ImpMode))
+				emitInvalidationCheck(cpu, &t, block->next);
+		}
+
+		if (last)
+			break;
+
+		block++;
+	}
+
+	emitFlushCounters(cpu, &t, 0);
+
+	for (i = 0; i < t.exitCount; i++)
+		patchJump(t.exits[i], cpu->emit);
+
+	emitByte(cpu, 0x48);					// add rsp, 8
+	emitByte(cpu, 0x83);
+	emitByte(cpu, 0xC4);
+	emitByte(cpu, 0x08);
+	emitByte(cpu, 0x41);					// pop r14
+	emitByte(cpu, 0x5E);
+	emitByte(cpu, 0x41);					// pop r13
+	emitByte(cpu, 0x5D);
+	emitByte(cpu, 0x41);					// pop r12
+	emitByte(cpu, 0x5C);
+	emitByte(cpu, 0x5B);					// pop rbx
+	emitByte(cpu, 0xB8);					// mov eax, 1
+	emitLong(cpu, 1);
+	emitByte(cpu, 0xC3);					// ret
+
+	patchJump(bail, cpu->emit);
+
+	emitByte(cpu, 0x31);					// xor eax, eax
+	emitByte(cpu, 0xC0);
+	emitByte(cpu, 0xC3);					// ret
+
+	if (!protectNative(cpu, PROT_READ | PROT_EXEC))
+		return NULL;
+
+	cpu->nativeSize += cpu->emit - start;
+
+	return (NativeBlock)start;
+}
+
+#endif
+
+static NativeBlock fetchNative(M6502 *cpu)
+{
+#ifdef M6502_JIT
+	if (!cpu->jit || cpu->microOp == &cpu->uncachedOp)
+		return NULL;
+
+	if (!cpu->nativeBlocks[cpu->programCounter] && ++cpu->blockHits[cpu->programCounter] == NATIVE_THRESHOLD)
+		cpu->nativeBlocks[cpu->programCounter] = translateBlock(cpu, cpu->microOp);
+
+	// A failed translation turns the JIT off, and the pages it was writing
+	// to may have been left without execute permission.
+	return cpu->jit ? cpu->nativeBlocks[cpu->programCounter] : NULL;
+#else
+	return NULL;
+#endif
+}
+
+// Called when an idle loop is about to run. Unless a key is already pending
+// the loop is skipped ahead to the deadline and the cycles it would have
+// spent there are counted as skipped. With an event due in this slice the
+// slice ends there and is paced as usual, so the event runs on time at the
+// start of the next one. Otherwise runM6502() sleeps until wakeM6502()
+// reports new input or the next event is due.
+static int enterIdle(M6502 *cpu)
+{
+	unsigned int wakeups;
+	int deadline = getDeadline(cpu);
+
+	SDL_mutexP(cpu->idleMutex);
+	wakeups = cpu->wakeups;
+	SDL_mutexV(cpu->idleMutex);
+
+	if ((readKbdCr(cpu->machine) & 0x80) || cpu->cycles >= deadline)
+		return 0;
+
+	cpu->skippedCycles += deadline - cpu->cycles;
+	cpu->cycles = deadline;
+
+	if (deadline < cpu->cyclesBeforeSynchro)
+		return 1;
+
+	cpu->idle = 1;
+	cpu->idleWakeups = wakeups;
+
+	return 1;
+}
+
+// The idle loop keeps running while the thread sleeps, so the cycle count
+// moves on by the time slept at the current speed, up to the next event.
+// The time is taken from when the slice skipped by enterIdle() was due to
+// end, or after a change of speed from when it would end if it started now.
+// Running unthrottled the next event is due at once.
+static void waitIdle(M6502 *cpu)
+{
+	long long start = readClock(), base = start, due = 0, now, skipped = 0;
+	long long perMilli = (long long)cpu->frequency * cpu->multiplier;
+	int paced = !cpu->turbo && cpu->multiplier, timed = cpu->nextEvent != NO_EVENT;
+
+	if (paced)
+	{
+		if (cpu->resync)
+			base = start + cpu->cycles * 1000000LL / perMilli;
+		else
+			base = cpu->paceStart + (cpu->paceCycles + cpu->cycles) * 1000000 / perMilli;
+
+		if (base < start - CATCH_UP_NANOS)
+			base = start - CATCH_UP_NANOS;
+	}
+
+	if (timed && paced)
+		due = base + (cpu->nextEvent - cpu->elapsedCycles) * 1000000 / perMilli;
+
+	SDL_mutexP(cpu->idleMutex);
+
+	while (cpu->running && cpu->wakeups == cpu->idleWakeups)
+	{
+		if (!timed)
+		{
+			SDL_CondWait(cpu->idleCond, cpu->idleMutex);
+			continue;
+		}
+
+		if ((now = readClock()) >= due)
+			break;
+
+		SDL_CondWaitTimeout(cpu->idleCond, cpu->idleMutex, (Uint32)((due - now + 999999) / 1000000));
+	}
+
+	SDL_mutexV(cpu->idleMutex);
+
+	now = readClock();
+
+	if (paced && now > base)
+		skipped = (now - base) * perMilli / 1000000;
+	if (timed && (!paced || skipped > cpu->nextEvent - cpu->elapsedCycles))
+		skipped = cpu->nextEvent - cpu->elapsedCycles;
+
+	cpu->elapsedCycles += skipped;
+	cpu->skippedCycles += skipped;
+	cpu->idle = 0;
+	cpu->idleWaits++;
+	cpu->idleMillis += (now - start) / 1000000;
+	resynchronize(cpu);
+}
+
+static void waitHalted(M6502 *cpu)
+{
+	unsigned int wakeups;
+
+	notifyMachine(cpu->machine, EVENT_HALT);
+
+	SDL_mutexP(cpu->idleMutex);
+
+	// The cycle count stands still while halted, so only events posted for
+	// immediate delivery, such as setNMI(), can run here.
+	while (cpu->running && cpu->halted && !cpu->NMI)
+	{
+		wakeups = cpu->wakeups;
+		SDL_mutexV(cpu->idleMutex);
+
+		cpu->nextEvent = runEvents(cpu->machine, cpu->elapsedCycles);
+
+		SDL_mutexP(cpu->idleMutex);
+
+		while (cpu->running && cpu->halted && !cpu->NMI && cpu->wakeups == wakeups)
+			SDL_CondWait(cpu->idleCond, cpu->idleMutex);
+	}
+
+	if (cpu->NMI)
+		cpu->halted = 0;
+
+	SDL_mutexV(cpu->idleMutex);
+
+	resynchronize(cpu);
+}
+
+#define EXECUTE()					\
+	cpu->programCounter = cpu->microOp->next;	\
+	cpu->operand = cpu->microOp->operand;		\
+	cpu->cycles += cpu->microOp->cycles;		\
+	cpu->instructions++
+
+// Threaded dispatch needs GCC's labels as values. Configuring with
+// --enable-switch-dispatch, or defining POM1_SWITCH_DISPATCH, builds the
+// portable switch loop instead so the two can be compared.
+#if defined(__GNUC__) && !defined(POM1_SWITCH_DISPATCH)
+
+#define OPCODE_LABEL(code, mode, operation, baseCycles) &&op##code,
+#define OPCODE_HANDLER(code, mode, operation, baseCycles) op##code: operation(cpu, mode(cpu)); DISPATCH();
+
+#define DISPATCH()								\
+	do									\
+	{									\
+		if (cpu->cycles >= getDeadline(cpu))				\
+			goto check;						\
+		if (cpu->microOp->last || cpu->programCounter != cpu->microOp->next || cpu->blockInvalidated) \
+			goto fetch;						\
+		cpu->microOp++;							\
+		EXECUTE();							\
+		goto *dispatchTable[cpu->microOp->opcode];			\
+	} while (0)
+
+__attribute__((flatten)) static void executeOpcodes(M6502 *cpu)
+{
+	static const void *dispatchTable[256] = { OPCODES(OPCODE_LABEL) };
+	NativeBlock native;
+
+check:
+	if (cpu->cycles >= getDeadline(cpu))
+	{
+		if (!cpu->running || cpu->halted || cpu->cycles >= cpu->cyclesBeforeSynchro)
+			return;
+
+		serviceEvents(cpu);
+	}
+
+fetch:
+	cpu->microOp = fetchBlock(cpu);
+
+	if (cpu->microOp->idle && enterIdle(cpu))
+		return;
+
+	if (cpu->recompiledEntries[cpu->programCounter] && runRecompiled(cpu))
+		goto check;
+
+	if ((native = fetchNative(cpu)) != NULL && native(cpu))
+		goto check;
+
+	EXECUTE();
+	goto *dispatchTable[cpu->microOp->opcode];
+
+	OPCODES(OPCODE_HANDLER)
+}
+
+#else
+
+#define OPCODE_CASE(code, mode, operation, baseCycles) case code: operation(cpu, mode(cpu)); break;
+
+static void executeOpcodes(M6502 *cpu)
+{
+	NativeBlock native;
+	int fetch = 1;
+
+	for (;;)
+	{
+		if (cpu->cycles >= getDeadline(cpu))
+		{
+			if (!cpu->running || cpu->halted || cpu->cycles >= cpu->cyclesBeforeSynchro)
+				return;
+
+			serviceEvents(cpu);
+			fetch = 1;
+		}
+
+		if (fetch || cpu->microOp->last || cpu->programCounter != cpu->microOp->next || cpu->blockInvalidated)
+		{
+			cpu->microOp = fetchBlock(cpu);
+
+			if (cpu->microOp->idle && enterIdle(cpu))
+				return;
+
+			if (cpu->recompiledEntries[cpu->programCounter] && runRecompiled(cpu))
+			{
+				fetch = 1;
+				continue;
+			}
+
+			if ((native = fetchNative(cpu)) != NULL && native(cpu))
+			{
+				fetch = 1;
+				continue;
+			}
+		}
+		else
+			cpu->microOp++;
+
+		fetch = 0;
+
+		EXECUTE();
+
+		switch (cpu->microOp->opcode)
+		{
+		OPCODES(OPCODE_CASE)
+		}
+	}
+}
+
+#endif
+
+static int runM6502(void *data)
+{
+	M6502 *cpu = (M6502 *)data;
+
+	while (cpu->running)
+	{
+		if (cpu->halted)
+		{
+			waitHalted(cpu);
+			continue;
+		}
+
+		if (cpu->idle)
+		{
+			waitIdle(cpu);
+			continue;
+		}
+
+		cpu->cycles = 0;
+		storeRelaxed(&cpu->deadline, 0);
+
+		executeOpcodes(cpu);
+
+		cpu->elapsedCycles += cpu->cycles;
+
+		if (!cpu->idle && !cpu->halted)
+			synchronize(cpu);
+	}
+
+	return 0;
+}
+
+M6502 *createM6502(Machine *machine)
+{
+	M6502 *cpu = (M6502 *)calloc(1, sizeof(M6502));
+
+	if (!cpu)
+	{
+		fprintf(stderr, "stderr: Could not allocate memory block\n");
+		return NULL;
+	}
+
+	cpu->machine = machine;
+	cpu->multiplier = 1;
+	setStatusRegister(cpu, 0x24);
+
+	cpu->idleMutex = SDL_CreateMutex();
+	cpu->idleCond = SDL_CreateCond();
+
+	if (!cpu->idleMutex || !cpu->idleCond)
+	{
+		fprintf(stderr, "stderr: Could not create CPU synchronization objects\n");
+		destroyM6502(cpu);
+		return NULL;
+	}
+
+	return cpu;
+}
+
+void destroyM6502(M6502 *cpu)
+{
+#ifdef M6502_JIT
+	if (cpu->nativeCode)
+		munmap(cpu->nativeCode, NATIVE_SIZE);
+#endif
+
+	if (cpu->idleCond)
+		SDL_DestroyCond(cpu->idleCond);
+	if (cpu->idleMutex)
+		SDL_DestroyMutex(cpu->idleMutex);
+
+	free(cpu);
+}
+
+void setJit(Machine *machine, int b)
+{
+#ifdef M6502_JIT
+	M6502 *cpu = machine->cpu;
+
+	if (b && !cpu->nativeCode)
+	{
+		cpu->nativeCode = (unsigned char *)mmap(NULL, NATIVE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (cpu->nativeCode == MAP_FAILED)
+		{
+			cpu->nativeCode = NULL;
+			fprintf(stderr, "stderr: Could not allocate native code buffer\n");
+			return;
+		}
+	}
+
+	cpu->jit = b;
+#else
+	if (b)
+		fprintf(stderr, "stderr: Native code translation is not supported on this platform\n");
+#endif
+}
+
+int getJit(Machine *machine)
+{
+	return machine->cpu->jit;
+}
+
+int loadRecompiled(Machine *machine, const char *filename)
+{
+#ifdef HAVE_DLFCN_H
+	M6502 *cpu = machine->cpu;
+	void *handle = dlopen(filename, RTLD_NOW);
+	const RecompilerModule *module;
+	unsigned int i = 0;
+	int page;
+
+	if (!handle)
+	{
+		fprintf(stderr, "stderr: Could not load \"%s\"\n", filename);
+		return 0;
+	}
+
+	module = (const RecompilerModule *)dlsym(handle, "recompilerModule");
+
+	if (!module || module->abi != RECOMPILER_ABI)
+	{
+		fprintf(stderr, "stderr: \"%s\" is not a compatible recompiled module\n", filename);
+		dlclose(handle);
+		return 0;
+	}
+
+	memset(cpu->recompiledEntries, 0, sizeof(cpu->recompiledEntries));
+	memset(cpu->recompiledPages, 0, sizeof(cpu->recompiledPages));
+	memset(cpu->validPages, 0, sizeof(cpu->validPages));
+
+	for (page = 0; page < 256; page++)
+	{
+		cpu->recompiledIndex[page] = i;
+
+		for (; i < module->count && module->addresses[i] >> 8 == page; i++)
+			cpu->recompiledPages[page] = 1;
+	}
+
+	cpu->recompiledIndex[256] = i;
+
+	for (i = 0; i < module->entryCount; i++)
+		cpu->recompiledEntries[module->entries[i]] = 1;
+
+	cpu->recompiledModule = module;
+	cpu->recompilerState.running = &cpu->running;
+	cpu->recompilerState.deadline = (const volatile int *)&cpu->deadline;
+	cpu->recompilerState.IRQ = &cpu->IRQ;
+	cpu->recompilerState.NMI = &cpu->NMI;
+	cpu->recompilerState.memory = getMemory(machine);
+	cpu->recompilerState.validPages = cpu->validPages;
+	cpu->recompilerState.devicePages = getDevicePages(machine);
+	cpu->recompilerState.machine = machine;
+	cpu->recompilerState.read = readRecompiled;
+	cpu->recompilerState.write = writeRecompiled;
+
+	printf("stdout: Successfully loaded \"%s\"\n", filename);
+
+	return 1;
+#else
+	fprintf(stderr, "stderr: Recompiled modules are not supported on this platform\n");
+
+	return 0;
+#endif
+}
+
+void startM6502(Machine *machine)
+{
+	M6502 *cpu = machine->cpu;
+
+	cpu->running = 1;
+	resynchronize(cpu);
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+	cpu->thread = SDL_CreateThread(runM6502, "m6502", cpu);
+#else
+	cpu->thread = SDL_CreateThread(runM6502, cpu);
+#endif
+}
+
+void stopM6502(Machine *machine)
+{
+	M6502 *cpu = machine->cpu;
+
+	cpu->running = 0;
+	rescheduleM6502(machine);
+	SDL_WaitThread(cpu->thread, NULL);
+}
+
+// Makes the CPU go back to the scheduler at the next instruction boundary.
+void rescheduleM6502(Machine *machine)
+{
+	storeRelaxed(&machine->cpu->deadline, 0);
+	wakeM6502(machine);
+}
+
+void wakeM6502(Machine *machine)
+{
+	M6502 *cpu = machine->cpu;
+
+	SDL_mutexP(cpu->idleMutex);
+	cpu->wakeups++;
+	SDL_CondSignal(cpu->idleCond);
+	SDL_mutexV(cpu->idleMutex);
+}
+
+void getIdleCounters(Machine *machine, long long *skippedCycles, long long *idleMillis, unsigned int *idleWaits)
+{
+	*skippedCycles = machine->cpu->skippedCycles;
+	*idleMillis = machine->cpu->idleMillis;
+	*idleWaits = machine->cpu->idleWaits;
+}
+
+int getHalted(Machine *machine, unsigned short *address, long long *cycles)
+{
+	M6502 *cpu = machine->cpu;
+	int halted;
+
+	SDL_mutexP(cpu->idleMutex);
+	halted = cpu->halted;
+	*address = cpu->haltAddress;
+	*cycles = cpu->haltCycles;
+	SDL_mutexV(cpu->idleMutex);
+
+	return halted;
+}
+
+void resetM6502(Machine *machine)
+{
+	M6502 *cpu = machine->cpu;
+
+	cpu->statusRegister |= I;
+	cpu->stackPointer = 0xFF;
+	cpu->programCounter = memReadAbsolute(cpu, 0xFFFC);
+
+	SDL_mutexP(cpu->idleMutex);
+	cpu->halted = 0;
+	SDL_mutexV(cpu->idleMutex);
+
+	wakeM6502(machine);
+}
+
+void setSpeed(Machine *machine, int freq, int synchroMillis)
+{
+	machine->cpu->cyclesBeforeSynchro = synchroMillis * freq;
+	machine->cpu->synchroMillis = synchroMillis;
+	machine->cpu->frequency = freq;
+}
+
+// A multiplier of 0 runs the CPU as fast as the host allows. Turbo does the
+// same without losing the multiplier, for the fast-forward hotkey.
+void setSpeedMultiplier(Machine *machine, int multiplier)
+{
+	machine->cpu->multiplier = multiplier;
+	machine->cpu->resync = 1;
+}
+
+int getSpeedMultiplier(Machine *machine)
+{
+	return machine->cpu->multiplier;
+}
+
+void setTurbo(Machine *machine, int b)
+{
+	machine->cpu->turbo = b;
+	machine->cpu->resync = 1;
+}
+
+int getTurbo(Machine *machine)
+{
+	return machine->cpu->turbo;
+}
+
+int isThrottled(Machine *machine)
+{
+	return !machine->cpu->turbo && machine->cpu->multiplier == 1;
+}
+
+long long getElapsedCycles(Machine *machine)
+{
+	return machine->cpu->elapsedCycles;
+}
+
+long long getInstructionCount(Machine *machine)
+{
+	return machine->cpu->instructions;
+}
+
+void getPacingStats(Machine *machine, long long *driftNanos, long long *maxLateNanos, long long *droppedNanos, unsigned int *lateSlices, unsigned int *slices)
+{
+	M6502 *cpu = machine->cpu;
+
+	*driftNanos = cpu->paceDrift;
+	*maxLateNanos = cpu->paceMaxLate;
+	*droppedNanos = cpu->paceDropped;
+	*lateSlices = cpu->paceLateSlices;
+	*slices = cpu->paceSlices;
+}
+
+static void changeIRQ(Machine *machine, int state)
+{
+	machine->cpu->IRQ = state;
+}
+
+static void raiseNMI(Machine *machine, int data)
+{
+	machine->cpu->NMI = 1;
+}
+
+void setIRQ(Machine *machine, int state)
+{
+	scheduleEvent(machine, 0, changeIRQ, state);
+}
+
+void setNMI(Machine *machine)
+{
+	scheduleEvent(machine, 0, raiseNMI, 0);
+}
+
+// Only meaningful on the CPU thread, from an event handler or a device.
+long long getCycleCount(Machine *machine)
+{
+	return machine->cpu->elapsedCycles + machine->cpu->cycles;
+}
+
+int *dumpState(Machine *machine)
+{
+	M6502 *cpu = machine->cpu;
+	int *state = (int *)malloc(sizeof(int) * 6);
+
+	state[0] = cpu->programCounter;
+	state[1] = getStatusRegister(cpu);
+	state[2] = cpu->accumulator;
+	state[3] = cpu->xRegister;
+	state[4] = cpu->yRegister;
+	state[5] = cpu->stackPointer;
+
+	return state;
+}
+
+void loadState(Machine *machine, int *state)
+{
+	M6502 *cpu = machine->cpu;
+
+	cpu->programCounter = state[0];
+	setStatusRegister(cpu, state[1]);
+	cpu->accumulator = state[2];
+	cpu->xRegister = state[3];
+	cpu->yRegister = state[4];
+	cpu->stackPointer = state[5];
+	wakeM6502(machine);
 }
@@ -19,13 +19,34 @@
 #ifndef __M6502_H__
 #define __M6502_H__
 
-void startM6502(void);
-void stopM6502(void);
-void resetM6502(void);
-void setSpeed(int freq, int synchroMillis);
-void setIRQ(int state);
-void setNMI(void);
-int *dumpState(void);
-void loadState(int *state);
+#include "machine.h"
+
+M6502 *createM6502(Machine *machine);
+void destroyM6502(M6502 *cpu);
+void startM6502(Machine *machine);
+void stopM6502(Machine *machine);
+void wakeM6502(Machine *machine);
+void rescheduleM6502(Machine *machine);
+void getIdleCounters(Machine *machine, long long *skippedCycles, long long *idleMillis, unsigned int *idleWaits);
+int getHalted(Machine *machine, unsigned short *address, long long *cycles);
+void resetM6502(Machine *machine);
+void setSpeed(Machine *machine, int freq, int synchroMillis);
+void setSpeedMultiplier(Machine *machine, int multiplier);
+int getSpeedMultiplier(Machine *machine);
+void setTurbo(Machine *machine, int b);
+int getTurbo(Machine *machine);
+int isThrottled(Machine *machine);
+long long getElapsedCycles(Machine *machine);
+long long getInstructionCount(Machine *machine);
+void getPacingStats(Machine *machine, long long *driftNanos, long long *maxLateNanos, long long *droppedNanos, unsigned int *lateSlices, unsigned int *slices);
+void setJit(Machine *machine, int b);
+int getJit(Machine *machine);
+int loadRecompiled(Machine *machine, const char *filename);
+void setIRQ(Machine *machine, int state);
+void setNMI(Machine *machine);
+long long getCycleCount(Machine *machine);
+int *dumpState(Machine *machine);
+void loadState(Machine *machine, int *state);
+void invalidateCodePage(Machine *machine, unsigned char page);
 
 #endif
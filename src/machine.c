@@ -0,0 +1,74 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "m6502.h"
+#include "memory.h"
+#include "pia6820.h"
+#include "scheduler.h"
+#include "terminal.h"
+
+Machine *createMachine(void)
+{
+	Machine *machine = (Machine *)calloc(1, sizeof(Machine));
+
+	if (!machine)
+	{
+		fprintf(stderr, "stderr: Could not allocate memory block\n");
+		return NULL;
+	}
+
+	machine->cpu = createM6502(machine);
+	machine->memory = createMemory();
+	machine->pia = createPia6820();
+	machine->terminal = createTerminal();
+	machine->scheduler = createScheduler();
+
+	if (!machine->cpu || !machine->memory || !machine->pia || !machine->terminal || !machine->scheduler)
+	{
+		destroyMachine(machine);
+		return NULL;
+	}
+
+	return machine;
+}
+
+void destroyMachine(Machine *machine)
+{
+	if (machine->cpu)
+		destroyM6502(machine->cpu);
+	if (machine->memory)
+		destroyMemory(machine->memory);
+	if (machine->pia)
+		destroyPia6820(machine->pia);
+	if (machine->terminal)
+		destroyTerminal(machine->terminal);
+	if (machine->scheduler)
+		destroyScheduler(machine->scheduler);
+
+	free(machine);
+}
+
+// The front-end is handed the machine along with the event, so that one
+// serving several machines knows which of them it came from.
+void notifyMachine(Machine *machine, int event)
+{
+	if (machine->notify)
+		machine->notify(machine, event);
+}
@@ -0,0 +1,54 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef __MACHINE_H__
+#define __MACHINE_H__
+
+typedef struct Machine Machine;
+typedef struct M6502 M6502;
+typedef struct Memory Memory;
+typedef struct Pia6820 Pia6820;
+typedef struct Scheduler Scheduler;
+typedef struct Terminal Terminal;
+
+// What the core tells the front-end from the CPU thread: display output is
+// waiting, the keyboard ring wants topping up, or the CPU halted.
+#define EVENT_DISPLAY 1
+#define EVENT_KEYBOARD 2
+#define EVENT_HALT 4
+
+typedef void (*MachineNotifier)(Machine *machine, int event);
+
+// One emulated Apple 1. Nothing in the core is shared between machines, so
+// several of them can run side by side in the same process. notify is left
+// NULL by createMachine(), for a machine nobody listens to.
+struct Machine
+{
+	M6502 *cpu;
+	Memory *memory;
+	Pia6820 *pia;
+	Terminal *terminal;
+	Scheduler *scheduler;
+	MachineNotifier notify;
+};
+
+Machine *createMachine(void);
+void destroyMachine(Machine *machine);
+void notifyMachine(Machine *machine, int event);
+
+#endif
@@ -18,31 +18,96 @@
 
 #include "SDL.h"
 #include "configuration.h"
+#include "crt.h"
+#include "display.h"
 #include "keyboard.h"
 #include "m6502.h"
 #include "memory.h"
 #include "screen.h"
+#include "terminal.h"
+#include "video.h"
 #include "config.h"
 
 #ifdef _WIN32
 #define strcasecmp _stricmp
 #endif
 
+#define HALT_STATUS 2
+
+static Machine *machine;
+static int exitOnHalt, sliceMillis = 10;
+
+static void freeMachine(void)
+{
+	destroyMachine(machine);
+}
+
+static void saveMachineConfiguration(void)
+{
+	saveConfiguration(machine);
+}
+
+static void stopMachine(void)
+{
+	long long skippedCycles, idleMillis, driftNanos, maxLateNanos, droppedNanos;
+	unsigned int idleWaits, lateSlices, slices;
+
+	stopM6502(machine);
+	getIdleCounters(machine, &skippedCycles, &idleMillis, &idleWaits);
+	printf("stdout: idle=%u waits, %lld cycles skipped, %lld ms slept\n", idleWaits, skippedCycles, idleMillis);
+	getPacingStats(machine, &driftNanos, &maxLateNanos, &droppedNanos, &lateSlices, &slices);
+	printf("stdout: pacing=%u slices, %u late (max %lld us), %lld ms dropped, drift %lld us\n", slices, lateSlices, maxLateNanos / 1000, droppedNanos / 1000000, driftNanos / 1000);
+}
+
+static void stopCrtFilter(void)
+{
+	unsigned int passes;
+	long long maxNanos;
+
+	stopCrt();
+	getCrtStats(&passes, &maxNanos);
+
+	if (passes)
+		printf("stdout: crt=%u full screens, max %lld us\n", passes, maxNanos / 1000);
+}
+
+static void showDisplayStats(void)
+{
+	unsigned int frames;
+	long long totalNanos, maxNanos;
+
+	getDisplayStats(&frames, &totalNanos, &maxNanos);
+
+	if (frames)
+		printf("stdout: video=%u frames, avg %lld us, max %lld us\n", frames, totalNanos / frames / 1000, maxNanos / 1000);
+}
+
 int main(int argc, char *argv[])
 {
 	int i, temp;
-	char *romdir = getenv("POM1ROMDIR");
+	unsigned short haltAddress;
+	long long haltCycles;
+	char *romdir = getenv("POM1ROMDIR"), *inputName = NULL;
+	FILE *fp;
 
 	atexit(freeRomDirectory);
 
+	machine = createMachine();
+
+	if (!machine)
+		return 1;
+
+	machine->notify = postMachineEvent;
+	atexit(freeMachine);
+
 	if (romdir)
 		setRomDirectory(romdir);
 	else
 		setRomDirectory("roms");
 
-	loadConfiguration();
+	loadConfiguration(machine);
 
-	atexit(saveConfiguration);
+	atexit(saveMachineConfiguration);
 
 	if (argc > 1)
 	{
@@ -54,7 +119,7 @@ int main(int argc, char *argv[])
 			{
 				temp = atoi(argv[i + 1]);
 
-				if (temp == 1 || temp == 2)
+				if (temp >= 1 && temp <= MAX_PIXEL_SIZE)
 				{
 					if (temp == 1)
 						setScanlines(0);
@@ -63,8 +128,10 @@ int main(int argc, char *argv[])
 				}
 			}
 			else if (!strcasecmp("-scanlines", argv[i]))
+			{
 				if (getPixelSize() > 1)
 					setScanlines(1);
+			}
 			else if (!strcasecmp("-terminalspeed", argv[i]) && i + 1 < argc)
 			{
 				temp = atoi(argv[i + 1]);
@@ -73,41 +140,96 @@ int main(int argc, char *argv[])
 					setTerminalSpeed(temp);
 			}
 			else if (!strcasecmp("-ram8k", argv[i]))
-				setRam8k(1);
+				setRam8k(machine, 1);
 			else if (!strcasecmp("-writeinrom", argv[i]))
-				setWriteInRom(1);
+				setWriteInRom(machine, 1);
 			else if (!strcasecmp("-fullscreen", argv[i]))
 				setFullscreen(1);
 			else if (!strcasecmp("-blinkcursor", argv[i]))
 				setBlinkCursor(1);
 			else if (!strcasecmp("-blockcursor", argv[i]))
 				setBlockCursor(1);
+			else if (!strcasecmp("-crt", argv[i]))
+				setCrt(1);
+			else if (!strcasecmp("-jit", argv[i]))
+				setJit(machine, 1);
+			else if (!strcasecmp("-recompiled", argv[i]) && i + 1 < argc)
+				loadRecompiled(machine, argv[i + 1]);
+			else if (!strcasecmp("-exitonhalt", argv[i]))
+				exitOnHalt = 1;
+			else if (!strcasecmp("-speed", argv[i]) && i + 1 < argc)
+			{
+				if (!strcasecmp("max", argv[i + 1]))
+					setSpeedMultiplier(machine, 0);
+				else
+				{
+					temp = atoi(argv[i + 1]);
+
+					if (temp >= 1 && temp <= 100)
+						setSpeedMultiplier(machine, temp);
+				}
+			}
+			else if (!strcasecmp("-scrollback", argv[i]) && i + 1 < argc)
+			{
+				temp = atoi(argv[i + 1]);
+
+				if (temp >= 0 && temp <= 10000)
+					setScrollback(machine, temp);
+			}
+			else if (!strcasecmp("-video", argv[i]) && i + 1 < argc)
+			{
+				if (!setVideoBackend(argv[i + 1]))
+				{
+					fprintf(stderr, "stderr: Unknown video backend \"%s\"\n", argv[i + 1]);
+					return 1;
+				}
+			}
+			else if (!strcasecmp("-input", argv[i]) && i + 1 < argc)
+				inputName = argv[i + 1];
+			else if (!strcasecmp("-slice", argv[i]) && i + 1 < argc)
+			{
+				temp = atoi(argv[i + 1]);
+
+				if (temp >= 1 && temp <= 100)
+					sliceMillis = temp;
+			}
 		}
 	}
 
-	if (SDL_Init(SDL_INIT_VIDEO) < 0)
+	// Backends without a window still need SDL's events and timers. SDL 2
+	// has them apart from video; SDL 1.2 is given its dummy video driver.
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+	if (SDL_Init((getVideoBackend()->window ? SDL_INIT_VIDEO : SDL_INIT_EVENTS) | SDL_INIT_TIMER) < 0)
+#else
+	if (!getVideoBackend()->window)
+		SDL_putenv("SDL_VIDEODRIVER=dummy");
+
+	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0)
+#endif
 	{
 		fprintf(stderr, "stderr: Could not initialize SDL\n");
 		return 1;
 	}
 
 	atexit(SDL_Quit);
+	atexit(stopCrtFilter);
 
-	SDL_WM_SetCaption(PACKAGE_NAME, NULL);
+	setDisplayCaption(PACKAGE_NAME);
 
-	if (!SDL_SetVideoMode(280 * getPixelSize(), 192 * getPixelSize(), 8, SDL_HWSURFACE | (getFullscreen() ? SDL_FULLSCREEN : 0)))
-	{
-		fprintf(stderr, "stderr: Could not set video mode to %dx%dx8\n", 280 * getPixelSize(), 192 * getPixelSize());
+	if (!openScreen())
 		return 1;
-	}
 
-	initScreen();
+	atexit(showDisplayStats);
+	atexit(closeScreen);
 
+#if !SDL_VERSION_ATLEAST(2, 0, 0)
 	SDL_EnableKeyRepeat(SDL_DEFAULT_REPEAT_DELAY, SDL_DEFAULT_REPEAT_INTERVAL);
 
 	SDL_EnableUNICODE(1);
+#endif
 
-	SDL_ShowCursor(!getFullscreen());
+	if (getVideoBackend()->window)
+		SDL_ShowCursor(!getFullscreen());
 
 	if (!loadCharMap())
 	{
@@ -115,17 +237,35 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	resetScreen();
-	resetMemory();
-	setSpeed(1000, 50);
-	resetM6502();
-	startM6502();
+	resetScreen(machine);
+	resetMemory(machine);
+	setSpeed(machine, 1000, sliceMillis);
+	resetM6502(machine);
+	startM6502(machine);
 
-	atexit(stopM6502);
+	atexit(stopMachine);
 	atexit(closeInputFile);
 
-	while (handleInput())
-		updateScreen();
+	if (inputName)
+	{
+		fp = strcmp(inputName, "-") ? fopen(inputName, "r") : stdin;
+
+		if (!fp)
+		{
+			fprintf(stderr, "stderr: Could not open \"%s\" for read\n", inputName);
+			return 1;
+		}
+
+		setInputFile(fp, inputName);
+	}
+
+	while (handleInput(machine))
+	{
+		updateScreen(machine);
+
+		if (exitOnHalt && getHalted(machine, &haltAddress, &haltCycles))
+			return HALT_STATUS;
+	}
 
 	return 0;
 }
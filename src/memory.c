@@ -20,12 +20,148 @@
 #include <stdlib.h>
 #include <string.h>
 #include "configuration.h"
+#include "m6502.h"
+#include "memory.h"
 #include "pia6820.h"
 
-static unsigned char mem[65536];
-static int ram8k = 0, writeInRom = 1;
+// Every page has either a direct pointer into mem or a handler. RAM and ROM
+// are read and written through the pointers; device pages, write-protected
+// pages and pages holding cached code go through the handlers instead.
+struct Memory
+{
+	unsigned char mem[65536];
+	unsigned char *readPages[256], *writePages[256];
+	ReadHandler readHandlers[256];
+	WriteHandler writeHandlers[256];
+	ReadHandler deviceReads[256];
+	WriteHandler deviceWrites[256];
+	unsigned char codePages[256], devicePages[256];
+	int ram8k, writeInRom;
+};
+
+static unsigned char readRam(Machine *machine, unsigned short address)
+{
+	return machine->memory->mem[address];
+}
+
+static void ignoreWrite(Machine *machine, unsigned short address, unsigned char value)
+{
+}
+
+static void writeCodePage(Machine *machine, unsigned short address, unsigned char value);
+
+static void mapPage(Memory *memory, unsigned int page)
+{
+	if (memory->devicePages[page])
+	{
+		memory->readPages[page] = NULL;
+		memory->writePages[page] = NULL;
+		memory->readHandlers[page] = memory->deviceReads[page];
+		memory->writeHandlers[page] = memory->deviceWrites[page];
+		return;
+	}
+
+	memory->readPages[page] = &memory->mem[page << 8];
+	memory->writePages[page] = NULL;
+	memory->readHandlers[page] = NULL;
+
+	if (page == 0xFF && !memory->writeInRom)
+		memory->writeHandlers[page] = ignoreWrite;
+	else if (memory->ram8k && page >= 0x20 && page < 0xFF)
+		memory->writeHandlers[page] = ignoreWrite;
+	else if (memory->codePages[page])
+		memory->writeHandlers[page] = writeCodePage;
+	else
+		memory->writePages[page] = &memory->mem[page << 8];
+}
+
+static void mapPages(Memory *memory)
+{
+	unsigned int page;
+
+	for (page = 0; page < 256; page++)
+		mapPage(memory, page);
+}
+
+static void writeCodePage(Machine *machine, unsigned short address, unsigned char value)
+{
+	Memory *memory = machine->memory;
+	unsigned char page = address >> 8;
+
+	memory->mem[address] = value;
+	memory->codePages[page] = 0;
+	mapPage(memory, page);
+	invalidateCodePage(machine, page);
+}
+
+// $D0xx is decoded by the PIA for $D010-$D013 and behaves as RAM elsewhere.
+static unsigned char readPia(Machine *machine, unsigned short address)
+{
+	if (address == 0xD013)
+		return readDspCr(machine);
+	if (address == 0xD012)
+		return readDsp(machine);
+	if (address == 0xD011)
+		return readKbdCr(machine);
+	if (address == 0xD010)
+		return readKbd(machine);
+
+	return machine->memory->mem[address];
+}
+
+static void writePia(Machine *machine, unsigned short address, unsigned char value)
+{
+	if (address == 0xD013)
+	{
+		writeDspCr(machine, value);
+		return;
+	}
+	if (address == 0xD012)
+	{
+		writeDsp(machine, (unsigned char)(value | 0x80));
+		return;
+	}
+	if (address == 0xD011)
+	{
+		writeKbdCr(machine, value);
+		return;
+	}
+	if (address == 0xD010)
+	{
+		writeKbd(machine, value);
+		return;
+	}
+
+	if (!machine->memory->ram8k)
+		machine->memory->mem[address] = value;
+}
+
+Memory *createMemory(void)
+{
+	Memory *memory = (Memory *)calloc(1, sizeof(Memory));
+
+	if (!memory)
+	{
+		fprintf(stderr, "stderr: Could not allocate memory block\n");
+		return NULL;
+	}
+
+	memory->writeInRom = 1;
+	memory->devicePages[0xD0] = 1;
+	memory->deviceReads[0xD0] = readPia;
+	memory->deviceWrites[0xD0] = writePia;
 
-static int loadMonitor(void)
+	mapPages(memory);
+
+	return memory;
+}
+
+void destroyMemory(Memory *memory)
+{
+	free(memory);
+}
+
+static int loadMonitor(Memory *memory)
 {
 	const char *romdir = getRomDirectory();
 	char *filename;
@@ -40,7 +176,7 @@ static int loadMonitor(void)
 
 	if (fp)
 	{
-		fread(&mem[0xFF00], 1, 256, fp);
+		fread(&memory->mem[0xFF00], 1, 256, fp);
 		fclose(fp);
 	}
 	else
@@ -49,7 +185,7 @@ static int loadMonitor(void)
 	return 1;
 }
 
-static int loadBasic(void)
+static int loadBasic(Memory *memory)
 {
 	const char *romdir = getRomDirectory();
 	char *filename;
@@ -64,7 +200,7 @@ static int loadBasic(void)
 
 	if (fp)
 	{
-		fread(&mem[0xE000], 1, 4096, fp);
+		fread(&memory->mem[0xE000], 1, 4096, fp);
 		fclose(fp);
 	}
 	else
@@ -73,102 +209,147 @@ static int loadBasic(void)
 	return 1;
 }
 
+// Drops the CPU's cached blocks, which the CPU thread may be running from,
+// so it must be stopped when this is called from any other thread.
+static void invalidateCodePages(Machine *machine, unsigned short start, unsigned int size)
+{
+	Memory *memory = machine->memory;
+	unsigned int page;
 
-void resetMemory(void)
+	for (page = start >> 8; page <= (start + size - 1) >> 8 && page < 256; page++)
+	{
+		if (memory->codePages[page])
+		{
+			memory->codePages[page] = 0;
+			mapPage(memory, page);
+			invalidateCodePage(machine, (unsigned char)page);
+		}
+	}
+}
+
+void resetMemory(Machine *machine)
 {
-	memset(mem, 0, 57344);
+	memset(machine->memory->mem, 0, 57344);
+	invalidateCodePages(machine, 0, 65536);
 	
-	if (!loadMonitor())
+	if (!loadMonitor(machine->memory))
 	{
 		fprintf(stderr, "stderr: Could not load monitor\n");
 		exit(1);
 	}
 
-	if (!loadBasic())
+	if (!loadBasic(machine->memory))
 	{
 		fprintf(stderr, "stderr: Could not load basic\n");
 		exit(1);
 	}
 }
 
-void setRam8k(int b)
+void setRam8k(Machine *machine, int b)
 {
-	ram8k = b;
+	machine->memory->ram8k = b;
+	mapPages(machine->memory);
 }
 
-int getRam8k()
+int getRam8k(Machine *machine)
 {
-	return ram8k;
+	return machine->memory->ram8k;
 }
 
-void setWriteInRom(int b)
+void setWriteInRom(Machine *machine, int b)
 {
-	writeInRom = b;
+	machine->memory->writeInRom = b;
+	mapPages(machine->memory);
 }
 
-int getWriteInRom(void)
+int getWriteInRom(Machine *machine)
 {
-	return writeInRom;
+	return machine->memory->writeInRom;
 }
 
-unsigned char memRead(unsigned short address)
+unsigned char memRead(Machine *machine, unsigned short address)
 {
-	if (address == 0xD013)
-		return readDspCr();
-	if (address == 0xD012)
-		return readDsp();
-	if (address == 0xD011)
-		return readKbdCr();
-	if (address == 0xD010)
-		return readKbd();
+	const unsigned char *page = machine->memory->readPages[address >> 8];
 
-	return mem[address];
+	if (page)
+		return page[address & 0xFF];
+
+	return machine->memory->readHandlers[address >> 8](machine, address);
 }
 
-void memWrite(unsigned short address, unsigned char value)
+void memWrite(Machine *machine, unsigned short address, unsigned char value)
 {
-	if (address == 0xD013)
-	{
-		writeDspCr(value);
-		return;
-	}
-	if (address == 0xD012)
-	{
-		writeDsp((unsigned char)(value | 0x80));
-		return;
-	}
-	if (address == 0xD011)
-	{
-		writeKbdCr(value);
-		return;
-	}
-	if (address == 0xD010)
-	{
-		writeKbd(value);
-		return;
-	}
+	unsigned char *page = machine->memory->writePages[address >> 8];
 
-	if (address >= 0xFF00 && !writeInRom)
-		return;
-	if (ram8k && address >= 0x2000 && address < 0xFF00)
-		return;
-		
-	mem[address] = value;
+	if (page)
+		page[address & 0xFF] = value;
+	else
+		machine->memory->writeHandlers[address >> 8](machine, address, value);
 }
 
-unsigned char *dumpMemory(unsigned short start, unsigned short end)
+unsigned char *dumpMemory(Machine *machine, unsigned short start, unsigned short end)
 {
 	unsigned char *fbrut = (unsigned char *)malloc(end - start + 1);
 
 	if (!fbrut)
 		fprintf(stderr, "stderr: Could not allocate memory block\n");
 	else
-		memcpy(fbrut, &mem[start], end - start + 1);
+		memcpy(fbrut, &machine->memory->mem[start], end - start + 1);
 
 	return fbrut;
 }
 
-void setMemory(const unsigned char *data, unsigned short start, unsigned int size)
+void setMemory(Machine *machine, const unsigned char *data, unsigned short start, unsigned int size)
+{
+	memcpy(&machine->memory->mem[start], data, size);
+
+	if (size)
+		invalidateCodePages(machine, start, size);
+}
+
+void setCodePage(Machine *machine, unsigned char page)
+{
+	machine->memory->codePages[page] = 1;
+	mapPage(machine->memory, page);
+}
+
+const unsigned char *getMemory(Machine *machine)
+{
+	return machine->memory->mem;
+}
+
+unsigned char *const *getReadPages(Machine *machine)
+{
+	return machine->memory->readPages;
+}
+
+unsigned char *const *getWritePages(Machine *machine)
+{
+	return machine->memory->writePages;
+}
+
+void registerDevice(Machine *machine, unsigned char firstPage, unsigned char lastPage, ReadHandler read, WriteHandler write)
+{
+	Memory *memory = machine->memory;
+	unsigned int page;
+
+	for (page = firstPage; page <= lastPage; page++)
+	{
+		memory->devicePages[page] = read || write;
+		memory->deviceReads[page] = read ? read : readRam;
+		memory->deviceWrites[page] = write ? write : ignoreWrite;
+		memory->codePages[page] = 0;
+		mapPage(memory, page);
+		invalidateCodePage(machine, (unsigned char)page);
+	}
+}
+
+int isDevicePage(Machine *machine, unsigned char page)
+{
+	return machine->memory->devicePages[page];
+}
+
+const unsigned char *getDevicePages(Machine *machine)
 {
-	memcpy(&mem[start], data, size);
+	return machine->memory->devicePages;
 }
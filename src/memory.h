@@ -19,14 +19,42 @@
 #ifndef __MEMORY_H__
 #define __MEMORY_H__
 
-void resetMemory(void);
-void setRam8k(int b);
-int getRam8k(void);
-void setWriteInRom(int b);
-int getWriteInRom(void);
-unsigned char memRead(unsigned short address);
-void memWrite(unsigned short address, unsigned char value);
-unsigned char *dumpMemory(unsigned short start, unsigned short end);
-void setMemory(const unsigned char *data, unsigned short start, unsigned int size);
+#include "machine.h"
+
+typedef unsigned char (*ReadHandler)(Machine *machine, unsigned short address);
+typedef void (*WriteHandler)(Machine *machine, unsigned short address, unsigned char value);
+
+Memory *createMemory(void);
+void destroyMemory(Memory *memory);
+
+// Writes that land on a page holding cached code clear the CPU's cache for
+// it, and setRam8k() and setWriteInRom() rebuild the page tables the CPU
+// reads through, so outside of the CPU thread resetMemory(), setRam8k(),
+// setWriteInRom(), setMemory() and memWrite() may only be called while the
+// CPU is stopped.
+void resetMemory(Machine *machine);
+void setRam8k(Machine *machine, int b);
+int getRam8k(Machine *machine);
+void setWriteInRom(Machine *machine, int b);
+int getWriteInRom(Machine *machine);
+unsigned char memRead(Machine *machine, unsigned short address);
+void memWrite(Machine *machine, unsigned short address, unsigned char value);
+unsigned char *dumpMemory(Machine *machine, unsigned short start, unsigned short end);
+void setMemory(Machine *machine, const unsigned char *data, unsigned short start, unsigned int size);
+void setCodePage(Machine *machine, unsigned char page);
+const unsigned char *getMemory(Machine *machine);
+
+// The tables memRead() and memWrite() look pages up in, for the JIT. A NULL
+// entry is a page that has to go through the call.
+unsigned char *const *getReadPages(Machine *machine);
+unsigned char *const *getWritePages(Machine *machine);
+
+// Routes every access to the given pages to a device. A device that only
+// decodes writes passes NULL for read and the pages read as memory; one that
+// only decodes reads passes NULL for write and writes are ignored. Passing
+// NULL for both returns the pages to plain memory.
+void registerDevice(Machine *machine, unsigned char firstPage, unsigned char lastPage, ReadHandler read, WriteHandler write);
+int isDevicePage(Machine *machine, unsigned char page);
+const unsigned char *getDevicePages(Machine *machine);
 
 #endif
@@ -0,0 +1,287 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef __OPCODES_H__
+#define __OPCODES_H__
+
+#define OPCODES(_)				\
+	_(0x00, Imm, BRK, 6)		\
+	_(0x01, IndZeroX, ORA, 4)	\
+	_(0x02, Imp, Hang, 0)		\
+	_(0x03, Imp, Unoff, 0)		\
+	_(0x04, Imm, Unoff, 0)		\
+	_(0x05, Zero, ORA, 2)		\
+	_(0x06, Zero, ASL, 4)		\
+	_(0x07, Imp, Unoff, 0)		\
+	_(0x08, Imp, PHP, 2)		\
+	_(0x09, Imm, ORA, 1)		\
+	_(0x0A, Imp, ASL_A, 1)		\
+	_(0x0B, Imm, AND, 1)		\
+	_(0x0C, Abs, Unoff, 0)		\
+	_(0x0D, Abs, ORA, 3)		\
+	_(0x0E, Abs, ASL, 5)		\
+	_(0x0F, Imp, Unoff, 0)		\
+	_(0x10, Rel, BPL, 1)		\
+	_(0x11, IndZeroY, ORA, 4)	\
+	_(0x12, Imp, Hang, 0)		\
+	_(0x13, Imp, Unoff, 0)		\
+	_(0x14, Imm, Unoff, 0)		\
+	_(0x15, ZeroX, ORA, 2)		\
+	_(0x16, ZeroX, ASL, 4)		\
+	_(0x17, Imp, Unoff, 0)		\
+	_(0x18, Imp, CLC, 1)		\
+	_(0x19, AbsY, ORA, 3)		\
+	_(0x1A, Imp, Unoff1, 0)		\
+	_(0x1B, Imp, Unoff, 0)		\
+	_(0x1C, Abs, Unoff, 0)		\
+	_(0x1D, AbsX, ORA, 3)		\
+	_(0x1E, WAbsX, ASL, 6)		\
+	_(0x1F, Imp, Unoff, 0)		\
+	_(0x20, Abs, JSR, 5)		\
+	_(0x21, IndZeroX, AND, 4)	\
+	_(0x22, Imp, Hang, 0)		\
+	_(0x23, Imp, Unoff, 0)		\
+	_(0x24, Zero, BIT, 2)		\
+	_(0x25, Zero, AND, 2)		\
+	_(0x26, Zero, ROL, 4)		\
+	_(0x27, Imp, Unoff, 0)		\
+	_(0x28, Imp, PLP, 3)		\
+	_(0x29, Imm, AND, 1)		\
+	_(0x2A, Imp, ROL_A, 1)		\
+	_(0x2B, Imm, AND, 1)		\
+	_(0x2C, Abs, BIT, 3)		\
+	_(0x2D, Abs, AND, 3)		\
+	_(0x2E, Abs, ROL, 5)		\
+	_(0x2F, Imp, Unoff, 0)		\
+	_(0x30, Rel, BMI, 1)		\
+	_(0x31, IndZeroY, AND, 4)	\
+	_(0x32, Imp, Hang, 0)		\
+	_(0x33, Imp, Unoff, 0)		\
+	_(0x34, Imm, Unoff, 0)		\
+	_(0x35, ZeroX, AND, 2)		\
+	_(0x36, ZeroX, ROL, 4)		\
+	_(0x37, Imp, Unoff, 0)		\
+	_(0x38, Imp, SEC, 1)		\
+	_(0x39, AbsY, AND, 3)		\
+	_(0x3A, Imp, Unoff1, 0)		\
+	_(0x3B, Imp, Unoff, 0)		\
+	_(0x3C, Abs, Unoff, 0)		\
+	_(0x3D, AbsX, AND, 3)		\
+	_(0x3E, WAbsX, ROL, 6)		\
+	_(0x3F, Imp, Unoff, 0)		\
+	_(0x40, Imp, RTI, 6)		\
+	_(0x41, IndZeroX, EOR, 4)	\
+	_(0x42, Imp, Hang, 0)		\
+	_(0x43, Imp, Unoff, 0)		\
+	_(0x44, Imm, Unoff, 0)		\
+	_(0x45, Zero, EOR, 2)		\
+	_(0x46, Zero, LSR, 4)		\
+	_(0x47, Imp, Unoff, 0)		\
+	_(0x48, Imp, PHA, 2)		\
+	_(0x49, Imm, EOR, 1)		\
+	_(0x4A, Imp, LSR_A, 1)		\
+	_(0x4B, Imp, Unoff, 0)		\
+	_(0x4C, Abs, JMP, 2)		\
+	_(0x4D, Abs, EOR, 3)		\
+	_(0x4E, Abs, LSR, 5)		\
+	_(0x4F, Imp, Unoff, 0)		\
+	_(0x50, Rel, BVC, 1)		\
+	_(0x51, IndZeroY, EOR, 4)	\
+	_(0x52, Imp, Hang, 0)		\
+	_(0x53, Imp, Unoff, 0)		\
+	_(0x54, Imm, Unoff, 0)		\
+	_(0x55, ZeroX, EOR, 2)		\
+	_(0x56, ZeroX, LSR, 4)		\
+	_(0x57, Imp, Unoff, 0)		\
+	_(0x58, Imp, CLI, 1)		\
+	_(0x59, AbsY, EOR, 3)		\
+	_(0x5A, Imp, Unoff1, 0)		\
+	_(0x5B, Imp, Unoff, 0)		\
+	_(0x5C, Abs, Unoff, 0)		\
+	_(0x5D, AbsX, EOR, 3)		\
+	_(0x5E, WAbsX, LSR, 6)		\
+	_(0x5F, Imp, Unoff, 0)		\
+	_(0x60, Imp, RTS, 5)		\
+	_(0x61, IndZeroX, ADC, 4)	\
+	_(0x62, Imp, Hang, 0)		\
+	_(0x63, Imp, Unoff, 0)		\
+	_(0x64, Imm, Unoff, 0)		\
+	_(0x65, Zero, ADC, 2)		\
+	_(0x66, Zero, ROR, 4)		\
+	_(0x67, Imp, Unoff, 0)		\
+	_(0x68, Imp, PLA, 3)		\
+	_(0x69, Imm, ADC, 1)		\
+	_(0x6A, Imp, ROR_A, 1)		\
+	_(0x6B, Imp, Unoff, 0)		\
+	_(0x6C, Ind, JMP, 4)		\
+	_(0x6D, Abs, ADC, 3)		\
+	_(0x6E, Abs, ROR, 5)		\
+	_(0x6F, Imp, Unoff, 0)		\
+	_(0x70, Rel, BVS, 1)		\
+	_(0x71, IndZeroY, ADC, 4)	\
+	_(0x72, Imp, Hang, 0)		\
+	_(0x73, Imp, Unoff, 0)		\
+	_(0x74, Imm, Unoff, 0)		\
+	_(0x75, ZeroX, ADC, 2)		\
+	_(0x76, ZeroX, ROR, 4)		\
+	_(0x77, Imp, Unoff, 0)		\
+	_(0x78, Imp, SEI, 1)		\
+	_(0x79, AbsY, ADC, 3)		\
+	_(0x7A, Imp, Unoff1, 0)		\
+	_(0x7B, Imp, Unoff, 0)		\
+	_(0x7C, Abs, Unoff, 0)		\
+	_(0x7D, AbsX, ADC, 3)		\
+	_(0x7E, WAbsX, ROR, 6)		\
+	_(0x7F, Imp, Unoff, 0)		\
+	_(0x80, Imm, Unoff, 0)		\
+	_(0x81, IndZeroX, STA, 4)	\
+	_(0x82, Imm, Unoff, 0)		\
+	_(0x83, Imp, Unoff, 0)		\
+	_(0x84, Zero, STY, 2)		\
+	_(0x85, Zero, STA, 2)		\
+	_(0x86, Zero, STX, 2)		\
+	_(0x87, Imp, Unoff, 0)		\
+	_(0x88, Imp, DEY, 1)		\
+	_(0x89, Imm, Unoff, 0)		\
+	_(0x8A, Imp, TXA, 1)		\
+	_(0x8B, Imp, Unoff, 0)		\
+	_(0x8C, Abs, STY, 3)		\
+	_(0x8D, Abs, STA, 3)		\
+	_(0x8E, Abs, STX, 3)		\
+	_(0x8F, Imp, Unoff, 0)		\
+	_(0x90, Rel, BCC, 1)		\
+	_(0x91, WIndZeroY, STA, 5)	\
+	_(0x92, Imp, Hang, 0)		\
+	_(0x93, Imp, Unoff, 0)		\
+	_(0x94, ZeroX, STY, 2)		\
+	_(0x95, ZeroX, STA, 2)		\
+	_(0x96, ZeroY, STX, 2)		\
+	_(0x97, Imp, Unoff, 0)		\
+	_(0x98, Imp, TYA, 1)		\
+	_(0x99, WAbsY, STA, 4)		\
+	_(0x9A, Imp, TXS, 1)		\
+	_(0x9B, Imp, Unoff, 0)		\
+	_(0x9C, Imp, Unoff, 0)		\
+	_(0x9D, WAbsX, STA, 4)		\
+	_(0x9E, Imp, Unoff, 0)		\
+	_(0x9F, Imp, Unoff, 0)		\
+	_(0xA0, Imm, LDY, 1)		\
+	_(0xA1, IndZeroX, LDA, 4)	\
+	_(0xA2, Imm, LDX, 1)		\
+	_(0xA3, Imp, Unoff, 0)		\
+	_(0xA4, Zero, LDY, 2)		\
+	_(0xA5, Zero, LDA, 2)		\
+	_(0xA6, Zero, LDX, 2)		\
+	_(0xA7, Imp, Unoff, 0)		\
+	_(0xA8, Imp, TAY, 1)		\
+	_(0xA9, Imm, LDA, 1)		\
+	_(0xAA, Imp, TAX, 1)		\
+	_(0xAB, Imp, Unoff, 0)		\
+	_(0xAC, Abs, LDY, 3)		\
+	_(0xAD, Abs, LDA, 3)		\
+	_(0xAE, Abs, LDX, 3)		\
+	_(0xAF, Imp, Unoff, 0)		\
+	_(0xB0, Rel, BCS, 1)		\
+	_(0xB1, IndZeroY, LDA, 4)	\
+	_(0xB2, Imp, Hang, 0)		\
+	_(0xB3, Imp, Unoff, 0)		\
+	_(0xB4, ZeroX, LDY, 2)		\
+	_(0xB5, ZeroX, LDA, 2)		\
+	_(0xB6, ZeroY, LDX, 2)		\
+	_(0xB7, Imp, Unoff, 0)		\
+	_(0xB8, Imp, CLV, 1)		\
+	_(0xB9, AbsY, LDA, 3)		\
+	_(0xBA, Imp, TSX, 1)		\
+	_(0xBB, Imp, Unoff, 0)		\
+	_(0xBC, AbsX, LDY, 3)		\
+	_(0xBD, AbsX, LDA, 3)		\
+	_(0xBE, AbsY, LDX, 3)		\
+	_(0xBF, Imp, Unoff, 0)		\
+	_(0xC0, Imm, CPY, 1)		\
+	_(0xC1, IndZeroX, CMP, 4)	\
+	_(0xC2, Imm, Unoff, 0)		\
+	_(0xC3, Imp, Unoff, 0)		\
+	_(0xC4, Zero, CPY, 2)		\
+	_(0xC5, Zero, CMP, 2)		\
+	_(0xC6, Zero, DEC, 3)		\
+	_(0xC7, Imp, Unoff, 0)		\
+	_(0xC8, Imp, INY, 1)		\
+	_(0xC9, Imm, CMP, 1)		\
+	_(0xCA, Imp, DEX, 1)		\
+	_(0xCB, Imp, Unoff, 0)		\
+	_(0xCC, Abs, CPY, 3)		\
+	_(0xCD, Abs, CMP, 3)		\
+	_(0xCE, Abs, DEC, 4)		\
+	_(0xCF, Imp, Unoff, 0)		\
+	_(0xD0, Rel, BNE, 1)		\
+	_(0xD1, IndZeroY, CMP, 4)	\
+	_(0xD2, Imp, Hang, 0)		\
+	_(0xD3, Imp, Unoff, 0)		\
+	_(0xD4, Imm, Unoff, 0)		\
+	_(0xD5, ZeroX, CMP, 2)		\
+	_(0xD6, ZeroX, DEC, 3)		\
+	_(0xD7, Imp, Unoff, 0)		\
+	_(0xD8, Imp, CLD, 1)		\
+	_(0xD9, AbsY, CMP, 3)		\
+	_(0xDA, Imp, Unoff1, 0)		\
+	_(0xDB, Imp, Unoff, 0)		\
+	_(0xDC, Abs, Unoff, 0)		\
+	_(0xDD, AbsX, CMP, 3)		\
+	_(0xDE, WAbsX, DEC, 5)		\
+	_(0xDF, Imp, Unoff, 0)		\
+	_(0xE0, Imm, CPX, 1)		\
+	_(0xE1, IndZeroX, SBC, 4)	\
+	_(0xE2, Imm, Unoff, 0)		\
+	_(0xE3, Imp, Unoff, 0)		\
+	_(0xE4, Zero, CPX, 2)		\
+	_(0xE5, Zero, SBC, 2)		\
+	_(0xE6, Zero, INC, 3)		\
+	_(0xE7, Imp, Unoff, 0)		\
+	_(0xE8, Imp, INX, 1)		\
+	_(0xE9, Imm, SBC, 1)		\
+	_(0xEA, Imp, NOP, 1)		\
+	_(0xEB, Imm, SBC, 1)		\
+	_(0xEC, Abs, CPX, 3)		\
+	_(0xED, Abs, SBC, 3)		\
+	_(0xEE, Abs, INC, 4)		\
+	_(0xEF, Imp, Unoff, 0)		\
+	_(0xF0, Rel, BEQ, 1)		\
+	_(0xF1, IndZeroY, SBC, 4)	\
+	_(0xF2, Imp, Hang, 0)		\
+	_(0xF3, Imp, Unoff, 0)		\
+	_(0xF4, Imm, Unoff, 0)		\
+	_(0xF5, ZeroX, SBC, 2)		\
+	_(0xF6, ZeroX, INC, 3)		\
+	_(0xF7, Imp, Unoff, 0)		\
+	_(0xF8, Imp, SED, 1)		\
+	_(0xF9, AbsY, SBC, 3)		\
+	_(0xFA, Imp, Unoff1, 0)		\
+	_(0xFB, Imp, Unoff, 0)		\
+	_(0xFC, Abs, Unoff, 0)		\
+	_(0xFD, AbsX, SBC, 3)		\
+	_(0xFE, WAbsX, INC, 5)		\
+	_(0xFF, Imp, Unoff, 0)
+
+enum
+{
+	ImpMode, ImmMode, ZeroMode, ZeroXMode, ZeroYMode, AbsMode, AbsXMode, AbsYMode,
+	IndMode, IndZeroXMode, IndZeroYMode, RelMode, WAbsXMode, WAbsYMode, WIndZeroYMode
+};
+
+#endif
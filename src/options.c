@@ -17,8 +17,10 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "SDL.h"
+#include "display.h"
 #include "memory.h"
 #include "keyboard.h"
+#include "m6502.h"
 #include "screen.h"
 #include "config.h"
 
@@ -56,13 +58,13 @@ static void drawString(const char *str, int x, int y)
 	}
 }
 
-static void inputLoop(const char *str, int (*func)(void))
+static void inputLoop(Machine *machine, const char *str, int (*func)(Machine *))
 {
 	SDL_Event event;
 	SDL_Rect rect;
-	SDL_Surface *screen = SDL_GetVideoSurface();
+	SDL_Surface *screen = getDisplaySurface();
 	int screenWidth = screen->w, screenHeight = screen->h;
-	int i, c = 0, x = 0;
+	int i, c = 0, x = 0, key, typed;
 	char tmp;
 	int pixelSize = getPixelSize();
 	int characterWidth = 7 * pixelSize, characterHeight = 8 * pixelSize;
@@ -72,6 +74,7 @@ static void inputLoop(const char *str, int (*func)(void))
 	rect.w = screenWidth;
 	rect.h = 2 * characterHeight + pixelSize;
 
+	pauseRenderer();
 	SDL_FillRect(screen, &rect, 255);
 
 	drawString(str, 0, screenHeight - 16 * pixelSize);
@@ -79,201 +82,206 @@ static void inputLoop(const char *str, int (*func)(void))
 	if (type != TYPE_CHOICE)
 		drawCharacter(0, screenHeight - characterHeight, 0, 0, 0, 0x01);
 
-	SDL_UpdateRect(screen, rect.x, rect.y, rect.w, rect.h);
+	updateDisplayRect(rect.x, rect.y, rect.w, rect.h);
 
 	step = 1;
 
-	while (1)
+	while (SDL_WaitEvent(&event))
 	{
-		while (SDL_PollEvent(&event))
-		{
-			if (event.type == SDL_QUIT || (event.type == SDL_KEYDOWN && event.key.keysym.mod & KMOD_CTRL && event.key.keysym.sym == SDLK_q))
-				exit(0);
-
-			if (event.type == SDL_KEYDOWN)
-			{
-				if (event.key.keysym.sym == SDLK_ESCAPE)
-				{
-					redrawScreen();
-					return;
-				}
-				else if (event.key.keysym.sym == SDLK_SPACE && type == TYPE_STRING)
-				{
-					if (c < max)
-						buffer[c++] = ' ';
-					else
-						continue;
+		if (event.type == SDL_QUIT || (event.type == SDL_KEYDOWN && event.key.keysym.mod & KMOD_CTRL && event.key.keysym.sym == SDLK_q))
+			exit(0);
 
-					if (c - 1 < 39)
-					{
-						rect.x = x;
-						rect.y = screenHeight - characterHeight;
-						rect.w = characterWidth;
-						rect.h = characterHeight;
-						
-						SDL_FillRect(screen, &rect, 255);
-						
-						x += characterWidth;
-
-						drawCharacter(x, rect.y, 0, 0, 0, 0x01);
-
-						SDL_UpdateRect(screen, rect.x, rect.y, 2 * characterWidth, characterHeight);
-					}
-					else
-					{
-						rect.x = 0;
-						rect.y = screenHeight - characterHeight;
-						rect.w = screenWidth - characterWidth;
-						rect.h = characterHeight;
+		if (event.type == SDL_USEREVENT && event.user.code == EVENT_FRAME)
+			frameElapsed();
 
-						SDL_FillRect(screen, &rect, 255);
+		key = event.type == SDL_KEYDOWN ? event.key.keysym.sym : 0;
+		typed = getTypedCharacter(&event);
 
-						rect.w = characterWidth;
+		if (key || typed)
+		{
+			if (key == SDLK_ESCAPE)
+			{
+				resumeRenderer();
+				redrawScreen(machine);
+				return;
+			}
+			else if (key == SDLK_SPACE && type == TYPE_STRING)
+			{
+				if (c < max)
+					buffer[c++] = ' ';
+				else
+					continue;
 
-						for (i = 0; i < 39; i++)
-						{
-							rect.x = characterWidth * i;
+				if (c - 1 < 39)
+				{
+					rect.x = x;
+					rect.y = screenHeight - characterHeight;
+					rect.w = characterWidth;
+					rect.h = characterHeight;
+					
+					SDL_FillRect(screen, &rect, 255);
+					
+					x += characterWidth;
 
-							if (buffer[(c - 39) + i] == ' ')
-								SDL_FillRect(screen, &rect, 255);
-							else
-								drawCharacter(rect.x, rect.y, 0, 0, 0, buffer[(c - 39) + i]);
-						}
+					drawCharacter(x, rect.y, 0, 0, 0, 0x01);
 
-						SDL_UpdateRect(screen, 0, rect.y, screenWidth - characterWidth, characterHeight);
-					}
+					updateDisplayRect(rect.x, rect.y, 2 * characterWidth, characterHeight);
 				}
-				else if (event.key.keysym.sym == SDLK_BACKSPACE && type != TYPE_CHOICE)
+				else
 				{
-					if (c > 0)
-						buffer[--c] = '\0';
-					else
-						continue;
+					rect.x = 0;
+					rect.y = screenHeight - characterHeight;
+					rect.w = screenWidth - characterWidth;
+					rect.h = characterHeight;
 
-					if (x > 0 && c < 39)
-					{
-						x -= characterWidth;
-
-						rect.x = x;
-						rect.y = screenHeight - characterHeight;
-						rect.w = 2 * characterWidth;
-						rect.h = characterHeight;
-						
-						SDL_FillRect(screen, &rect, 255);
-						
-						drawCharacter(x, rect.y, 0, 0, 0, 0x01);
-
-						SDL_UpdateRect(screen, rect.x, rect.y, rect.w, characterHeight);
-					}
-					else
+					SDL_FillRect(screen, &rect, 255);
+
+					rect.w = characterWidth;
+
+					for (i = 0; i < 39; i++)
 					{
-						rect.x = 0;
-						rect.y = screenHeight - characterHeight;
-						rect.w = screenWidth - characterWidth;
-						rect.h = characterHeight;
+						rect.x = characterWidth * i;
 
-						SDL_FillRect(screen, &rect, 255);
+						if (buffer[(c - 39) + i] == ' ')
+							SDL_FillRect(screen, &rect, 255);
+						else
+							drawCharacter(rect.x, rect.y, 0, 0, 0, buffer[(c - 39) + i]);
+					}
 
-						rect.w = characterWidth;
+					updateDisplayRect(0, rect.y, screenWidth - characterWidth, characterHeight);
+				}
+			}
+			else if (key == SDLK_BACKSPACE && type != TYPE_CHOICE)
+			{
+				if (c > 0)
+					buffer[--c] = '\0';
+				else
+					continue;
 
-						for (i = 0; i < 39; i++)
-						{
-							rect.x = characterWidth * i;
+				if (x > 0 && c < 39)
+				{
+					x -= characterWidth;
 
-							if (buffer[(c - 39) + i] == ' ')
-								SDL_FillRect(screen, &rect, 255);
-							else
-								drawCharacter(rect.x, rect.y, 0, 0, 0, buffer[(c - 39) + i]);
-						}
+					rect.x = x;
+					rect.y = screenHeight - characterHeight;
+					rect.w = 2 * characterWidth;
+					rect.h = characterHeight;
+					
+					SDL_FillRect(screen, &rect, 255);
+					
+					drawCharacter(x, rect.y, 0, 0, 0, 0x01);
 
-						SDL_UpdateRect(screen, 0, rect.y, screenWidth - characterWidth, characterHeight);
-					}
+					updateDisplayRect(rect.x, rect.y, rect.w, characterHeight);
 				}
-				else if ((event.key.keysym.sym == SDLK_RETURN && c) || (type == TYPE_CHOICE && (event.key.keysym.sym == SDLK_1 || event.key.keysym.sym == SDLK_2)))
+				else
 				{
-					if (type == TYPE_CHOICE)
-						choice = event.key.keysym.sym & 0x03;
-
 					rect.x = 0;
-					rect.y = screenHeight - (2 * characterHeight + pixelSize);
-					rect.w = screenWidth;
-					rect.h = 2 * characterHeight + pixelSize;
+					rect.y = screenHeight - characterHeight;
+					rect.w = screenWidth - characterWidth;
+					rect.h = characterHeight;
 
 					SDL_FillRect(screen, &rect, 255);
 
-					buffer[c] = '\0';
+					rect.w = characterWidth;
 
-					if (!(*func)())
+					for (i = 0; i < 39; i++)
 					{
-						redrawScreen();
-						return;
+						rect.x = characterWidth * i;
+
+						if (buffer[(c - 39) + i] == ' ')
+							SDL_FillRect(screen, &rect, 255);
+						else
+							drawCharacter(rect.x, rect.y, 0, 0, 0, buffer[(c - 39) + i]);
 					}
 
-					SDL_UpdateRect(screen, 0, rect.y, screenWidth, rect.h);
+					updateDisplayRect(0, rect.y, screenWidth - characterWidth, characterHeight);
+				}
+			}
+			else if ((key == SDLK_RETURN && c) || (type == TYPE_CHOICE && (key == SDLK_1 || key == SDLK_2)))
+			{
+				if (type == TYPE_CHOICE)
+					choice = key & 0x03;
 
-					c = x = 0;
+				rect.x = 0;
+				rect.y = screenHeight - (2 * characterHeight + pixelSize);
+				rect.w = screenWidth;
+				rect.h = 2 * characterHeight + pixelSize;
 
-					step++;
-				}
-				else if (!(event.key.keysym.unicode & 0xFF80) && event.key.keysym.unicode)
+				SDL_FillRect(screen, &rect, 255);
+
+				buffer[c] = '\0';
+
+				if (!(*func)(machine))
 				{
-					tmp = event.key.keysym.unicode & 0x7F;
+					resumeRenderer();
+					redrawScreen(machine);
+					return;
+				}
 
-					if (type == TYPE_HEXADECIMAL && tmp >= 0x61 && tmp <= 0x66)
-						tmp &= 0x5F;
+				updateDisplayRect(0, rect.y, screenWidth, rect.h);
 
-					if (c < max && ((type == TYPE_STRING && tmp >= 0x21 && tmp <= 0x7E) || (type == TYPE_DECIMAL && tmp >= 0x30 && tmp <= 0x39) || (type == TYPE_HEXADECIMAL && ((tmp >= 0x30 && tmp <= 0x39) || (tmp >= 0x41 && tmp <= 0x46)))))
-							buffer[c++] = tmp;
-					else
-						continue;
+				c = x = 0;
 
-					if (c - 1 < 39)
-					{
-						rect.x = x;
-						rect.y = screenHeight - characterHeight;
-						rect.w = characterWidth;
-						rect.h = characterHeight;
-						
-						SDL_FillRect(screen, &rect, 255);
-						
-						drawCharacter(x, rect.y, 0, 0, 0, tmp);
+				step++;
+			}
+			else if (typed)
+			{
+				tmp = (char)typed;
 
-						x += characterWidth;
+				if (type == TYPE_HEXADECIMAL && tmp >= 0x61 && tmp <= 0x66)
+					tmp &= 0x5F;
 
-						drawCharacter(x, rect.y, 0, 0, 0, 0x01);
+				if (c < max && ((type == TYPE_STRING && tmp >= 0x21 && tmp <= 0x7E) || (type == TYPE_DECIMAL && tmp >= 0x30 && tmp <= 0x39) || (type == TYPE_HEXADECIMAL && ((tmp >= 0x30 && tmp <= 0x39) || (tmp >= 0x41 && tmp <= 0x46)))))
+						buffer[c++] = tmp;
+				else
+					continue;
 
-						SDL_UpdateRect(screen, rect.x, rect.y, 2 * characterWidth, characterHeight);
-					}
-					else
-					{
-						rect.x = 0;
-						rect.y = screenHeight - characterHeight;
-						rect.w = screenWidth - characterWidth;
-						rect.h = characterHeight;
+				if (c - 1 < 39)
+				{
+					rect.x = x;
+					rect.y = screenHeight - characterHeight;
+					rect.w = characterWidth;
+					rect.h = characterHeight;
+					
+					SDL_FillRect(screen, &rect, 255);
+					
+					drawCharacter(x, rect.y, 0, 0, 0, tmp);
 
-						SDL_FillRect(screen, &rect, 255);
+					x += characterWidth;
 
-						rect.w = characterWidth;
+					drawCharacter(x, rect.y, 0, 0, 0, 0x01);
 
-						for (i = 0; i < 39; i++)
-						{
-							rect.x = 7 * pixelSize * i;
+					updateDisplayRect(rect.x, rect.y, 2 * characterWidth, characterHeight);
+				}
+				else
+				{
+					rect.x = 0;
+					rect.y = screenHeight - characterHeight;
+					rect.w = screenWidth - characterWidth;
+					rect.h = characterHeight;
 
-							if (buffer[(c - 39) + i] == ' ')
-								SDL_FillRect(screen, &rect, 255);
-							else
-								drawCharacter(rect.x, rect.y, 0, 0, 0, buffer[(c - 39) + i]);
-						}
+					SDL_FillRect(screen, &rect, 255);
 
-						SDL_UpdateRect(screen, 0, rect.y, screenWidth - characterWidth, characterHeight);
+					rect.w = characterWidth;
+
+					for (i = 0; i < 39; i++)
+					{
+						rect.x = 7 * pixelSize * i;
+
+						if (buffer[(c - 39) + i] == ' ')
+							SDL_FillRect(screen, &rect, 255);
+						else
+							drawCharacter(rect.x, rect.y, 0, 0, 0, buffer[(c - 39) + i]);
 					}
+
+					updateDisplayRect(0, rect.y, screenWidth - characterWidth, characterHeight);
 				}
 			}
 		}
 	}
 }
 
-static int loadMemoryFunc(void)
+static int loadMemoryFunc(Machine *machine)
 {
 	int i, length, size;
 	unsigned int address, value;
@@ -285,7 +293,7 @@ static int loadMemoryFunc(void)
 
 		strcpy(filename, buffer);
 
-		drawString("Choose file format:\nPress 1 for ASCII or 2 for Binary", 0, 192 * getPixelSize() - 16 * getPixelSize());
+		drawString("Choose file format:\nPress 1 for ASCII or 2 for Binary", 0, getDisplaySurface()->h - 16 * getPixelSize());
 	}
 	else if (step == 2)
 	{
@@ -293,14 +301,14 @@ static int loadMemoryFunc(void)
 		{
 			choice = 0;
 
-			drawString("Do you want to simulate keyboard input?:\nPress 1 for yes or 2 for no", 0, 192 * getPixelSize() - 16 * getPixelSize());
+			drawString("Do you want to simulate keyboard input?:\nPress 1 for yes or 2 for no", 0, getDisplaySurface()->h - 16 * getPixelSize());
 		}
 		else
 		{
 			type = TYPE_HEXADECIMAL;
 			max = 4;
 			
-			drawString("Enter starting address:", 0, 192 * getPixelSize() - 16 * getPixelSize());
+			drawString("Enter starting address:", 0, getDisplaySurface()->h - 16 * getPixelSize());
 
 			return 1;
 		}
@@ -321,7 +329,7 @@ static int loadMemoryFunc(void)
 			{
 				if (isInputFileOpen())
 				{
-					drawString("Do you want to abort the current read?:\nPress 1 for yes or 2 for no", 0, 192 * getPixelSize() - 16 * getPixelSize());
+					drawString("Do you want to abort the current read?:\nPress 1 for yes or 2 for no", 0, getDisplaySurface()->h - 16 * getPixelSize());
 					return 1;
 				}
 
@@ -330,6 +338,8 @@ static int loadMemoryFunc(void)
 				return 0;
 			}
 
+			stopM6502(machine);
+
 			while (!feof(fp))
 			{
 				if (!fgets(buffer, 1024, fp))
@@ -388,10 +398,11 @@ static int loadMemoryFunc(void)
 				for (; i < length; i += 3)
 				{
 					sscanf(&buffer[i], "%2X", &value);
-					memWrite(address++, value);
+					memWrite(machine, address++, value);
 				}
 			}
 
+			startM6502(machine);
 			printf("stdout: Successfully loaded \"%s\"\n", filename);
 		}
 		else
@@ -421,7 +432,9 @@ static int loadMemoryFunc(void)
 				else
 				{
 					fread(fbrut, 1, size, fp);
-					setMemory(fbrut, start, size);
+					stopM6502(machine);
+					setMemory(machine, fbrut, start, size);
+					startM6502(machine);
 					printf("stdout: Successfully loaded \"%s\"\n", filename);
 				}
 			}
@@ -448,15 +461,15 @@ static int loadMemoryFunc(void)
 	return 1;
 }
 
-void loadMemory(void)
+void loadMemory(Machine *machine)
 {
 	type = TYPE_STRING;
 	max = 1024;
 
-	inputLoop("Enter file to load:", &loadMemoryFunc);
+	inputLoop(machine, "Enter file to load:", &loadMemoryFunc);
 }
 
-static int saveMemoryFunc(void)
+static int saveMemoryFunc(Machine *machine)
 {
 	int i, j, k, length;
 	unsigned int end, temp;
@@ -469,20 +482,20 @@ static int saveMemoryFunc(void)
 
 		strcpy(filename, buffer);
 
-		drawString("Choose file format:\nPress 1 for ASCII or 2 for Binary", 0, 192 * getPixelSize() - 16 * getPixelSize());
+		drawString("Choose file format:\nPress 1 for ASCII or 2 for Binary", 0, getDisplaySurface()->h - 16 * getPixelSize());
 	}
 	else if (step == 2)
 	{
 		type = TYPE_HEXADECIMAL;
 		max = 4;
 		
-		drawString("Enter starting address:", 0, 192 * getPixelSize() - 16 * getPixelSize());
+		drawString("Enter starting address:", 0, getDisplaySurface()->h - 16 * getPixelSize());
 	}
 	else if (step == 3)
 	{	
 		sscanf(buffer, "%4X", &start);
 
-		drawString("Enter ending address:", 0, 192 * getPixelSize() - 16 * getPixelSize());
+		drawString("Enter ending address:", 0, getDisplaySurface()->h - 16 * getPixelSize());
 	}
 	else if (step == 4)
 	{
@@ -505,7 +518,7 @@ static int saveMemoryFunc(void)
 				return 0;
 			}
 
-			fbrut = dumpMemory(start, end);
+			fbrut = dumpMemory(machine, start, end);
 
 			if (fbrut)
 			{
@@ -557,7 +570,7 @@ static int saveMemoryFunc(void)
 				return 0;
 			}
 
-			fbrut = dumpMemory(start, end);
+			fbrut = dumpMemory(machine, start, end);
 
 			if (fbrut) {
 				fwrite(fbrut, 1, end - start + 1, fp);
@@ -575,35 +588,44 @@ static int saveMemoryFunc(void)
 	return 1;
 }
 
-void saveMemory(void)
+void saveMemory(Machine *machine)
 {
 	type = TYPE_STRING;
 	max = 1024;
 
-	inputLoop("Enter file to save:", &saveMemoryFunc);
+	inputLoop(machine, "Enter file to save:", &saveMemoryFunc);
 }
 
-static int changePixelSizeFunc(void)
+static int changePixelSizeFunc(Machine *machine)
 {
-	setPixelSize(choice);
+	int pixelSize = atoi(buffer);
+
+	if (pixelSize < 1 || pixelSize > MAX_PIXEL_SIZE)
+	{
+		fprintf(stderr, "stderr: Pixel size out of range\n");
+		return 0;
+	}
+
+	setPixelSize(pixelSize);
 	printf("stdout: pixelSize=%d\n", getPixelSize());
 
-	if (choice == 1)
+	if (pixelSize == 1)
 		setScanlines(0);
 
-	SDL_SetVideoMode(280 * getPixelSize(), 192 * getPixelSize(), 8, SDL_HWSURFACE | (getFullscreen() ? SDL_FULLSCREEN : 0));
+	setVideoMode();
 
 	return 0;
 }
 
-void changePixelSize(void)
+void changePixelSize(Machine *machine)
 {
-	type = TYPE_CHOICE;
+	type = TYPE_DECIMAL;
+	max = 2;
 
-	inputLoop("Choose pixel size:\nPress 1 for 1x or 2 for 2x", &changePixelSizeFunc);
+	inputLoop(machine, "Enter pixel size (Range: 1 - 16):", &changePixelSizeFunc);
 }
 
-static int changeTerminalSpeedFunc(void)
+static int changeTerminalSpeedFunc(Machine *machine)
 {
 	int terminalSpeed = atoi(buffer);
 
@@ -618,39 +640,41 @@ static int changeTerminalSpeedFunc(void)
 	return 0;
 }
 
-void changeTerminalSpeed(void)
+void changeTerminalSpeed(Machine *machine)
 {
 	type = TYPE_DECIMAL;
 	max = 3;
 
-	inputLoop("Enter terminal speed (Range: 1 - 120):", &changeTerminalSpeedFunc);
+	inputLoop(machine, "Enter terminal speed (Range: 1 - 120):", &changeTerminalSpeedFunc);
 }
 
-static int setIrqBrkVectorFunc(void)
+static int setIrqBrkVectorFunc(Machine *machine)
 {
 	unsigned int brkVector;
 
 	sscanf(buffer, "%4X", &brkVector);
-	memWrite(0xFFFE, (unsigned char)brkVector);
-	memWrite(0xFFFF, (unsigned char)(brkVector >> 8));
+	stopM6502(machine);
+	memWrite(machine, 0xFFFE, (unsigned char)brkVector);
+	memWrite(machine, 0xFFFF, (unsigned char)(brkVector >> 8));
+	startM6502(machine);
 	printf("stdout: brkVector=%s\n", buffer);
 
 	return 0;
 }
 
-void setIrqBrkVector(void)
+void setIrqBrkVector(Machine *machine)
 {
 	type = TYPE_HEXADECIMAL;
 	max = 4;
 
-	inputLoop("Enter IRQ/BRK vector:", &setIrqBrkVectorFunc);
+	inputLoop(machine, "Enter IRQ/BRK vector:", &setIrqBrkVectorFunc);
 }
 
-void showAbout(void)
+void showAbout(Machine *machine)
 {
 	SDL_Event event;
 	SDL_Rect rect;
-	SDL_Surface *screen = SDL_GetVideoSurface();
+	SDL_Surface *screen = getDisplaySurface();
 	int screenWidth = screen->w, screenHeight = screen->h;
 	int pixelSize = getPixelSize();
 	int characterWidth = 7 * pixelSize, characterHeight = 8 * pixelSize;
@@ -660,6 +684,7 @@ void showAbout(void)
 	rect.w = 36 * characterWidth;
 	rect.h = 10 * characterHeight;
 
+	pauseRenderer();
 	SDL_FillRect(screen, &rect, 255);
 
 	drawString(PACKAGE_NAME, (screenWidth - strlen(PACKAGE_NAME) * characterWidth) / 2, rect.y + characterHeight);
@@ -668,7 +693,7 @@ void showAbout(void)
 	drawString("Copyright (C) 2012 John D. Corrado", (screenWidth - 34 * characterWidth) / 2, rect.y + 6 * characterHeight);
 	drawString("Press Esc to continue", (screenWidth - 21 * characterWidth) / 2, rect.y + 8 * characterHeight);
 
-	SDL_UpdateRect(screen, rect.x, rect.y, rect.w, rect.h);
+	updateDisplayRect(rect.x, rect.y, rect.w, rect.h);
 
 	while (1)
 	{
@@ -677,9 +702,13 @@ void showAbout(void)
 			if (event.type == SDL_QUIT || (event.type == SDL_KEYDOWN && event.key.keysym.mod & KMOD_CTRL && event.key.keysym.sym == SDLK_q))
 				exit(0);
 
+			if (event.type == SDL_USEREVENT && event.user.code == EVENT_FRAME)
+				frameElapsed();
+
 			if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE)
 			{
-				redrawScreen();
+				resumeRenderer();
+				redrawScreen(machine);
 				return;
 			}
 		}
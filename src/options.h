@@ -19,11 +19,13 @@
 #ifndef __OPTIONS_H__
 #define __OPTIONS_H__
 
-void loadMemory(void);
-void saveMemory(void);
-void changePixelSize(void);
-void changeTerminalSpeed(void);
-void setIrqBrkVector(void);
-void showAbout(void);
+#include "machine.h"
+
+void loadMemory(Machine *machine);
+void saveMemory(Machine *machine);
+void changePixelSize(Machine *machine);
+void changeTerminalSpeed(Machine *machine);
+void setIrqBrkVector(Machine *machine);
+void showAbout(Machine *machine);
 
 #endif
@@ -16,57 +16,222 @@
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
-static unsigned char _dspCr = 0, _dsp = 0, _kbdCr = 0, _kbd = 0x80;
+#include <stdio.h>
+#include <stdlib.h>
+#include "atomics.h"
+#include "m6502.h"
+#include "pia6820.h"
+#include "scheduler.h"
+#include "config.h"
 
-void resetPia6820(void)
+#define PIA_RING_MASK (PIA_RING_SIZE - 1)
+
+// A single-producer, single-consumer queue. The producer only ever stores
+// head and the consumer only ever stores tail; each release store publishes
+// the slots written or freed before it to the other thread.
+typedef struct
+{
+	unsigned char data[PIA_RING_SIZE];
+	AtomicIndex head, tail;
+} Ring;
+
+// The CPU thread produces display output and consumes keyboard input, the
+// UI thread does the opposite. The control registers and the last values
+// read or written are only ever touched by the CPU thread, which publishes
+// whether the keyboard has been set up in keyboardReady for the UI thread.
+struct Pia6820
+{
+	Ring display, keyboard;
+	AtomicIndex displayPosted, keyboardReady;
+	unsigned char dspCr, dsp, kbdCr, kbd;
+};
+
+static unsigned int ringUsed(Ring *ring)
+{
+	return loadAcquire(&ring->head) - loadAcquire(&ring->tail);
+}
+
+static int pushRing(Ring *ring, const unsigned char *data, int count, unsigned int depth)
+{
+	unsigned int head = loadRelaxed(&ring->head), used = head - loadAcquire(&ring->tail);
+	int i;
+
+	if (used >= depth)
+		return 0;
+
+	if ((unsigned int)count > depth - used)
+		count = depth - used;
+
+	for (i = 0; i < count; i++)
+		ring->data[(head + i) & PIA_RING_MASK] = data[i];
+
+	storeRelease(&ring->head, head + count);
+
+	return count;
+}
+
+static int popRing(Ring *ring, unsigned char *data, int count)
+{
+	unsigned int tail = loadRelaxed(&ring->tail), used = loadAcquire(&ring->head) - tail;
+	int i;
+
+	if ((unsigned int)count > used)
+		count = used;
+
+	for (i = 0; i < count; i++)
+		data[i] = ring->data[(tail + i) & PIA_RING_MASK];
+
+	storeRelease(&ring->tail, tail + count);
+
+	return count;
+}
+
+Pia6820 *createPia6820(void)
+{
+	Pia6820 *pia = (Pia6820 *)calloc(1, sizeof(Pia6820));
+
+	if (!pia)
+	{
+		fprintf(stderr, "stderr: Could not allocate memory block\n");
+		return NULL;
+	}
+
+	pia->kbd = 0x80;
+
+	return pia;
+}
+
+void destroyPia6820(Pia6820 *pia)
 {
-	_kbdCr = _dspCr = _dsp = 0;
-	_kbd = 0x80;
+	free(pia);
 }
 
-void writeDspCr(unsigned char dspCr)
+// Runs on the CPU thread, the only one to touch the registers or consume
+// the keyboard ring.
+static void resetRegisters(Machine *machine, int data)
 {
-	_dspCr = dspCr;
+	Pia6820 *pia = machine->pia;
+
+	pia->kbdCr = pia->dspCr = pia->dsp = 0;
+	pia->kbd = 0x80;
+
+	storeRelease(&pia->keyboardReady, 0);
+	storeRelease(&pia->keyboard.tail, loadAcquire(&pia->keyboard.head));
+}
+
+// Called from the UI thread, which may empty the display ring it consumes
+// but not the keyboard ring it produces. The registers are reset and
+// pending keys dropped on the CPU thread through the scheduler instead.
+void resetPia6820(Machine *machine)
+{
+	Pia6820 *pia = machine->pia;
+
+	storeRelease(&pia->display.tail, loadAcquire(&pia->display.head));
+	scheduleEvent(machine, 0, resetRegisters, 0);
 }
 
-void writeDsp(unsigned char dsp)
+void writeDspCr(Machine *machine, unsigned char dspCr)
 {
-	if (!(_dspCr & 0x04))
+	machine->pia->dspCr = dspCr;
+}
+
+// A character written while the ring is full is lost, as it would be on a
+// PIA whose output has not been taken yet. Only the first character after
+// the UI thread last drained the ring posts an event.
+void writeDsp(Machine *machine, unsigned char dsp)
+{
+	Pia6820 *pia = machine->pia;
+
+	if (!(pia->dspCr & 0x04))
 		return;
 
-	_dsp = dsp;
+	pia->dsp = dsp;
+
+	if (pushRing(&pia->display, &dsp, 1, PIA_RING_SIZE) && !exchange(&pia->displayPosted, 1))
+		notifyMachine(machine, EVENT_DISPLAY);
 }
 
-void writeKbdCr(unsigned char kbdCr)
+void writeKbdCr(Machine *machine, unsigned char kbdCr)
 {
-	if (!_kbdCr)
-		kbdCr = 0x27;
+	Pia6820 *pia = machine->pia;
 
-	_kbdCr = kbdCr;
+	pia->kbdCr = pia->kbdCr ? kbdCr & 0x7F : 0x27;
+	storeRelease(&pia->keyboardReady, pia->kbdCr != 0);
 }
 
-void writeKbd(unsigned char kbd)
+void writeKbd(Machine *machine, unsigned char kbd)
 {
-	_kbd = kbd;
+	machine->pia->kbd = kbd;
 }
 
-unsigned char readDspCr(void)
+unsigned char readDspCr(Machine *machine)
 {
-	return _dspCr;
+	return machine->pia->dspCr;
 }
 
-unsigned char readDsp(void)
+// Bit 7 reports the display as busy once the ring holds as many characters
+// as it may. At 1x that is a single one, so programs wait on the terminal
+// speed exactly as before; above it the CPU may run a whole ring ahead.
+unsigned char readDsp(Machine *machine)
 {
-	return _dsp;
+	Pia6820 *pia = machine->pia;
+	unsigned int depth = isThrottled(machine) ? 1 : PIA_RING_SIZE;
+
+	if (ringUsed(&pia->display) >= depth)
+		return (unsigned char)(pia->dsp | 0x80);
+
+	return (unsigned char)(pia->dsp & 0x7F);
 }
 
-unsigned char readKbdCr(void)
+unsigned char readKbdCr(Machine *machine)
 {
-	return _kbdCr;
+	Pia6820 *pia = machine->pia;
+
+	return (unsigned char)(pia->kbdCr | (ringUsed(&pia->keyboard) ? 0x80 : 0x00));
 }
 
-unsigned char readKbd(void)
+// EVENT_KEYBOARD asks the UI thread to top the ring up when it falls to half
+// full, long before a program being loaded from a file could run out.
+unsigned char readKbd(Machine *machine)
 {
-	_kbdCr = 0x27;
-	return _kbd;
+	Pia6820 *pia = machine->pia;
+
+	if (popRing(&pia->keyboard, &pia->kbd, 1) && ringUsed(&pia->keyboard) == PIA_RING_SIZE / 2)
+		notifyMachine(machine, EVENT_KEYBOARD);
+
+	return pia->kbd;
+}
+
+// Takes up to size characters of display output, with bit 7 set as written.
+// The posted flag is cleared before the ring is read, so a character pushed
+// after the last one taken here always posts a new event; if size leaves
+// characters behind the event is posted again for them.
+int readDisplayOutput(Machine *machine, unsigned char *buffer, int size)
+{
+	Pia6820 *pia = machine->pia;
+	int count;
+
+	exchange(&pia->displayPosted, 0);
+
+	count = popRing(&pia->display, buffer, size);
+
+	if (ringUsed(&pia->display) && !exchange(&pia->displayPosted, 1))
+		notifyMachine(machine, EVENT_DISPLAY);
+
+	return count;
+}
+
+// Queues keys typed or read from a file, with bit 7 set, and returns how
+// many fit. Nothing is accepted before the program has set up the PIA.
+int writeKeyboardInput(Machine *machine, const unsigned char *keys, int count)
+{
+	if (!loadAcquire(&machine->pia->keyboardReady))
+		return 0;
+
+	count = pushRing(&machine->pia->keyboard, keys, count, PIA_RING_SIZE);
+
+	if (count)
+		wakeM6502(machine);
+
+	return count;
 }
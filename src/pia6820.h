@@ -19,14 +19,22 @@
 #ifndef __PIA6820_H__
 #define __PIA6820_H__
 
-void resetPia6820(void);
-void writeDspCr(unsigned char dspCr);
-void writeDsp(unsigned char dsp);
-void writeKbdCr(unsigned char kbdCr);
-void writeKbd(unsigned char kbd);
-unsigned char readDspCr(void);
-unsigned char readDsp(void);
-unsigned char readKbdCr(void);
-unsigned char readKbd(void);
+#include "machine.h"
+
+#define PIA_RING_SIZE 1024
+
+Pia6820 *createPia6820(void);
+void destroyPia6820(Pia6820 *pia);
+void resetPia6820(Machine *machine);
+void writeDspCr(Machine *machine, unsigned char dspCr);
+void writeDsp(Machine *machine, unsigned char dsp);
+void writeKbdCr(Machine *machine, unsigned char kbdCr);
+void writeKbd(Machine *machine, unsigned char kbd);
+unsigned char readDspCr(Machine *machine);
+unsigned char readDsp(Machine *machine);
+unsigned char readKbdCr(Machine *machine);
+unsigned char readKbd(Machine *machine);
+int readDisplayOutput(Machine *machine, unsigned char *buffer, int size);
+int writeKeyboardInput(Machine *machine, const unsigned char *keys, int count);
 
 #endif
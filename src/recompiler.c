@@ -0,0 +1,445 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "opcodes.h"
+
+#define OPCODE_ENTRY(code, mode, operation, baseCycles) { mode##Mode, #operation, baseCycles },
+
+typedef struct
+{
+	int mode;
+	const char *operation;
+	int cycles;
+} Opcode;
+
+static const Opcode opcodes[256] = { OPCODES(OPCODE_ENTRY) };
+
+static unsigned char image[65536], loaded[65536], recovered[65536], code[65536];
+static unsigned short worklist[65536];
+static int worklistSize;
+static FILE *out;
+
+static int instructionLength(unsigned char opcode)
+{
+	switch (opcodes[opcode].mode)
+	{
+	case ImpMode:
+		return 1;
+	case AbsMode:
+	case AbsXMode:
+	case AbsYMode:
+	case IndMode:
+	case WAbsXMode:
+	case WAbsYMode:
+		return 3;
+	}
+
+	return 2;
+}
+
+static unsigned short readWord(unsigned short address)
+{
+	return image[address] | image[(unsigned short)(address + 1)] << 8;
+}
+
+static unsigned short branchTarget(unsigned short address)
+{
+	unsigned short offset = image[(unsigned short)(address + 1)];
+
+	if (offset & 0x80)
+		offset |= 0xFF00;
+
+	return address + 2 + offset;
+}
+
+static int isOperation(unsigned short address, const char *operation)
+{
+	return !strcmp(opcodes[image[address]].operation, operation);
+}
+
+static int isExit(unsigned short address)
+{
+	return isOperation(address, "BRK") || isOperation(address, "RTI") || isOperation(address, "Hang");
+}
+
+static void addEntry(unsigned short address)
+{
+	if (!recovered[address])
+		worklist[worklistSize++] = address;
+}
+
+static void recover(void)
+{
+	unsigned short address;
+	int i, length;
+
+	while (worklistSize)
+	{
+		address = worklist[--worklistSize];
+
+		if (recovered[address] || address >> 8 == 0xD0)
+			continue;
+
+		length = instructionLength(image[address]);
+
+		for (i = 0; i < length; i++)
+			if (!loaded[(unsigned short)(address + i)])
+				break;
+
+		if (i < length || address >> 8 != (unsigned short)(address + length - 1) >> 8)
+			continue;
+
+		recovered[address] = 1;
+
+		for (i = 0; i < length; i++)
+			code[(unsigned short)(address + i)] = 1;
+
+		if (opcodes[image[address]].mode == RelMode)
+		{
+			addEntry(branchTarget(address));
+			addEntry((unsigned short)(address + 2));
+		}
+		else if (isOperation(address, "JSR"))
+		{
+			addEntry(readWord((unsigned short)(address + 1)));
+			addEntry((unsigned short)(address + 3));
+		}
+		else if (isOperation(address, "JMP"))
+		{
+			if (opcodes[image[address]].mode == AbsMode)
+				addEntry(readWord((unsigned short)(address + 1)));
+		}
+		else if (!isOperation(address, "RTS") && !isExit(address))
+			addEntry((unsigned short)(address + length));
+	}
+}
+
+static void emitJump(unsigned short target)
+{
+	if (recovered[target])
+		fprintf(out, "\tgoto L%04X;\n", target);
+	else
+		fprintf(out, "\tEXIT(0x%04X);\n", target);
+}
+
+static void emitAddress(unsigned short address)
+{
+	unsigned char operand = image[(unsigned short)(address + 1)];
+	unsigned short word = readWord((unsigned short)(address + 1));
+
+	switch (opcodes[image[address]].mode)
+	{
+	case ZeroMode:
+		fprintf(out, "\tea = 0x%02X;\n", operand);
+		break;
+	case ZeroXMode:
+		fprintf(out, "\tea = (0x%02X + X) & 0xFF;\n", operand);
+		break;
+	case ZeroYMode:
+		fprintf(out, "\tea = (0x%02X + Y) & 0xFF;\n", operand);
+		break;
+	case AbsMode:
+		fprintf(out, "\tea = 0x%04X;\n", word);
+		break;
+	case AbsXMode:
+	case AbsYMode:
+		fprintf(out, "\tt = 0x%02X + %c;\n", word & 0xFF, opcodes[image[address]].mode == AbsXMode ? 'X' : 'Y');
+		fprintf(out, "\tea = 0x%04X + t;\n", word & 0xFF00);
+		fprintf(out, "\tif (t & 0x100)\n\t\tcycles++;\n");
+		break;
+	case WAbsXMode:
+		fprintf(out, "\tea = 0x%04X + X;\n", word);
+		break;
+	case WAbsYMode:
+		fprintf(out, "\tea = 0x%04X + Y;\n", word);
+		break;
+	case IndMode:
+		fprintf(out, "\tea = READ(0x%04X) | READ(0x%04X) << 8;\n", word, (word & 0xFF00) | ((word + 1) & 0xFF));
+		break;
+	case IndZeroXMode:
+		fprintf(out, "\tt = (0x%02X + X) & 0xFF;\n", operand);
+		fprintf(out, "\tea = READ(t) | READ((t + 1) & 0xFF) << 8;\n");
+		break;
+	case IndZeroYMode:
+	case WIndZeroYMode:
+		fprintf(out, "\tt = READ(0x%02X) + Y;\n", operand);
+		fprintf(out, "\tea = (READ(0x%02X) << 8) + t;\n", (operand + 1) & 0xFF);
+
+		if (opcodes[image[address]].mode == IndZeroYMode)
+			fprintf(out, "\tif (t & 0x100)\n\t\tcycles++;\n");
+		break;
+	}
+}
+
+static const char *branchCondition(const char *operation)
+{
+	static const char *const branches[8][2] =
+	{
+		{ "BPL", "!(P & 0x80)" }, { "BMI", "P & 0x80" }, { "BVC", "!(P & 0x40)" }, { "BVS", "P & 0x40" },
+		{ "BCC", "!(P & 0x01)" }, { "BCS", "P & 0x01" }, { "BNE", "!(P & 0x02)" }, { "BEQ", "P & 0x02" }
+	};
+	int i;
+
+	for (i = 0; i < 8; i++)
+		if (!strcmp(branches[i][0], operation))
+			return branches[i][1];
+
+	return NULL;
+}
+
+static void emitInstruction(unsigned short address)
+{
+	const Opcode *opcode = &opcodes[image[address]];
+	const char *operation = opcode->operation, *condition;
+	unsigned short next = address + instructionLength(image[address]), target;
+	char value[16];
+
+	fprintf(out, "L%04X:\n", address);
+
+	if (isExit(address))
+	{
+		fprintf(out, "\tEXIT(0x%04X);\n", address);
+		return;
+	}
+
+	if (!strcmp(operation, "ADC") || !strcmp(operation, "SBC"))
+		fprintf(out, "\tif (P & 0x08)\n\t\tEXIT(0x%04X);\n", address);
+
+	fprintf(out, "\tCHECK(0x%04X);\n", address);
+
+	if (opcode->cycles)
+		fprintf(out, "\tcycles += %d;\n", opcode->cycles);
+
+	emitAddress(address);
+
+	if (opcode->mode == ImmMode)
+		sprintf(value, "0x%02X", image[(unsigned short)(address + 1)]);
+	else
+		strcpy(value, "READ(ea)");
+
+	if ((condition = branchCondition(operation)) != NULL)
+	{
+		target = branchTarget(address);
+		fprintf(out, "\tif (%s)\n\t{\n\t\tcycles += %d;\n\t", condition, (next & 0xFF00) != (target & 0xFF00) ? 2 : 1);
+		emitJump(target);
+		fprintf(out, "\t}\n");
+	}
+	else if (!strcmp(operation, "LDA") || !strcmp(operation, "LDX") || !strcmp(operation, "LDY"))
+		fprintf(out, "\t%c = %s;\n\tSET_NZ(%c);\n", operation[2], value, operation[2]);
+	else if (!strcmp(operation, "STA") || !strcmp(operation, "STX") || !strcmp(operation, "STY"))
+		fprintf(out, "\tWRITE(ea, %c);\n", operation[2]);
+	else if (!strcmp(operation, "AND") || !strcmp(operation, "ORA") || !strcmp(operation, "EOR"))
+		fprintf(out, "\tA %c= %s;\n\tSET_NZ(A);\n", operation[0] == 'A' ? '&' : operation[0] == 'O' ? '|' : '^', value);
+	else if (!strcmp(operation, "CMP") || !strcmp(operation, "CPX") || !strcmp(operation, "CPY"))
+		fprintf(out, "\tt = %c - %s;\n\tSET_FLAG(0x01, !(t & 0x100));\n\tSET_NZ((unsigned char)t);\n", operation[1] == 'M' ? 'A' : operation[2], value);
+	else if (!strcmp(operation, "BIT"))
+		fprintf(out, "\tm = %s;\n\tSET_FLAG(0x40, m & 0x40);\n\tSET_FLAG(0x80, m & 0x80);\n\tSET_FLAG(0x02, !(m & A));\n", value);
+	else if (!strcmp(operation, "ADC"))
+		fprintf(out, "\tm = %s;\n\tt = A + m + (P & 0x01);\n\tSET_FLAG(0x40, (A ^ t) & ~(A ^ m) & 0x80);\n\tSET_FLAG(0x01, t & 0x100);\n\tA = t;\n\tSET_NZ(A);\n", value);
+	else if (!strcmp(operation, "SBC"))
+		fprintf(out, "\tm = %s;\n\tt = A - m - !(P & 0x01);\n\tSET_FLAG(0x40, (A ^ m) & (A ^ t) & 0x80);\n\tSET_FLAG(0x01, !(t & 0x100));\n\tA = t;\n\tSET_NZ(A);\n", value);
+	else if (!strcmp(operation, "ASL") || !strcmp(operation, "LSR") || !strcmp(operation, "ROL") || !strcmp(operation, "ROR") || !strcmp(operation, "INC") || !strcmp(operation, "DEC"))
+	{
+		fprintf(out, "\tm = READ(ea);\n");
+
+		if (!strcmp(operation, "ASL"))
+			fprintf(out, "\tSET_FLAG(0x01, m & 0x80);\n\tm <<= 1;\n");
+		else if (!strcmp(operation, "LSR"))
+			fprintf(out, "\tSET_FLAG(0x01, m & 0x01);\n\tm >>= 1;\n");
+		else if (!strcmp(operation, "ROL"))
+			fprintf(out, "\tt = m << 1 | (P & 0x01);\n\tSET_FLAG(0x01, m & 0x80);\n\tm = t;\n");
+		else if (!strcmp(operation, "ROR"))
+			fprintf(out, "\tt = m >> 1 | (P & 0x01) << 7;\n\tSET_FLAG(0x01, m & 0x01);\n\tm = t;\n");
+		else
+			fprintf(out, "\tm%s;\n", operation[0] == 'I' ? "++" : "--");
+
+		fprintf(out, "\tSET_NZ(m);\n\tWRITE(ea, m);\n");
+	}
+	else if (!strcmp(operation, "ASL_A"))
+		fprintf(out, "\tSET_FLAG(0x01, A & 0x80);\n\tA <<= 1;\n\tSET_NZ(A);\n");
+	else if (!strcmp(operation, "LSR_A"))
+		fprintf(out, "\tSET_FLAG(0x01, A & 0x01);\n\tA >>= 1;\n\tSET_NZ(A);\n");
+	else if (!strcmp(operation, "ROL_A"))
+		fprintf(out, "\tt = A << 1 | (P & 0x01);\n\tSET_FLAG(0x01, A & 0x80);\n\tA = t;\n\tSET_NZ(A);\n");
+	else if (!strcmp(operation, "ROR_A"))
+		fprintf(out, "\tt = A >> 1 | (P & 0x01) << 7;\n\tSET_FLAG(0x01, A & 0x01);\n\tA = t;\n\tSET_NZ(A);\n");
+	else if (!strcmp(operation, "INX") || !strcmp(operation, "INY") || !strcmp(operation, "DEX") || !strcmp(operation, "DEY"))
+		fprintf(out, "\t%c%s;\n\tSET_NZ(%c);\n", operation[2], operation[0] == 'I' ? "++" : "--", operation[2]);
+	else if (!strcmp(operation, "TAX") || !strcmp(operation, "TAY") || !strcmp(operation, "TXA") || !strcmp(operation, "TYA") || !strcmp(operation, "TSX"))
+		fprintf(out, "\t%c = %c;\n\tSET_NZ(%c);\n", operation[2], operation[1], operation[2]);
+	else if (!strcmp(operation, "TXS"))
+		fprintf(out, "\tS = X;\n");
+	else if (!strcmp(operation, "CLC") || !strcmp(operation, "CLI") || !strcmp(operation, "CLV") || !strcmp(operation, "CLD"))
+		fprintf(out, "\tP &= ~0x%02X;\n", operation[2] == 'C' ? 0x01 : operation[2] == 'I' ? 0x04 : operation[2] == 'V' ? 0x40 : 0x08);
+	else if (!strcmp(operation, "SEC") || !strcmp(operation, "SEI") || !strcmp(operation, "SED"))
+		fprintf(out, "\tP |= 0x%02X;\n", operation[2] == 'C' ? 0x01 : operation[2] == 'I' ? 0x04 : 0x08);
+	else if (!strcmp(operation, "PHA") || !strcmp(operation, "PHP"))
+		fprintf(out, "\tWRITE(0x100 + S, %c);\n\tS--;\n", operation[2] == 'A' ? 'A' : 'P');
+	else if (!strcmp(operation, "PLA"))
+		fprintf(out, "\tS++;\n\tA = READ(0x100 + S);\n\tSET_NZ(A);\n");
+	else if (!strcmp(operation, "PLP"))
+		fprintf(out, "\tS++;\n\tP = READ(0x100 + S);\n");
+	else if (!strcmp(operation, "JSR"))
+	{
+		fprintf(out, "\tWRITE(0x100 + S, 0x%02X);\n\tS--;\n", (unsigned short)(next - 1) >> 8);
+		fprintf(out, "\tWRITE(0x100 + S, 0x%02X);\n\tS--;\n", (next - 1) & 0xFF);
+		emitJump(readWord((unsigned short)(address + 1)));
+		return;
+	}
+	else if (!strcmp(operation, "RTS"))
+	{
+		fprintf(out, "\tS++;\n\tpc = READ(0x100 + S);\n\tS++;\n\tpc += READ(0x100 + S) << 8;\n\tpc++;\n\tgoto dispatch;\n");
+		return;
+	}
+	else if (!strcmp(operation, "JMP"))
+	{
+		if (opcode->mode == AbsMode)
+			emitJump(readWord((unsigned short)(address + 1)));
+		else
+			fprintf(out, "\tpc = ea;\n\tgoto dispatch;\n");
+
+		return;
+	}
+
+	for (target = address + 1; target != next && !recovered[target]; target++);
+
+	if (target != next || !recovered[next])
+		emitJump(next);
+}
+
+static void emitModule(const char *filename)
+{
+	unsigned int address, count = 0, entries;
+
+	fprintf(out, "// Generated by pom1rc from \"%s\"\n\n#include \"recompiler.h\"\n\n", filename);
+	fprintf(out, "static const unsigned short addresses[] =\n{");
+
+	for (address = 0; address < 65536; address++)
+		if (code[address])
+			fprintf(out, "%s0x%04X,", count++ % 8 ? " " : "\n\t", address);
+
+	fprintf(out, "\n};\n\nstatic const unsigned char bytes[] =\n{");
+
+	for (address = 0, count = 0; address < 65536; address++)
+		if (code[address])
+			fprintf(out, "%s0x%02X,", count++ % 8 ? " " : "\n\t", image[address]);
+
+	fprintf(out, "\n};\n\nstatic const unsigned short entries[] =\n{");
+
+	for (address = 0, entries = 0; address < 65536; address++)
+		if (recovered[address] && !isExit((unsigned short)address))
+			fprintf(out, "%s0x%04X,", entries++ % 8 ? " " : "\n\t", address);
+
+	fprintf(out, "\n};\n\nstatic int run(RecompilerState *state)\n{\n\tRECOMPILER_ENTER;\n\ndispatch:\n\tswitch (pc)\n\t{\n");
+
+	for (address = 0; address < 65536; address++)
+		if (recovered[address])
+			fprintf(out, "\tcase 0x%04X:\n\t\tgoto L%04X;\n", address, address);
+
+	fprintf(out, "\t}\n\n\tgoto leave;\n\n");
+
+	for (address = 0; address < 65536; address++)
+	{
+		if (recovered[address])
+		{
+			emitInstruction((unsigned short)address);
+
+			if (!recovered[(unsigned short)(address + instructionLength(image[address]))])
+				fprintf(out, "\n");
+		}
+	}
+
+	fprintf(out, "leave:\n\tRECOMPILER_LEAVE;\n}\n\n");
+	fprintf(out, "const RecompilerModule recompilerModule = { RECOMPILER_ABI, %u, addresses, bytes, %u, entries, run };\n", count, entries);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *filename = NULL, *output = NULL;
+	unsigned int start = 0, address;
+	int i, size, entries = 0;
+	FILE *fp;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp("-o", argv[i]) && i + 1 < argc)
+			output = argv[++i];
+		else if (!filename)
+			filename = argv[i];
+		else if (sscanf(argv[i], "%4X", &address) == 1)
+		{
+			if (entries++)
+				addEntry((unsigned short)address);
+			else
+				start = address;
+		}
+	}
+
+	if (!filename || !entries)
+	{
+		fprintf(stderr, "usage: pom1rc [-o output.c] file address [entry...]\n");
+		return 1;
+	}
+
+	if (entries == 1)
+		addEntry((unsigned short)start);
+
+	fp = fopen(filename, "rb");
+
+	if (!fp)
+	{
+		fprintf(stderr, "stderr: Could not open \"%s\" for read\n", filename);
+		return 1;
+	}
+
+	size = fread(&image[start], 1, 65536 - start, fp);
+	fclose(fp);
+	memset(&loaded[start], 1, size);
+
+	recover();
+
+	for (address = 0; address < 65536 && !recovered[address]; address++);
+
+	if (address == 65536)
+	{
+		fprintf(stderr, "stderr: No code could be recovered from \"%s\"\n", filename);
+		return 1;
+	}
+
+	out = output ? fopen(output, "w") : stdout;
+
+	if (!out)
+	{
+		fprintf(stderr, "stderr: Could not open \"%s\" for write\n", output);
+		return 1;
+	}
+
+	emitModule(filename);
+
+	if (output)
+	{
+		fclose(out);
+		printf("stdout: Successfully recompiled \"%s\" to \"%s\"\n", filename, output);
+	}
+
+	return 0;
+}
@@ -0,0 +1,93 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef __RECOMPILER_H__
+#define __RECOMPILER_H__
+
+#define RECOMPILER_ABI 4
+
+typedef struct
+{
+	unsigned char accumulator, xRegister, yRegister, statusRegister, stackPointer;
+	unsigned short programCounter;
+	int cycles;
+	const volatile int *running, *deadline, *IRQ, *NMI;
+	const unsigned char *memory, *validPages, *devicePages;
+	void *machine;
+	unsigned char (*read)(void *machine, unsigned short address);
+	void (*write)(void *machine, unsigned short address, unsigned char value);
+} RecompilerState;
+
+typedef struct
+{
+	int abi;
+	unsigned int count;
+	const unsigned short *addresses;
+	const unsigned char *bytes;
+	unsigned int entryCount;
+	const unsigned short *entries;
+	int (*run)(RecompilerState *state);
+} RecompilerModule;
+
+// The macros below are used by the C code pom1rc generates. They keep the
+// registers in locals so the compiler can hold them in host registers.
+
+#define RECOMPILER_ENTER				\
+	unsigned char A = state->accumulator;		\
+	unsigned char X = state->xRegister;		\
+	unsigned char Y = state->yRegister;		\
+	unsigned char P = state->statusRegister;	\
+	unsigned char S = state->stackPointer;		\
+	unsigned short pc = state->programCounter, ea;	\
+	unsigned char m;				\
+	unsigned int t;					\
+	int cycles = state->cycles, executed = 0
+
+#define RECOMPILER_LEAVE			\
+	state->accumulator = A;			\
+	state->xRegister = X;			\
+	state->yRegister = Y;			\
+	state->statusRegister = P;		\
+	state->stackPointer = S;		\
+	state->programCounter = pc;		\
+	state->cycles = cycles;			\
+	return executed
+
+#define EXIT(address)				\
+	do					\
+	{					\
+		pc = (address);			\
+		goto leave;			\
+	} while (0)
+
+#define CHECK(address)				\
+	do					\
+	{					\
+		if (!*state->running || cycles >= *state->deadline || *state->NMI || (*state->IRQ && !(P & 0x04)) || !state->validPages[(address) >> 8]) \
+			EXIT(address);		\
+		executed++;			\
+	} while (0)
+
+#define READ(address) (state->devicePages[(address) >> 8] ? state->read(state->machine, address) : state->memory[address])
+#define WRITE(address, value) state->write(state->machine, address, value)
+
+#define SET_NZ(value) (P = (P & 0x7D) | ((value) & 0x80) | ((value) ? 0 : 0x02))
+#define SET_FLAG(flag, condition) (P = (condition) ? P | (flag) : P & ~(flag))
+
+#endif
@@ -0,0 +1,213 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "SDL.h"
+#include "m6502.h"
+#include "scheduler.h"
+
+#define MAX_EVENTS 64
+
+typedef struct
+{
+	long long cycle;
+	unsigned int order;
+	EventHandler handler;
+	int data;
+} Event;
+
+// A binary min-heap ordered on cycle, then on posting order so that events
+// for the same cycle run first in, first out.
+struct Scheduler
+{
+	SDL_mutex *mutex;
+	Event events[MAX_EVENTS];
+	int count, posted;
+	unsigned int order;
+};
+
+Scheduler *createScheduler(void)
+{
+	Scheduler *scheduler = (Scheduler *)calloc(1, sizeof(Scheduler));
+
+	if (!scheduler)
+	{
+		fprintf(stderr, "stderr: Could not allocate memory block\n");
+		return NULL;
+	}
+
+	scheduler->mutex = SDL_CreateMutex();
+
+	if (!scheduler->mutex)
+	{
+		fprintf(stderr, "stderr: Could not create scheduler lock\n");
+		free(scheduler);
+		return NULL;
+	}
+
+	return scheduler;
+}
+
+void destroyScheduler(Scheduler *scheduler)
+{
+	SDL_DestroyMutex(scheduler->mutex);
+	free(scheduler);
+}
+
+static int before(const Event *a, const Event *b)
+{
+	if (a->cycle != b->cycle)
+		return a->cycle < b->cycle;
+
+	return (int)(a->order - b->order) < 0;
+}
+
+static void siftUp(Scheduler *scheduler, int i)
+{
+	Event event = scheduler->events[i];
+
+	while (i > 0 && before(&event, &scheduler->events[(i - 1) / 2]))
+	{
+		scheduler->events[i] = scheduler->events[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+
+	scheduler->events[i] = event;
+}
+
+static void siftDown(Scheduler *scheduler, int i)
+{
+	Event event = scheduler->events[i];
+	int child;
+
+	while ((child = i * 2 + 1) < scheduler->count)
+	{
+		if (child + 1 < scheduler->count && before(&scheduler->events[child + 1], &scheduler->events[child]))
+			child++;
+
+		if (!before(&scheduler->events[child], &event))
+			break;
+
+		scheduler->events[i] = scheduler->events[child];
+		i = child;
+	}
+
+	scheduler->events[i] = event;
+}
+
+static void removeFirst(Scheduler *scheduler)
+{
+	scheduler->events[0] = scheduler->events[--scheduler->count];
+
+	if (scheduler->count)
+		siftDown(scheduler, 0);
+}
+
+int scheduleEvent(Machine *machine, long long cycle, EventHandler handler, int data)
+{
+	Scheduler *scheduler = machine->scheduler;
+	Event *event;
+
+	SDL_mutexP(scheduler->mutex);
+
+	if (scheduler->count == MAX_EVENTS)
+	{
+		SDL_mutexV(scheduler->mutex);
+		fprintf(stderr, "stderr: Too many scheduled events\n");
+		return 0;
+	}
+
+	event = &scheduler->events[scheduler->count];
+	event->cycle = cycle;
+	event->order = scheduler->order++;
+	event->handler = handler;
+	event->data = data;
+	siftUp(scheduler, scheduler->count++);
+	scheduler->posted = 1;
+
+	SDL_mutexV(scheduler->mutex);
+
+	rescheduleM6502(machine);
+
+	return 1;
+}
+
+void cancelEvents(Machine *machine, EventHandler handler)
+{
+	Scheduler *scheduler = machine->scheduler;
+	int i, count = 0;
+
+	SDL_mutexP(scheduler->mutex);
+
+	for (i = 0; i < scheduler->count; i++)
+		if (scheduler->events[i].handler != handler)
+			scheduler->events[count++] = scheduler->events[i];
+
+	scheduler->count = count;
+
+	for (i = count / 2 - 1; i >= 0; i--)
+		siftDown(scheduler, i);
+
+	SDL_mutexV(scheduler->mutex);
+}
+
+// Handlers are called without the lock held so they can schedule further
+// events; any of those that are already due run in the same call.
+long long runEvents(Machine *machine, long long now)
+{
+	Scheduler *scheduler = machine->scheduler;
+	Event event;
+	long long next;
+
+	for (;;)
+	{
+		SDL_mutexP(scheduler->mutex);
+
+		if (!scheduler->count || scheduler->events[0].cycle > now)
+			break;
+
+		event = scheduler->events[0];
+		removeFirst(scheduler);
+
+		SDL_mutexV(scheduler->mutex);
+
+		event.handler(machine, event.data);
+	}
+
+	next = scheduler->count ? scheduler->events[0].cycle : NO_EVENT;
+	scheduler->posted = 0;
+
+	SDL_mutexV(scheduler->mutex);
+
+	return next;
+}
+
+// Tells the CPU whether anything was scheduled since runEvents() last
+// returned, so that a deadline computed from a stale answer is not kept.
+int eventsPosted(Machine *machine)
+{
+	Scheduler *scheduler = machine->scheduler;
+	int posted;
+
+	SDL_mutexP(scheduler->mutex);
+	posted = scheduler->posted;
+	SDL_mutexV(scheduler->mutex);
+
+	return posted;
+}
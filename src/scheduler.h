@@ -0,0 +1,42 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include "machine.h"
+
+#define NO_EVENT 0x7FFFFFFFFFFFFFFFLL
+
+typedef void (*EventHandler)(Machine *machine, int data);
+
+Scheduler *createScheduler(void);
+void destroyScheduler(Scheduler *scheduler);
+
+// Runs handler on the CPU thread once the CPU has executed the given number
+// of cycles since it was started. A cycle that has already passed means the
+// next instruction boundary. May be called from any thread.
+int scheduleEvent(Machine *machine, long long cycle, EventHandler handler, int data);
+void cancelEvents(Machine *machine, EventHandler handler);
+
+// Used by the CPU: runs every event due at cycle now and returns the cycle
+// of the next one, or NO_EVENT.
+long long runEvents(Machine *machine, long long now);
+int eventsPosted(Machine *machine);
+
+#endif
@@ -17,15 +17,66 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "SDL.h"
+#include "atomics.h"
 #include "configuration.h"
+#include "clock.h"
+#include "crt.h"
+#include "display.h"
+#include "keyboard.h"
+#include "m6502.h"
 #include "pia6820.h"
-
-static unsigned char charac[1024], screenTbl[960];
-static int indexX, indexY, pixelSize = 2, _scanlines = 0, terminalSpeed = 60;
-static long lastTime;
+#include "screen.h"
+#include "terminal.h"
+#include "video.h"
+#include "config.h"
+
+// The glyph expander needs SSE2 and the scaler the byte shuffle of SSSE3.
+// Both are built whenever the compiler can target them and used only on
+// processors that have them.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCREEN_SSE2
+#define SCREEN_SSSE3
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+#define FRAME_NANOS (1000000000LL / 60)
+#define NATIVE_PITCH (280 + 16)
+#define FRAME_FRESH 4
+
+static unsigned char charac[1024];
+static int pixelSize = 2, _scanlines = 0, terminalSpeed = 60;
+static long long nextOutput;
 static int _fullscreen = 0;
 static int _blinkCursor = 1, _blockCursor = 0;
 static SDL_Surface *screen;
+static SDL_TimerID cursorTimer, speedTimer;
+static int framePending;
+static int cursorX, cursorY, viewOffset, cursorShown;
+static unsigned int topLine, redraws;
+static Uint8 native[192][NATIVE_PITCH];
+static int scale = 1, offsetX, offsetY;
+static unsigned short scaleColumns[280 * MAX_PIXEL_SIZE], scaleBlocks[280 * MAX_PIXEL_SIZE / 16];
+static unsigned char scaleShuffles[280 * MAX_PIXEL_SIZE / 16][16];
+static int renderCrt, renderScanlines;
+
+// Frames go from the UI thread to the render thread without a lock. Each
+// thread owns one of the three and latestFrame holds the other, with
+// FRAME_FRESH set until the render thread takes it. Frames only change hands
+// by being swapped with it, so a frame is never read while it is written.
+static Frame view, frames[3], shown;
+static AtomicIndex latestFrame;
+static int backFrame = 1, frontFrame = 2;
+
+// The render thread draws into the window but only the UI thread hands it to
+// SDL, with the rectangles left in presentRects, and only while nothing is
+// being drawn. Dialogs and mode changes pause it to have the window to
+// themselves.
+static SDL_Thread *renderThread;
+static SDL_mutex *renderMutex;
+static SDL_cond *renderCond, *idleCond;
+static int paused, rendering, stopping, presentPosted, presentAll, presentCount;
+static SDL_Rect presentRects[24];
 
 int loadCharMap(void)
 {
@@ -81,82 +132,241 @@ int getTerminalSpeed(void)
 	return terminalSpeed;
 }
 
-static void synchronizeOutput(void)
+static void drawCharac(SDL_Surface *surface, int xPosition, int yPosition, Uint32 color, unsigned char characNumber)
 {
-	int sleepMillis = ((1000 / terminalSpeed) - (SDL_GetTicks() - lastTime));
+	SDL_Rect rect;
+	int k, l;
 
-	if (sleepMillis > 0)
-		SDL_Delay(sleepMillis);
+	for (k = 0; k < 8; k++)
+	{
+		for (l = 1; l < 8; l++)
+		{
+			if (charac[characNumber * 8 + k] & (0x01 << l))
+			{
+				rect.x = xPosition + pixelSize * (l - 1);
+				rect.y = yPosition + pixelSize * k;
+				rect.w = pixelSize;
+				rect.h = pixelSize - (_scanlines ? 1 : 0);
 
-	lastTime = SDL_GetTicks();
+				SDL_FillRect(surface, &rect, color);
+			}
+		}
+	}
 }
 
-static void newLine(void)
+typedef void (*LineExpander)(Uint8 *line, const unsigned char *bits, int count, Uint8 color);
+typedef void (*LineScaler)(Uint8 *destination, const Uint8 *source, int from, int to);
+
+// Expands one glyph row byte per cell into palette indices, 7 bytes a cell.
+// Bit 1 is the leftmost dot; bit 0 is not shown. Each cell is copied whole
+// from a table of the 128 possible rows, built again when the color
+// changes. The copy is 8 bytes, so the line needs a byte of slack.
+static void expandLineScalar(Uint8 *line, const unsigned char *bits, int count, Uint8 color)
 {
-	memcpy(&screenTbl, &screenTbl[40], 920);
-	memset(&screenTbl[920], 0, 40);
+	static Uint8 patterns[128][8];
+	static int patternsBuilt;
+	static Uint8 patternColor;
+
+	int i, l;
+
+	if (!patternsBuilt || color != patternColor)
+	{
+		for (i = 0; i < 128; i++)
+			for (l = 0; l < 7; l++)
+				patterns[i][l] = (i & (0x01 << l)) ? color : 0;
+
+		patternsBuilt = 1;
+		patternColor = color;
+	}
+
+	for (i = 0; i < count; i++, line += 7)
+		memcpy(line, patterns[bits[i] >> 1], 8);
 }
 
-static void outputDsp(unsigned char dsp)
+// Copies columns from to to - 1 of a native line, each repeated scale
+// times, through a table giving the source column of every output pixel.
+static void scaleLineScalar(Uint8 *destination, const Uint8 *source, int from, int to)
 {
-	unsigned char tmp;
+	int i;
 
-	dsp &= 0x7F;
-
-	tmp = dsp;
+	for (i = from * scale; i < to * scale; i++)
+		destination[i] = source[scaleColumns[i]];
+}
 
-	if (dsp >= 0x60 && dsp <= 0x7F)
-		tmp &= 0x5F;
+#ifdef SCREEN_SSE2
+// Tests every dot of a cell against its bit at once. A cell is 7 bytes
+// wide, so a single 16 byte store covers it; what is stored past the cell
+// is overwritten by the next one, or lands in the slack at the end of the
+// line.
+static __attribute__((target("sse2"))) void expandLineSse2(Uint8 *line, const unsigned char *bits, int count, Uint8 color)
+{
+	__m128i masks = _mm_setr_epi8(0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	__m128i dots, colors = _mm_set1_epi8((char)color);
+	int i;
 
-	switch (tmp)
+	for (i = 0; i < count; i++, line += 7)
 	{
-	case 0x0D:
-		indexX = 0;
-		indexY++;
-		break;
-	default:
-		if (tmp >= 0x20 && tmp <= 0x5F)
-		{
-			screenTbl[indexY * 40 + indexX] = tmp;
-			indexX++;
-		}
-		break;
+		dots = _mm_and_si128(_mm_set1_epi8((char)bits[i]), masks);
+		dots = _mm_cmpeq_epi8(dots, masks);
+		_mm_storeu_si128((__m128i *)line, _mm_and_si128(dots, colors));
 	}
+}
+#endif
+
+#ifdef SCREEN_SSSE3
+// Writes the output a block of 16 pixels at a time, each a shuffle of the
+// 16 source pixels from the block's first column on. A block may reach
+// past either end of the columns asked for; what it writes there is what
+// those pixels already hold. A partial block at the end of the line is
+// left to the table, as a full one would write past the right edge.
+static __attribute__((target("ssse3"))) void scaleLineSsse3(Uint8 *destination, const Uint8 *source, int from, int to)
+{
+	int block = from * scale / 16, last = (to * scale + 15) / 16;
+	__m128i pixels;
+
+	if (last > 280 * scale / 16)
+		last = 280 * scale / 16;
 
-	if (indexX == 40)
+	for (; block < last; block++)
 	{
-		indexX = 0;
-		indexY++;
+		pixels = _mm_loadu_si128((const __m128i *)&source[scaleBlocks[block]]);
+		pixels = _mm_shuffle_epi8(pixels, _mm_loadu_si128((const __m128i *)scaleShuffles[block]));
+		_mm_storeu_si128((__m128i *)&destination[block * 16], pixels);
 	}
-	if (indexY == 24)
+
+	if (last * 16 < to * scale)
+		scaleLineScalar(destination, source, last * 16 / scale, to);
+}
+#endif
+
+static LineExpander expandLine = expandLineScalar;
+static LineScaler scaleLine = scaleLineScalar;
+
+static void selectLineKernels(void)
+{
+#if defined(SCREEN_SSE2) || defined(SCREEN_SSSE3)
+	__builtin_cpu_init();
+#endif
+
+#ifdef SCREEN_SSE2
+	if (__builtin_cpu_supports("sse2"))
+		expandLine = expandLineSse2;
+#endif
+#ifdef SCREEN_SSSE3
+	if (__builtin_cpu_supports("ssse3"))
+		scaleLine = scaleLineSsse3;
+#endif
+}
+
+// Works out the largest whole scale at which the native screen fits the
+// window, centres it, and fills in the column tables for that scale.
+static void setScale(void)
+{
+	int i, j;
+
+	scale = screen->w / 280 < screen->h / 192 ? screen->w / 280 : screen->h / 192;
+
+	if (scale < 1)
+		scale = 1;
+	if (scale > MAX_PIXEL_SIZE)
+		scale = MAX_PIXEL_SIZE;
+
+	offsetX = screen->w > 280 * scale ? (screen->w - 280 * scale) / 2 : 0;
+	offsetY = screen->h > 192 * scale ? (screen->h - 192 * scale) / 2 : 0;
+
+	for (i = 0; i < 280 * scale; i++)
+		scaleColumns[i] = (unsigned short)(i / scale);
+
+	for (i = 0; i < 280 * scale / 16; i++)
 	{
-		newLine();
-		indexY--;
+		scaleBlocks[i] = (unsigned short)(i * 16 / scale);
+
+		for (j = 0; j < 16; j++)
+			scaleShuffles[i][j] = (unsigned char)((i * 16 + j) / scale - i * 16 / scale);
 	}
+}
+
+// Draws count cells of a row, background included, into the native screen.
+// Each of the 8 lines of the glyphs is expanded into a line buffer and
+// copied out, so the stores past the last cell never reach its neighbour.
+static void drawCells(int x, int y, const unsigned char *cells, int count)
+{
+	static Uint8 line[40 * 7 + 16];
 
-	writeDsp(dsp);
+	unsigned char bits[40];
+	Uint8 *pixels = &native[y * 8][x * 7], color = (Uint8)SDL_MapRGB(screen->format, 0, 255, 0);
+	int i, k;
+
+	for (k = 0; k < 8; k++, pixels += NATIVE_PITCH)
+	{
+		for (i = 0; i < count; i++)
+			bits[i] = charac[(cells[i] & 0x7F) * 8 + k];
+
+		expandLine(line, bits, count, color);
+		memcpy(pixels, line, count * 7);
+	}
 }
 
-static void drawCharac(int xPosition, int yPosition, unsigned char r, unsigned char g, unsigned char b, unsigned char characNumber)
+// Scales a rectangle of the native screen into the window and turns it into
+// window coordinates. Every native line is scaled once and copied to the
+// other rows it covers; with scanlines the last of them is black instead.
+// The CRT filter takes over when on, and as light spills from every pixel
+// into the next the rectangle grows by one all round.
+static void scaleRect(SDL_Rect *rect)
 {
-	SDL_Rect rect;
-	int k, l;
+	int crt = renderCrt && scale > 1, x, y, width, right, bottom, r;
+	Uint8 *pixels;
 
-	for (k = 0; k < 8; k++)
+	if (crt)
 	{
-		for (l = 1; l < 8; l++)
+		right = rect->x + rect->w < 280 ? rect->x + rect->w + 1 : 280;
+		bottom = rect->y + rect->h < 192 ? rect->y + rect->h + 1 : 192;
+		rect->x = (Sint16)(rect->x > 0 ? rect->x - 1 : 0);
+		rect->y = (Sint16)(rect->y > 0 ? rect->y - 1 : 0);
+		rect->w = (Uint16)(right - rect->x);
+		rect->h = (Uint16)(bottom - rect->y);
+	}
+
+	x = rect->x;
+	width = rect->w * scale;
+
+	if (SDL_MUSTLOCK(screen) && SDL_LockSurface(screen) < 0)
+		return;
+
+	pixels = (Uint8 *)screen->pixels + offsetY * screen->pitch + offsetX;
+
+	if (crt)
+		filterCrt(pixels, screen->pitch, native[0], NATIVE_PITCH, scale, renderScanlines, x, rect->y, rect->w, rect->h);
+	else
+	{
+		pixels += rect->y * scale * screen->pitch;
+
+		for (y = rect->y; y < rect->y + rect->h; y++)
 		{
-			if (charac[characNumber * 8 + k] & (0x01 << l))
-			{
-				rect.x = xPosition + pixelSize * (l - 1);
-				rect.y = yPosition + pixelSize * k;
-				rect.w = pixelSize;
-				rect.h = pixelSize - (_scanlines ? 1 : 0);
+			if (scale == 1)
+				memcpy(pixels + x, &native[y][x], rect->w);
+			else
+				scaleLine(pixels, native[y], x, x + rect->w);
+
+			pixels += screen->pitch;
 
-				SDL_FillRect(screen, &rect, SDL_MapRGB(screen->format, r, g, b));
+			for (r = 1; r < scale; r++, pixels += screen->pitch)
+			{
+				if (renderScanlines && r == scale - 1)
+					memset(pixels + x * scale, 0, width);
+				else
+					memcpy(pixels + x * scale, pixels - screen->pitch + x * scale, width);
 			}
 		}
 	}
+
+	if (SDL_MUSTLOCK(screen))
+		SDL_UnlockSurface(screen);
+
+	rect->x = (Sint16)(offsetX + x * scale);
+	rect->y = (Sint16)(offsetY + rect->y * scale);
+	rect->w = (Uint16)width;
+	rect->h = (Uint16)(rect->h * scale);
 }
 
 void setFullscreen(int fullscreen)
@@ -189,80 +399,479 @@ int getBlockCursor(void)
 	return _blockCursor;
 }
 
-static void drawBlinkingCursor(void)
+static Frame *takeFrame(void)
 {
-	static int clearCursor = 0;
-	static long lastTime = 0;
+	if (!(loadAcquire(&latestFrame) & FRAME_FRESH))
+		return NULL;
 
-	SDL_Rect rect;
+	frontFrame = exchange(&latestFrame, frontFrame) & 3;
+
+	return &frames[frontFrame];
+}
+
+// Moves the scaled screen in the window up by lines native lines, as the
+// native screen was. The rows below keep what they showed, which is still
+// what the native screen holds there.
+static void scrollWindow(int lines)
+{
+	Uint8 *pixels;
+
+	if (SDL_MUSTLOCK(screen) && SDL_LockSurface(screen) < 0)
+		return;
+
+	pixels = (Uint8 *)screen->pixels + offsetY * screen->pitch;
+	memmove(pixels, pixels + lines * scale * screen->pitch, (192 - lines) * scale * screen->pitch);
+
+	if (SDL_MUSTLOCK(screen))
+		SDL_UnlockSurface(screen);
+}
+
+// Draws what changed since the frame shown last and returns the number of
+// rectangles of the window it covers, or -1 for the whole window. Adjacent
+// changed rows are merged into their bounding rectangle, and only those are
+// scaled. When the view moved down the history by less than a screen, the
+// native screen and the window move up with it first. The CRT filter then
+// also has to redo the top line and the lines either side of the seam,
+// whose neighbours changed, and the whole screen is presented.
+static int renderFrame(const Frame *frame, SDL_Rect *rects)
+{
+	int from[24], to[24], shift = compareFrame(&shown, frame, from, to), full = shift < 0;
+	int j, left, right, count = 0;
+	SDL_Rect *rect;
+
+	renderCrt = frame->crt;
+	renderScanlines = frame->scanlines;
+
+	if (shift > 0)
+		memmove(native[0], native[shift * 8], (24 - shift) * 8 * NATIVE_PITCH);
 
-	if ((SDL_GetTicks() - lastTime) > 500)
+	for (j = 0; j < 24; j++)
 	{
-		lastTime = SDL_GetTicks();
-
-		rect.x = indexX * pixelSize * 7;
-		rect.y = indexY * pixelSize * 8;
-		rect.w = pixelSize * 7;
-		rect.h = pixelSize * 8;
-			
-		if (clearCursor)
-			SDL_FillRect(screen, &rect, 0);
+		left = from[j];
+		right = to[j];
+
+		if (left == right)
+			continue;
+
+		drawCells(left, j, &frame->cells[j][left], right - left);
+
+		left *= 7;
+		right *= 7;
+
+		if (count && rects[count - 1].y + rects[count - 1].h == j * 8)
+		{
+			rect = &rects[count - 1];
+
+			if (left > rect->x)
+				left = rect->x;
+			if (right < rect->x + rect->w)
+				right = rect->x + rect->w;
+
+			rect->x = (Sint16)left;
+			rect->w = (Uint16)(right - left);
+			rect->h += 8;
+		}
 		else
-			drawCharac(rect.x, rect.y, 0, 255, 0, (unsigned char)(_blockCursor ? 0x01 : 0x40));
+		{
+			rect = &rects[count++];
+			rect->x = (Sint16)left;
+			rect->y = (Sint16)(j * 8);
+			rect->w = (Uint16)(right - left);
+			rect->h = 8;
+		}
+	}
+
+	if (full)
+	{
+		// The cells tile the whole native screen and are drawn opaque, so
+		// only a border left around it by the window needs clearing.
+		if (screen->w != 280 * scale || screen->h != 192 * scale)
+			SDL_FillRect(screen, NULL, 0);
 
-		SDL_UpdateRect(screen, rect.x, rect.y, rect.w, rect.h);
-			
-		clearCursor = !clearCursor;
+		rects[0].x = rects[0].y = 0;
+		rects[0].w = 280;
+		rects[0].h = 192;
+
+		scaleRect(&rects[0]);
+
+		return -1;
 	}
+
+	if (shift)
+	{
+		scrollWindow(shift * 8);
+
+		if (renderCrt && scale > 1)
+		{
+			rect = &rects[count++];
+			rect->x = rect->y = 0;
+			rect->w = 280;
+			rect->h = 1;
+
+			rect = &rects[count++];
+			rect->x = 0;
+			rect->y = (Sint16)((24 - shift) * 8 - 1);
+			rect->w = 280;
+			rect->h = 2;
+		}
+	}
+
+	for (j = 0; j < count; j++)
+		scaleRect(&rects[j]);
+
+	if (shift)
+	{
+		rects[0].x = (Sint16)offsetX;
+		rects[0].y = (Sint16)offsetY;
+		rects[0].w = (Uint16)(280 * scale);
+		rects[0].h = (Uint16)(192 * scale);
+
+		return 1;
+	}
+
+	return count;
 }
 
-void redrawScreen(void)
+// Called with renderMutex held. Rectangles not yet presented add up, and
+// only the first of them posts EVENT_PRESENT.
+static void queuePresent(const SDL_Rect *rects, int count)
 {
-	int xPosition, yPosition;
-	int i, j;
+	if (count < 0 || presentCount + count > 24)
+		presentAll = 1;
+	else if (!presentAll)
+	{
+		memcpy(&presentRects[presentCount], rects, count * sizeof(SDL_Rect));
+		presentCount += count;
+	}
+
+	if ((presentAll || presentCount) && !presentPosted)
+	{
+		presentPosted = 1;
+		postEvent(EVENT_PRESENT);
+	}
+}
 
-	SDL_FillRect(screen, NULL, 0);
-		
-	for (i = 0; i < 40; i++)
+// Renders the latest frame whenever there is a new one, at most once per
+// frame period. Frames published in between are skipped.
+static int runRenderer(void *data)
+{
+	SDL_Rect rects[24];
+	Frame *frame;
+	long long lastFrame;
+	int count;
+
+	SDL_mutexP(renderMutex);
+
+	while (!stopping)
 	{
-		for (j = 0; j < 24; j++)
+		if (paused || !(frame = takeFrame()))
 		{
-			xPosition = i * pixelSize * 7;
-			yPosition = j * pixelSize * 8;
-				
-			drawCharac(xPosition, yPosition, 0, 255, 0, screenTbl[j * 40 + i]);
+			SDL_CondWait(renderCond, renderMutex);
+			continue;
 		}
+
+		rendering = 1;
+		SDL_mutexV(renderMutex);
+
+		count = renderFrame(frame, rects);
+		lastFrame = readClock();
+
+		SDL_mutexP(renderMutex);
+		rendering = 0;
+		queuePresent(rects, count);
+		SDL_CondSignal(idleCond);
+		SDL_mutexV(renderMutex);
+
+		sleepUntil(lastFrame + FRAME_NANOS);
+
+		SDL_mutexP(renderMutex);
 	}
 
-	if (!_blinkCursor)
-		drawCharac(indexX * pixelSize * 7, indexY * pixelSize * 8, 0, 255, 0, (unsigned char)(_blockCursor ? 0x01 : 0x40));
+	SDL_mutexV(renderMutex);
 
-	SDL_UpdateRect(screen, 0, 0, 0, 0);
+	return 0;
 }
 
-void resetScreen(void)
+static int startRenderer(void)
 {
-	indexX = indexY = 0;
+	renderMutex = SDL_CreateMutex();
+	renderCond = SDL_CreateCond();
+	idleCond = SDL_CreateCond();
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+	renderThread = SDL_CreateThread(runRenderer, "render", NULL);
+#else
+	renderThread = SDL_CreateThread(runRenderer, NULL);
+#endif
+
+	if (!renderThread)
+	{
+		fprintf(stderr, "stderr: Could not create render thread\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+static void stopRenderer(void)
+{
+	if (!renderThread)
+		return;
+
+	SDL_mutexP(renderMutex);
+	stopping = 1;
+	SDL_CondSignal(renderCond);
+	SDL_mutexV(renderMutex);
 
-	memset(screenTbl, 0, 960);
+	SDL_WaitThread(renderThread, NULL);
+	renderThread = NULL;
+
+	SDL_DestroyCond(idleCond);
+	SDL_DestroyCond(renderCond);
+	SDL_DestroyMutex(renderMutex);
+}
+
+// Keeps the render thread off the window until resumeRenderer() has been
+// called as many times, waiting for a frame being drawn to be done.
+void pauseRenderer(void)
+{
+	if (!renderThread)
+		return;
+
+	SDL_mutexP(renderMutex);
+	paused++;
+
+	while (rendering)
+		SDL_CondWait(idleCond, renderMutex);
+
+	SDL_mutexV(renderMutex);
+}
+
+// Whatever was left to present is dropped, as the window is redrawn whole
+// after a pause.
+void resumeRenderer(void)
+{
+	if (!renderThread)
+		return;
+
+	SDL_mutexP(renderMutex);
+
+	if (!--paused)
+	{
+		presentPosted = presentAll = presentCount = 0;
+		SDL_CondSignal(renderCond);
+	}
+
+	SDL_mutexV(renderMutex);
+}
+
+// Hands what the render thread drew to the display. While a frame is being
+// drawn nothing is, and the render thread posts EVENT_PRESENT again once
+// done. The flip, which may wait for the display's refresh, does not read
+// the surface and is left until the render thread may go on.
+void presentScreen(void)
+{
+	int updated = 0;
+
+	if (!renderThread)
+		return;
+
+	SDL_mutexP(renderMutex);
+	presentPosted = 0;
+
+	if (!rendering && (presentAll || presentCount))
+	{
+		updateDisplay(presentRects, presentAll ? -1 : presentCount);
+		presentAll = presentCount = 0;
+		updated = 1;
+	}
+
+	SDL_mutexV(renderMutex);
+
+	if (updated)
+		flipDisplay();
+}
+
+// Copies the frame into the one the UI thread owns and swaps it for the
+// latest one, waking the render thread.
+static void presentSdl(const Frame *frame)
+{
+	frames[backFrame] = *frame;
+	backFrame = exchange(&latestFrame, backFrame | FRAME_FRESH) & 3;
+
+	if (renderThread)
+	{
+		SDL_mutexP(renderMutex);
+		SDL_CondSignal(renderCond);
+		SDL_mutexV(renderMutex);
+	}
+}
+
+// Takes the view from the terminal and hands it to the video backend.
+static void publishFrame(Machine *machine)
+{
+	const VideoBackend *video = getVideoBackend();
+	int from[24], to[24], y;
+
+	// Backends compare frames themselves; only the count of lines scrolled
+	// is needed from the terminal.
+	topLine += takeDirtyCells(machine, from, to);
+
+	if (!video->present)
+		return;
+
+	getTerminalCursor(machine, &cursorX, &cursorY);
+
+	for (y = 0; y < 24; y++)
+		memcpy(view.cells[y], getTerminalRow(machine, y - viewOffset), 40);
+
+	if (!viewOffset && (!_blinkCursor || cursorShown))
+		view.cells[cursorY][cursorX] = (unsigned char)(_blockCursor ? 0x01 : 0x40);
+
+	view.topLine = topLine - viewOffset;
+	view.redraws = redraws;
+	view.crt = getCrt();
+	view.scanlines = _scanlines;
+
+	video->present(&view);
+}
+
+// Blinks the cursor by showing it in every other frame.
+void blinkCursor(Machine *machine)
+{
+	if (!_blinkCursor || viewOffset)
+		return;
+
+	cursorShown = !cursorShown;
+	publishFrame(machine);
+}
+
+static Uint32 blinkTimer(Uint32 interval, void *param)
+{
+	if (_blinkCursor)
+		postEvent(EVENT_BLINK);
+
+	return interval;
+}
+
+static Uint32 showSpeedTimer(Uint32 interval, void *param)
+{
+	postEvent(EVENT_SPEED);
+
+	return interval;
+}
+
+// Shows the emulated clock rate achieved since the previous call in the
+// window caption.
+void showSpeed(Machine *machine)
+{
+	static long long lastCycles, lastClock;
+
+	char caption[64];
+	long long cycles = getElapsedCycles(machine), now = readClock();
+
+	if (lastClock && now > lastClock)
+	{
+		sprintf(caption, "%s - %.2f MHz%s", PACKAGE_NAME, (cycles - lastCycles) * 1000.0 / (now - lastClock), getTurbo(machine) ? " (turbo)" : "");
+		setDisplayCaption(caption);
+	}
+
+	lastCycles = cycles;
+	lastClock = now;
+}
+
+// Has the backend draw the whole view again.
+void redrawScreen(Machine *machine)
+{
+	redraws++;
+	publishFrame(machine);
+}
+
+// Moves the view rows lines back into the history, or forward for a
+// negative count.
+void scrollScreen(Machine *machine, int rows)
+{
+	int offset = viewOffset + rows;
+
+	if (offset > getTerminalHistory(machine))
+		offset = getTerminalHistory(machine);
+	if (offset < 0)
+		offset = 0;
+
+	if (offset != viewOffset)
+	{
+		viewOffset = offset;
+		publishFrame(machine);
+	}
+}
+
+void resetScreen(Machine *machine)
+{
+	resetTerminal(machine);
 	
-	lastTime = SDL_GetTicks();
+	nextOutput = readClock();
+
+	redrawScreen(machine);
+}
+
+static Uint32 frameTimer(Uint32 interval, void *param)
+{
+	postEvent(EVENT_FRAME);
 
-	redrawScreen();
+	return 0;
 }
 
-void updateScreen(void)
+// Has updateScreen() called again at the given readClock() time through a
+// one-shot timer. A request made while one is pending is dropped, as both
+// fall within the same frame.
+static void requestFrame(long long when)
 {
-	unsigned char dsp = readDsp();
+	long long millis;
 
-	if (dsp & 0x80)
+	if (framePending)
+		return;
+
+	millis = (when - readClock() + 999999) / 1000000;
+	framePending = SDL_AddTimer(millis > 0 ? (Uint32)millis : 1, frameTimer, NULL) != 0;
+}
+
+void frameElapsed(void)
+{
+	framePending = 0;
+}
+
+// Every character that may be shown by now goes to the terminal: at 1x the
+// budget is terminalSpeed characters a second, above it there is no limit.
+// Up to a frame of lag is caught up, so timer granularity does not slow the
+// terminal down. Whatever changed goes to the render thread, and new output
+// while the history is shown returns to the screen.
+void updateScreen(Machine *machine)
+{
+	long long now = readClock(), period = 1000000000LL / terminalSpeed;
+	int throttled = isThrottled(machine), budget = PIA_RING_SIZE, count = 0;
+
+	if (throttled)
 	{
-		outputDsp(dsp);
-		redrawScreen();
-		synchronizeOutput();
+		if (nextOutput < now - FRAME_NANOS)
+			nextOutput = now - FRAME_NANOS;
+
+		budget = nextOutput <= now ? (int)((now - nextOutput) / period) + 1 : 0;
 	}
-	else if (_blinkCursor)
-		drawBlinkingCursor();
+
+	if (budget)
+	{
+		count = updateTerminal(machine, budget);
+
+		if (throttled)
+			nextOutput += count * period;
+	}
+	else
+		requestFrame(nextOutput);
+
+	if (!count)
+		return;
+
+	viewOffset = 0;
+	publishFrame(machine);
 }
 
 void drawCharacter(int xPosition, int yPosition, unsigned char r, unsigned char g, unsigned char b, unsigned char characNumber)
@@ -270,14 +879,113 @@ void drawCharacter(int xPosition, int yPosition, unsigned char r, unsigned char
 	if (_scanlines)
 	{
 		_scanlines = 0;
-		drawCharac(xPosition, yPosition, 0, 0, 0, characNumber);
+		drawCharac(screen, xPosition, yPosition, SDL_MapRGB(screen->format, 0, 0, 0), characNumber);
 		_scanlines = 1;
 	}
 	else
-		drawCharac(xPosition, yPosition, 0, 0, 0, characNumber);
+		drawCharac(screen, xPosition, yPosition, SDL_MapRGB(screen->format, 0, 0, 0), characNumber);
 }
 
 void initScreen(void)
 {
-	screen = SDL_GetVideoSurface();
+	screen = getDisplaySurface();
+	selectLineKernels();
+	setScale();
+	initCrt(screen);
+}
+
+// Opens a window width by height, or pixelSize times the native size when
+// asked for 0 by 0 and the whole desktop when fullscreen; the screen is
+// scaled to fit either way. The largest scale that fits a window the user
+// resized becomes the pixel size, so the window keeps it the next time it
+// is opened.
+static int resizeSdl(int width, int height)
+{
+	int resized = width || height, desktopWidth, desktopHeight;
+
+	if (!resized)
+	{
+		width = 280 * pixelSize;
+		height = 192 * pixelSize;
+
+		if (_fullscreen && getDesktopSize(&desktopWidth, &desktopHeight) && desktopWidth >= width && desktopHeight >= height)
+		{
+			width = desktopWidth;
+			height = desktopHeight;
+		}
+	}
+
+	if (width < 280)
+		width = 280;
+	if (height < 192)
+		height = 192;
+
+	pauseRenderer();
+
+	if (!openDisplay(width, height, _fullscreen))
+	{
+		fprintf(stderr, "stderr: Could not set video mode to %dx%dx8\n", width, height);
+		resumeRenderer();
+		return 0;
+	}
+
+	initScreen();
+	resumeRenderer();
+
+	if (resized && !_fullscreen)
+		pixelSize = scale;
+
+	if (pixelSize == 1)
+		_scanlines = 0;
+
+	return renderThread || startRenderer();
+}
+
+static int initSdl(void)
+{
+	return resizeSdl(0, 0);
+}
+
+// Draws into an SDL window through the render thread.
+const VideoBackend sdlVideo = { "sdl", 1, initSdl, presentSdl, resizeSdl, stopRenderer };
+
+// Starts the video backend, and the timers it has a use for.
+int openScreen(void)
+{
+	const VideoBackend *video = getVideoBackend();
+
+	if (video->init && !video->init())
+		return 0;
+
+	if (video->present)
+		cursorTimer = SDL_AddTimer(500, blinkTimer, NULL);
+	if (video->window)
+		speedTimer = SDL_AddTimer(1000, showSpeedTimer, NULL);
+
+	return 1;
+}
+
+void closeScreen(void)
+{
+	const VideoBackend *video = getVideoBackend();
+
+	if (video->shutdown)
+		video->shutdown();
+}
+
+// Applies the pixel size and fullscreen settings.
+int setVideoMode(void)
+{
+	const VideoBackend *video = getVideoBackend();
+
+	return !video->resize || video->resize(0, 0);
+}
+
+// Follows the window as it is resized.
+void resizeScreen(Machine *machine, int width, int height)
+{
+	const VideoBackend *video = getVideoBackend();
+
+	if (video->resize && video->resize(width, height))
+		redrawScreen(machine);
 }
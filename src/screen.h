@@ -19,16 +19,24 @@
 #ifndef __SCREEN_H__
 #define __SCREEN_H__
 
+#include "machine.h"
+
+#define MAX_PIXEL_SIZE 16
+
 int loadCharMap(void);
-void resetScreen(void);
+void resetScreen(Machine *machine);
 void setPixelSize(int ps);
 int getPixelSize(void);
 void setScanlines(int scanlines);
 int getScanlines(void);
 void setTerminalSpeed(int ts);
 int getTerminalSpeed(void);
-void redrawScreen(void);
-void updateScreen(void);
+void redrawScreen(Machine *machine);
+void updateScreen(Machine *machine);
+void scrollScreen(Machine *machine, int rows);
+void frameElapsed(void);
+void blinkCursor(Machine *machine);
+void showSpeed(Machine *machine);
 void drawCharacter(int xPosition, int yPosition, unsigned char r, unsigned char g, unsigned char b, unsigned char characNumber);
 void setFullscreen(int fullscreen);
 int getFullscreen(void);
@@ -38,5 +46,12 @@ int getBlinkCursor(void);
 void setBlockCursor(int blockCursor);
 int getBlockCursor(void);
 void initScreen(void);
+int openScreen(void);
+void closeScreen(void);
+int setVideoMode(void);
+void resizeScreen(Machine *machine, int width, int height);
+void presentScreen(void);
+void pauseRenderer(void);
+void resumeRenderer(void);
 
 #endif
@@ -0,0 +1,243 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pia6820.h"
+#include "terminal.h"
+
+#define DEFAULT_SCROLLBACK 500
+
+// The rows are kept in a ring of 24 + scrollback rows of 40 cells. Row 0 of
+// the screen is at index top, and up to history rows that scrolled off are
+// kept above it, so scrolling only moves top. dirtyFrom and dirtyTo hold
+// the columns of each screen row changed since the screen last took them,
+// as a half-open range that is empty when equal; scrolled counts the lines
+// scrolled in that time.
+struct Terminal
+{
+	unsigned char *rows;
+	int rowCount, top, history, scrolled;
+	int indexX, indexY;
+	unsigned char dirtyFrom[24], dirtyTo[24];
+};
+
+static unsigned char *getRow(Terminal *terminal, int y)
+{
+	return &terminal->rows[((terminal->top + y + terminal->rowCount) % terminal->rowCount) * 40];
+}
+
+static void damageCell(Terminal *terminal, int x, int y)
+{
+	if (terminal->dirtyFrom[y] >= terminal->dirtyTo[y])
+	{
+		terminal->dirtyFrom[y] = (unsigned char)x;
+		terminal->dirtyTo[y] = (unsigned char)(x + 1);
+	}
+	else if (x < terminal->dirtyFrom[y])
+		terminal->dirtyFrom[y] = (unsigned char)x;
+	else if (x >= terminal->dirtyTo[y])
+		terminal->dirtyTo[y] = (unsigned char)(x + 1);
+}
+
+static void damageAll(Terminal *terminal)
+{
+	memset(terminal->dirtyFrom, 0, 24);
+	memset(terminal->dirtyTo, 40, 24);
+}
+
+static int allocateRows(Terminal *terminal, int scrollback)
+{
+	unsigned char *rows = (unsigned char *)calloc(24 + scrollback, 40);
+
+	if (!rows)
+	{
+		fprintf(stderr, "stderr: Could not allocate memory block\n");
+		return 0;
+	}
+
+	free(terminal->rows);
+
+	terminal->rows = rows;
+	terminal->rowCount = 24 + scrollback;
+	terminal->top = terminal->history = 0;
+
+	return 1;
+}
+
+Terminal *createTerminal(void)
+{
+	Terminal *terminal = (Terminal *)calloc(1, sizeof(Terminal));
+
+	if (!terminal)
+	{
+		fprintf(stderr, "stderr: Could not allocate memory block\n");
+		return NULL;
+	}
+
+	if (!allocateRows(terminal, DEFAULT_SCROLLBACK))
+	{
+		free(terminal);
+		return NULL;
+	}
+
+	return terminal;
+}
+
+void destroyTerminal(Terminal *terminal)
+{
+	free(terminal->rows);
+	free(terminal);
+}
+
+void resetTerminal(Machine *machine)
+{
+	Terminal *terminal = machine->terminal;
+
+	terminal->indexX = terminal->indexY = 0;
+	terminal->top = terminal->history = terminal->scrolled = 0;
+
+	memset(terminal->rows, 0, terminal->rowCount * 40);
+	damageAll(terminal);
+}
+
+// Sets how many rows that scrolled off the top are kept. This clears the
+// terminal.
+void setScrollback(Machine *machine, int scrollback)
+{
+	if (allocateRows(machine->terminal, scrollback))
+		resetTerminal(machine);
+}
+
+int getScrollback(Machine *machine)
+{
+	return machine->terminal->rowCount - 24;
+}
+
+// The row leaving the screen stays in the ring as history, or is reused as
+// the new bottom row once the history is full. The dirty ranges move up
+// with their rows and the blank bottom row is dirty.
+static void newLine(Terminal *terminal)
+{
+	memset(getRow(terminal, 24), 0, 40);
+
+	terminal->top = (terminal->top + 1) % terminal->rowCount;
+
+	if (terminal->history < terminal->rowCount - 24)
+		terminal->history++;
+	if (terminal->scrolled < 24)
+		terminal->scrolled++;
+
+	memmove(terminal->dirtyFrom, &terminal->dirtyFrom[1], 23);
+	memmove(terminal->dirtyTo, &terminal->dirtyTo[1], 23);
+	terminal->dirtyFrom[23] = 0;
+	terminal->dirtyTo[23] = 40;
+}
+
+static void outputDsp(Terminal *terminal, unsigned char dsp)
+{
+	unsigned char tmp = dsp;
+
+	if (dsp >= 0x60 && dsp <= 0x7F)
+		tmp &= 0x5F;
+
+	switch (tmp)
+	{
+	case 0x0D:
+		terminal->indexX = 0;
+		terminal->indexY++;
+		break;
+	default:
+		if (tmp >= 0x20 && tmp <= 0x5F)
+		{
+			getRow(terminal, terminal->indexY)[terminal->indexX] = tmp;
+			damageCell(terminal, terminal->indexX, terminal->indexY);
+			terminal->indexX++;
+		}
+		break;
+	}
+
+	if (terminal->indexX == 40)
+	{
+		terminal->indexX = 0;
+		terminal->indexY++;
+	}
+	if (terminal->indexY == 24)
+	{
+		newLine(terminal);
+		terminal->indexY--;
+	}
+}
+
+// Outputs up to limit characters from the display ring and returns how many
+// were taken.
+int updateTerminal(Machine *machine, int limit)
+{
+	unsigned char buffer[PIA_RING_SIZE];
+	int count, i;
+
+	if (limit > PIA_RING_SIZE)
+		limit = PIA_RING_SIZE;
+
+	count = readDisplayOutput(machine, buffer, limit);
+
+	for (i = 0; i < count; i++)
+		outputDsp(machine->terminal, (unsigned char)(buffer[i] & 0x7F));
+
+	return count;
+}
+
+// Returns the 40 cells of screen row y, or of history row -y for y < 0 down
+// to -getTerminalHistory().
+const unsigned char *getTerminalRow(Machine *machine, int y)
+{
+	return getRow(machine->terminal, y);
+}
+
+int getTerminalHistory(Machine *machine)
+{
+	return machine->terminal->history;
+}
+
+void getTerminalCursor(Machine *machine, int *x, int *y)
+{
+	*x = machine->terminal->indexX;
+	*y = machine->terminal->indexY;
+}
+
+// Copies the dirty column range of every row into from and to, marks the
+// whole screen clean and returns how many lines scrolled in the meantime,
+// at most 24.
+int takeDirtyCells(Machine *machine, int *from, int *to)
+{
+	Terminal *terminal = machine->terminal;
+	int y, scrolled = terminal->scrolled;
+
+	for (y = 0; y < 24; y++)
+	{
+		from[y] = terminal->dirtyFrom[y];
+		to[y] = terminal->dirtyTo[y];
+	}
+
+	memset(terminal->dirtyTo, 0, 24);
+	memset(terminal->dirtyFrom, 0, 24);
+	terminal->scrolled = 0;
+
+	return scrolled;
+}
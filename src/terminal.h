@@ -0,0 +1,35 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef __TERMINAL_H__
+#define __TERMINAL_H__
+
+#include "machine.h"
+
+Terminal *createTerminal(void);
+void destroyTerminal(Terminal *terminal);
+void resetTerminal(Machine *machine);
+void setScrollback(Machine *machine, int scrollback);
+int getScrollback(Machine *machine);
+int updateTerminal(Machine *machine, int limit);
+const unsigned char *getTerminalRow(Machine *machine, int y);
+int getTerminalHistory(Machine *machine);
+void getTerminalCursor(Machine *machine, int *x, int *y);
+int takeDirtyCells(Machine *machine, int *from, int *to);
+
+#endif
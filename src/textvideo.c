@@ -0,0 +1,84 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <stdio.h>
+#include "video.h"
+
+// Draws the screen with ANSI escapes on the terminal Pom1 runs in, keeping
+// the first 24 lines as a scrolling region of their own. The cursor is left
+// below them, so whatever else is printed goes there.
+static Frame shown;
+static int started;
+
+static int initText(void)
+{
+	fputs("\033[2J\033[1;24r\033[?25l\033[25;1H", stdout);
+	fflush(stdout);
+	started = 1;
+
+	return 1;
+}
+
+static void putCell(unsigned char cell)
+{
+	if (cell == 0x01)
+		fputs("\033[7m \033[m", stdout);
+	else
+		putchar(cell >= 0x20 && cell <= 0x5F ? cell : ' ');
+}
+
+// Scrolls the region with newlines at its bottom when the view moved down
+// the history, then writes the cells that changed.
+static void presentText(const Frame *frame)
+{
+	int from[24], to[24], j, x, shift = compareFrame(&shown, frame, from, to);
+
+	if (shift > 0)
+	{
+		fputs("\033[24;1H", stdout);
+
+		for (j = 0; j < shift; j++)
+			putchar('\n');
+	}
+
+	for (j = 0; j < 24; j++)
+	{
+		if (from[j] == to[j])
+			continue;
+
+		printf("\033[%d;%dH", j + 1, from[j] + 1);
+
+		for (x = from[j]; x < to[j]; x++)
+			putCell(frame->cells[j][x]);
+	}
+
+	fputs("\033[25;1H", stdout);
+	fflush(stdout);
+}
+
+static void shutdownText(void)
+{
+	if (!started)
+		return;
+
+	fputs("\033[r\033[?25h\033[25;1H", stdout);
+	fflush(stdout);
+	started = 0;
+}
+
+const VideoBackend textVideo = { "text", 0, initText, presentText, NULL, shutdownText };
@@ -0,0 +1,90 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <string.h>
+#include "video.h"
+
+#ifdef _WIN32
+#define strcasecmp _stricmp
+#endif
+
+// Runs the emulator without showing anything, for scripted runs.
+const VideoBackend nullVideo = { "null", 0, NULL, NULL, NULL, NULL };
+
+static const VideoBackend *backends[] = { &sdlVideo, &nullVideo, &textVideo };
+static const VideoBackend *video = &sdlVideo;
+
+int setVideoBackend(const char *name)
+{
+	int i;
+
+	for (i = 0; i < (int)(sizeof(backends) / sizeof(backends[0])); i++)
+	{
+		if (!strcasecmp(backends[i]->name, name))
+		{
+			video = backends[i];
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+const VideoBackend *getVideoBackend(void)
+{
+	return video;
+}
+
+// Brings shown up to date with frame, leaving in from[j] and to[j] the
+// columns of row j that changed, the same when none did. Returns -1 when
+// the whole view is to be drawn again, otherwise how many lines it moved
+// down the history by if less than a screen. The rows of shown have then
+// moved up as many lines already, and the backend moves up what it showed
+// before drawing the changed cells.
+int compareFrame(Frame *shown, const Frame *frame, int *from, int *to)
+{
+	int shift = (int)(frame->topLine - shown->topLine), full = frame->redraws != shown->redraws, j;
+
+	if (full || shift <= 0 || shift >= 24)
+		shift = 0;
+
+	if (shift)
+		memmove(shown->cells[0], shown->cells[shift], (24 - shift) * 40);
+
+	for (j = 0; j < 24; j++)
+	{
+		from[j] = 0;
+		to[j] = 40;
+
+		if (full)
+			continue;
+
+		while (from[j] < 40 && frame->cells[j][from[j]] == shown->cells[j][from[j]])
+			from[j]++;
+
+		if (from[j] == 40)
+			continue;
+
+		while (frame->cells[j][to[j] - 1] == shown->cells[j][to[j] - 1])
+			to[j]--;
+	}
+
+	*shown = *frame;
+
+	return full ? -1 : shift;
+}
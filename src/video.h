@@ -0,0 +1,53 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef __VIDEO_H__
+#define __VIDEO_H__
+
+// The view as the UI thread saw it: the cells with the cursor in place, the
+// line of the history at the top and the settings to draw them with.
+// redraws counts the times the whole view has been asked for.
+typedef struct
+{
+	unsigned char cells[24][40];
+	unsigned int topLine, redraws;
+	int crt, scanlines;
+} Frame;
+
+// Where the screen goes. Every function may be left NULL: a backend without
+// present() is not even sent frames, and one without window runs SDL with
+// no video of its own. The frame passed to present() is only lent for the
+// call. resize() takes the window size asked for, or 0 by 0 for the size
+// the settings ask for, and returns 0 when it fails.
+typedef struct
+{
+	const char *name;
+	int window;
+	int (*init)(void);
+	void (*present)(const Frame *frame);
+	int (*resize)(int width, int height);
+	void (*shutdown)(void);
+} VideoBackend;
+
+extern const VideoBackend sdlVideo, nullVideo, textVideo;
+
+int setVideoBackend(const char *name);
+const VideoBackend *getVideoBackend(void);
+int compareFrame(Frame *shown, const Frame *frame, int *from, int *to);
+
+#endif
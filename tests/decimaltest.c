@@ -0,0 +1,306 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Checks ADC and SBC against the code they had before decimal mode went
+// through lookup tables. The tables from decimal.h are compared entry by
+// entry, then both instructions are run on a machine, interpreted and
+// translated, for every accumulator, operand and carry in binary and in
+// decimal mode, with V clear and set on entry.
+
+#include <stdio.h>
+#include <string.h>
+#include "SDL.h"
+#include "decimal.h"
+#include "m6502.h"
+#include "memory.h"
+
+#define N 0x80
+#define V 0x40
+#define D 0x08
+#define Z 0x02
+#define C 0x01
+
+#define VARIANTS 8
+#define OPERATION 0x030C
+#define RESULTS 0x2000
+#define FLAGS 0x2800
+
+// For the accumulator at $10, runs the operation at $030C on every operand
+// with each of the eight entry statuses at $20-$27. The results go to $2000
+// and the pushed statuses to $2800, a page per entry status.
+static const unsigned char program[] =
+{
+	0xA2, 0x00,		// 0300	LDX #$00
+	0xA0, 0x00,		// 0302	LDY #$00
+	0x84, 0x12,		// 0304	STY $12
+	0xB5, 0x20,		// 0306	LDA $20,X
+	0x48,			// 0308	PHA
+	0xA5, 0x10,		// 0309	LDA $10
+	0x28,			// 030B	PLP
+	0x65, 0x12,		// 030C	ADC $12
+	0x08,			// 030E	PHP
+	0x91, 0xF0,		// 030F	STA ($F0),Y
+	0x68,			// 0311	PLA
+	0x91, 0xF2,		// 0312	STA ($F2),Y
+	0xC8,			// 0314	INY
+	0xD0, 0xED,		// 0315	BNE $0304
+	0xE6, 0xF1,		// 0317	INC $F1
+	0xE6, 0xF3,		// 0319	INC $F3
+	0xE8,			// 031B	INX
+	0xE0, VARIANTS,		// 031C	CPX #$08
+	0xD0, 0xE2,		// 031E	BNE $0302
+	0x02			// 0320	KIL
+};
+
+static const unsigned char resetVector[] = { 0x00, 0x03 };
+
+static unsigned char accumulator, statusRegister;
+
+static void setStatusRegisterNZ(unsigned char val)
+{
+	if (val & 0x80)
+		statusRegister |= N;
+	else
+		statusRegister &= ~N;
+
+	if (!val)
+		statusRegister |= Z;
+	else
+		statusRegister &= ~Z;
+}
+
+static void setFlagCarry(unsigned short val)
+{
+	if (val & 0x100)
+		statusRegister |= C;
+	else
+		statusRegister &= ~C;
+}
+
+static void setFlagBorrow(unsigned short val)
+{
+	if (!(val & 0x100))
+		statusRegister |= C;
+	else
+		statusRegister &= ~C;
+}
+
+// ADC and SBC as they were before the tables, status register and all.
+static void ADC(unsigned short Op2)
+{
+	unsigned short Op1 = accumulator, tmp;
+
+	if (statusRegister & D)
+	{
+		if (!(Op1 + Op2 + (statusRegister & C ? 1 : 0) & 0xFF))
+			statusRegister |= Z;
+		else
+			statusRegister &= ~Z;
+
+		tmp = (Op1 & 0x0F) + (Op2 & 0x0F) + (statusRegister & C ? 1 : 0);
+		accumulator = tmp < 0x0A ? tmp : tmp + 6;
+		tmp = (Op1 & 0xF0) + (Op2 & 0xF0) + (tmp & 0xF0);
+
+		if (tmp & 0x80)
+			statusRegister |= N;
+		else
+			statusRegister &= ~N;
+
+		if ((Op1 ^ tmp) & ~(Op1 ^ Op2) & 0x80)
+			statusRegister |= V;
+		else
+			statusRegister &= ~V;
+
+		tmp = (accumulator & 0x0F) | (tmp < 0xA0 ? tmp : tmp + 0x60);
+
+		if (tmp & 0x100)
+			statusRegister |= C;
+		else
+			statusRegister &= ~C;
+
+		accumulator = tmp & 0xFF;
+	}
+	else
+	{
+		tmp = Op1 + Op2 + (statusRegister & C ? 1 : 0);
+		accumulator = tmp & 0xFF;
+
+		if ((Op1 ^ accumulator) & ~(Op1 ^ Op2) & 0x80)
+			statusRegister |= V;
+		else
+			statusRegister &= ~V;
+
+		setFlagCarry(tmp);
+		setStatusRegisterNZ(accumulator);
+	}
+}
+
+static void SBC(unsigned short Op2)
+{
+	unsigned short Op1 = accumulator, tmp;
+
+	if (statusRegister & D)
+	{
+		tmp = (Op1 & 0x0F) - (Op2 & 0x0F) - (statusRegister & C ? 0 : 1);
+		accumulator = !(tmp & 0x10) ? tmp : tmp - 6;
+		tmp = (Op1 & 0xF0) - (Op2 & 0xF0) - (accumulator & 0x10);
+		accumulator = (accumulator & 0x0F) | (!(tmp & 0x100) ? tmp : tmp - 0x60);
+		tmp = Op1 - Op2 - (statusRegister & C ? 0 : 1);
+		setFlagBorrow(tmp);
+		setStatusRegisterNZ((unsigned char)tmp);
+	}
+	else
+	{
+		tmp = Op1 - Op2 - (statusRegister & C ? 0 : 1);
+		accumulator = tmp & 0xFF;
+
+		if ((Op1 ^ Op2) & (Op1 ^ accumulator) & 0x80)
+			statusRegister |= V;
+		else
+			statusRegister &= ~V;
+
+		setFlagBorrow(tmp);
+		setStatusRegisterNZ(accumulator);
+	}
+}
+
+// Entry statuses: carry, V and decimal mode in every combination. N and Z
+// are set along with V to show they never leak through either.
+static unsigned char entryStatus(int variant)
+{
+	return (variant & 1 ? C : 0) | (variant & 2 ? N | V | Z : 0) | (variant & 4 ? D : 0);
+}
+
+// A table entry applied to the status the instruction started with. Decimal
+// SBC leaves V alone.
+static int checkTables(void)
+{
+	static const char *names[] = { "ADC", "SBC" };
+	unsigned short entry;
+	int i, variant, expected, found, failures = 0;
+
+	for (i = 0; i < 131072 * 2; i++)
+		for (variant = 0; variant < 4; variant += 2)
+		{
+			accumulator = (unsigned char)(i >> 8);
+			statusRegister = D | (i >> 16 & 1 ? C : 0) | entryStatus(variant);
+
+			if (i < 131072)
+			{
+				ADC(i & 0xFF);
+				entry = decimalAddTable[i];
+				found = entry >> 8 & (N | V | Z | C);
+			}
+			else
+			{
+				SBC(i & 0xFF);
+				entry = decimalSubtractTable[i - 131072];
+				found = (entry >> 8 & (N | Z | C)) | (statusRegister & V);
+			}
+
+			expected = accumulator << 8 | (statusRegister & (N | V | Z | C));
+			found |= (entry & 0xFF) << 8;
+
+			if (found != expected && failures++ < 10)
+				fprintf(stderr, "decimaltest: %s table, A=$%02X M=$%02X C=%d: $%04X instead of $%04X\n", names[i / 131072], i >> 8 & 0xFF, i & 0xFF, i >> 16 & 1, found, expected);
+		}
+
+	return failures;
+}
+
+static int runMachine(Machine *machine, unsigned char opcode, int jit)
+{
+	static const unsigned char pointers[] = { RESULTS & 0xFF, RESULTS >> 8, FLAGS & 0xFF, FLAGS >> 8 };
+	unsigned char statuses[VARIANTS], a;
+	const unsigned char *memory;
+	unsigned short address;
+	long long cycles;
+	int variant, m, failures = 0;
+
+	for (variant = 0; variant < VARIANTS; variant++)
+		statuses[variant] = entryStatus(variant);
+
+	setJit(machine, jit);
+	setMemory(machine, program, 0x0300, sizeof(program));
+	setMemory(machine, &opcode, OPERATION, 1);
+	setMemory(machine, statuses, 0x0020, VARIANTS);
+	setMemory(machine, resetVector, 0xFFFC, sizeof(resetVector));
+
+	a = 0;
+
+	do
+	{
+		setMemory(machine, &a, 0x0010, 1);
+		setMemory(machine, pointers, 0x00F0, sizeof(pointers));
+		resetM6502(machine);
+		startM6502(machine);
+
+		while (!getHalted(machine, &address, &cycles))
+			SDL_Delay(1);
+
+		stopM6502(machine);
+
+		if (address != 0x0320)
+			return fprintf(stderr, "decimaltest: halted at $%04X\n", address), 1;
+
+		memory = getMemory(machine);
+
+		for (variant = 0; variant < VARIANTS; variant++)
+			for (m = 0; m < 256; m++)
+			{
+				accumulator = a;
+				statusRegister = statuses[variant];
+
+				if (opcode == 0x65)
+					ADC(m);
+				else
+					SBC(m);
+
+				if ((memory[RESULTS + variant * 256 + m] != accumulator || (memory[FLAGS + variant * 256 + m] & (N | V | D | Z | C)) != statusRegister) && failures++ < 10)
+					fprintf(stderr, "decimaltest: %s%s, P=$%02X A=$%02X M=$%02X: A=$%02X P=$%02X instead of A=$%02X P=$%02X\n", opcode == 0x65 ? "ADC" : "SBC", jit ? " (jit)" : "", statuses[variant], a, m, memory[RESULTS + variant * 256 + m], memory[FLAGS + variant * 256 + m] & (N | V | D | Z | C), accumulator, statusRegister);
+			}
+	} while (++a);
+
+	return failures;
+}
+
+int main(int argc, char *argv[])
+{
+	Machine *machine;
+	int failures = checkTables();
+
+	machine = createMachine();
+
+	if (!machine)
+		return 1;
+
+	setSpeed(machine, 1000, 10);
+	setSpeedMultiplier(machine, 0);
+
+	failures += runMachine(machine, 0x65, 0);
+	failures += runMachine(machine, 0xE5, 0);
+	failures += runMachine(machine, 0x65, 1);
+	failures += runMachine(machine, 0xE5, 1);
+
+	destroyMachine(machine);
+
+	if (!failures)
+		printf("decimaltest: ADC and SBC match the original code in both modes\n");
+
+	return failures != 0;
+}
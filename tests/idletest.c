@@ -0,0 +1,101 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Leaves the CPU in the monitor's keyboard loop with an event scheduled
+// further ahead than a slice and no key coming. The loop has to be skipped
+// and the thread put to sleep until the event is due: paced, the event
+// still runs on time in emulated cycles and wall-clock time; unthrottled,
+// it runs at once instead of after the loop has been run out.
+
+#include <stdio.h>
+#include "SDL.h"
+#include "clock.h"
+#include "m6502.h"
+#include "memory.h"
+#include "scheduler.h"
+
+static const unsigned char program[] =
+{
+	0xAD, 0x11, 0xD0,	// 0300	LDA $D011
+	0x10, 0xFB		// 0303	BPL $0300
+};
+
+static const unsigned char resetVector[] = { 0x00, 0x03 };
+
+static volatile int fired;
+static long long firedCycle;
+
+static void recordEvent(Machine *machine, int data)
+{
+	firedCycle = getCycleCount(machine);
+	fired = 1;
+}
+
+static int runMachine(int multiplier, long long due)
+{
+	Machine *machine = createMachine();
+	long long start, nanos, skippedCycles, idleMillis;
+	unsigned int idleWaits;
+	int failures = 0;
+
+	if (!machine)
+		return 1;
+
+	setMemory(machine, program, 0x0300, sizeof(program));
+	setMemory(machine, resetVector, 0xFFFC, sizeof(resetVector));
+	setSpeed(machine, 1000, 10);
+	setSpeedMultiplier(machine, multiplier);
+	resetM6502(machine);
+	fired = 0;
+	scheduleEvent(machine, due, recordEvent, 0);
+
+	start = readClock();
+	startM6502(machine);
+
+	while (!fired)
+		SDL_Delay(1);
+
+	nanos = readClock() - start;
+	stopM6502(machine);
+	getIdleCounters(machine, &skippedCycles, &idleMillis, &idleWaits);
+	destroyMachine(machine);
+
+	printf("idletest: multiplier %d: event due at cycle %lld ran at %lld after %lld ms, %lld cycles skipped in %u waits\n", multiplier, due, firedCycle, nanos / 1000000, skippedCycles, idleWaits);
+
+	if (firedCycle < due || firedCycle > due + 16)
+		failures += fprintf(stderr, "idletest: multiplier %d: the event ran at cycle %lld instead of %lld\n", multiplier, firedCycle, due) > 0;
+	if (skippedCycles < due / 2 || !idleWaits)
+		failures += fprintf(stderr, "idletest: multiplier %d: the loop was not skipped\n", multiplier) > 0;
+	if (multiplier && nanos < due * 1000 * 3 / 4)
+		failures += fprintf(stderr, "idletest: multiplier %d: the event ran early, after %lld ms\n", multiplier, nanos / 1000000) > 0;
+
+	return failures;
+}
+
+int main(int argc, char *argv[])
+{
+	int failures = 0;
+
+	failures += runMachine(1, 200000);
+	failures += runMachine(0, 2000000000LL);
+
+	if (!failures)
+		printf("idletest: the keyboard loop sleeps until the next event\n");
+
+	return failures != 0;
+}
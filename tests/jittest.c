@@ -0,0 +1,329 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Runs random programs interpreted and translated and checks that both end
+// with the same registers, memory, device accesses, cycle count and number
+// of instructions. Each program is a loop of random loads, stores,
+// arithmetic, stack and flag instructions with forward branches, over RAM,
+// pages that ignore writes and a device page. The loop ends once reads from
+// $C1xx, which count down and stop at 0, reach 0. A program that stores
+// into its own code checks that translated blocks stop when overwritten.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+#include "m6502.h"
+#include "memory.h"
+
+#define PROGRAMS 300
+#define ITERATIONS 100
+#define CODE 0x2000
+
+typedef struct
+{
+	int state[6];
+	long long cycles, instructions;
+	unsigned int deviceSum;
+	unsigned short address;
+	unsigned char ram[0x2000];
+} Result;
+
+// Opcodes by length, without the ones that jump or halt.
+static const unsigned char implied[] =
+{
+	0x08, 0x0A, 0x18, 0x1A, 0x28, 0x2A, 0x38, 0x48, 0x4A, 0x58, 0x68, 0x6A, 0x78, 0x88,
+	0x8A, 0x98, 0x9A, 0xA8, 0xAA, 0xB8, 0xBA, 0xC8, 0xCA, 0xD8, 0xE8, 0xEA, 0xF8
+};
+
+static const unsigned char twoBytes[] =
+{
+	0x01, 0x05, 0x06, 0x09, 0x0B, 0x11, 0x15, 0x16, 0x21, 0x24, 0x25, 0x26, 0x29, 0x31,
+	0x35, 0x36, 0x41, 0x45, 0x46, 0x49, 0x51, 0x55, 0x56, 0x61, 0x65, 0x66, 0x69, 0x71,
+	0x75, 0x76, 0x81, 0x84, 0x85, 0x86, 0x91, 0x94, 0x95, 0x96, 0xA0, 0xA1, 0xA2, 0xA4,
+	0xA5, 0xA6, 0xA9, 0xB1, 0xB4, 0xB5, 0xB6, 0xC0, 0xC1, 0xC4, 0xC5, 0xC6, 0xC9, 0xD1,
+	0xD5, 0xD6, 0xE0, 0xE1, 0xE4, 0xE5, 0xE6, 0xE9, 0xEB, 0xF1, 0xF5, 0xF6
+};
+
+static const unsigned char threeBytes[] =
+{
+	0x0D, 0x0E, 0x19, 0x1D, 0x1E, 0x2C, 0x2D, 0x2E, 0x39, 0x3D, 0x3E, 0x4D, 0x4E, 0x59,
+	0x5D, 0x5E, 0x6D, 0x6E, 0x79, 0x7D, 0x7E, 0x8C, 0x8D, 0x8E, 0x99, 0x9D, 0xAC, 0xAD,
+	0xAE, 0xB9, 0xBC, 0xBD, 0xBE, 0xCC, 0xCD, 0xCE, 0xD9, 0xDD, 0xDE, 0xEC, 0xED, 0xEE,
+	0xF9, 0xFD, 0xFE
+};
+
+static const unsigned char branches[] = { 0x10, 0x30, 0x50, 0x70, 0x90, 0xB0, 0xD0, 0xF0 };
+
+// Stores the loop counter into the operand of the LDA that follows, so the
+// block holding both is overwritten on every pass.
+static const unsigned char selfModifying[] =
+{
+	0xA2, 0x00,		// 0300	LDX #$00
+	0x8A,			// 0302	TXA
+	0x8D, 0x07, 0x03,	// 0303	STA $0307
+	0xA9, 0x00,		// 0306	LDA #$00
+	0x9D, 0x00, 0x10,	// 0308	STA $1000,X
+	0xE8,			// 030B	INX
+	0xD0, 0xF4,		// 030C	BNE $0302
+	0x02			// 030E	KIL
+};
+
+static unsigned int deviceSum;
+static unsigned char countdown;
+
+static unsigned char readDevice(Machine *machine, unsigned short address)
+{
+	if (address >= 0xC100)
+		return countdown ? --countdown : 0;
+
+	return (unsigned char)(address ^ deviceSum);
+}
+
+static void writeDevice(Machine *machine, unsigned short address, unsigned char value)
+{
+	deviceSum = deviceSum * 31 + (address ^ value << 8);
+}
+
+static int nextRandom(unsigned int *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+
+	return *seed >> 16 & 0x7FFF;
+}
+
+// Absolute operands land in RAM, in pages that ignore writes or on the
+// device page.
+static unsigned short randomAddress(unsigned int *seed)
+{
+	static const unsigned char pages[] = { 0x00, 0x02, 0x10, 0x1F, 0x24, 0x2F, 0xC0 };
+
+	return pages[nextRandom(seed) % sizeof(pages)] << 8 | nextRandom(seed) & 0xFF;
+}
+
+// Writes a program of count instructions followed by the end of the loop.
+static void writeProgram(unsigned char *code, unsigned int *seed, int count)
+{
+	int offsets[64], lengths[64], i, target, kind;
+	unsigned short address;
+
+	for (i = 0; i < count; i++)
+	{
+		kind = nextRandom(seed) % 8;
+		offsets[i] = i ? offsets[i - 1] + lengths[i - 1] : 0;
+
+		if (kind == 0)
+		{
+			code[offsets[i]] = implied[nextRandom(seed) % sizeof(implied)];
+			lengths[i] = 1;
+		}
+		else if (kind == 1 && i + 1 < count)
+		{
+			code[offsets[i]] = branches[nextRandom(seed) % sizeof(branches)];
+			lengths[i] = 2;
+		}
+		else if (kind < 5)
+		{
+			code[offsets[i]] = twoBytes[nextRandom(seed) % sizeof(twoBytes)];
+			code[offsets[i] + 1] = (unsigned char)nextRandom(seed);
+			lengths[i] = 2;
+		}
+		else
+		{
+			address = randomAddress(seed);
+			code[offsets[i]] = threeBytes[nextRandom(seed) % sizeof(threeBytes)];
+			code[offsets[i] + 1] = (unsigned char)address;
+			code[offsets[i] + 2] = (unsigned char)(address >> 8);
+			lengths[i] = 3;
+		}
+	}
+
+	offsets[count] = offsets[count - 1] + lengths[count - 1];
+
+	// Branches skip up to three of the instructions after them.
+	for (i = 0; i < count; i++)
+		if (lengths[i] == 2 && (code[offsets[i]] & 0x1F) == 0x10)
+		{
+			target = i + 1 + nextRandom(seed) % 4;
+			code[offsets[i] + 1] = (unsigned char)(offsets[target < count ? target : count] - offsets[i] - 2);
+		}
+
+	i = offsets[count];
+	code[i++] = 0xAD;					// LDA $C100
+	code[i++] = 0x00;
+	code[i++] = 0xC1;
+	code[i++] = 0xF0;					// BEQ +3
+	code[i++] = 0x03;
+	code[i++] = 0x4C;					// JMP $2000
+	code[i++] = CODE & 0xFF;
+	code[i++] = CODE >> 8;
+	code[i] = 0x02;						// KIL
+}
+
+static int runProgram(Machine *machine, const int *state, Result *result)
+{
+	long long start = getElapsedCycles(machine), instructions = getInstructionCount(machine);
+	int *end;
+
+	deviceSum = 0;
+	countdown = ITERATIONS;
+
+	resetM6502(machine);
+	loadState(machine, (int *)state);
+	startM6502(machine);
+
+	while (!getHalted(machine, &result->address, &result->cycles))
+		SDL_Delay(1);
+
+	stopM6502(machine);
+
+	end = dumpState(machine);
+
+	if (!end)
+		return 0;
+
+	memcpy(result->state, end, sizeof(result->state));
+	free(end);
+
+	result->cycles -= start;
+	result->instructions = getInstructionCount(machine) - instructions;
+	result->deviceSum = deviceSum;
+	memcpy(result->ram, getMemory(machine), sizeof(result->ram));
+
+	return 1;
+}
+
+static Machine *createTestMachine(int jit)
+{
+	Machine *machine = createMachine();
+
+	if (!machine)
+		return NULL;
+
+	setJit(machine, jit);
+	setSpeed(machine, 1000, 10);
+	setSpeedMultiplier(machine, 0);
+	registerDevice(machine, 0xD0, 0xD0, NULL, NULL);
+	registerDevice(machine, 0xC0, 0xC1, readDevice, writeDevice);
+	setRam8k(machine, 1);
+
+	return machine;
+}
+
+static int compareResults(const char *name, const Result *interpreted, const Result *translated)
+{
+	static const char *registers[] = { "PC", "P", "A", "X", "Y", "S" };
+	int i;
+
+	for (i = 0; i < 6; i++)
+		if (interpreted->state[i] != translated->state[i])
+			return fprintf(stderr, "jittest: %s: %s is $%02X instead of $%02X\n", name, registers[i], translated->state[i], interpreted->state[i]), 1;
+
+	if (interpreted->address != translated->address)
+		return fprintf(stderr, "jittest: %s: halted at $%04X instead of $%04X\n", name, translated->address, interpreted->address), 1;
+	if (interpreted->cycles != translated->cycles)
+		return fprintf(stderr, "jittest: %s: %lld cycles instead of %lld\n", name, translated->cycles, interpreted->cycles), 1;
+	if (interpreted->instructions != translated->instructions)
+		return fprintf(stderr, "jittest: %s: %lld instructions instead of %lld\n", name, translated->instructions, interpreted->instructions), 1;
+	if (interpreted->deviceSum != translated->deviceSum)
+		return fprintf(stderr, "jittest: %s: the device saw different writes\n", name), 1;
+
+	for (i = 0; i < (int)sizeof(interpreted->ram); i++)
+		if (interpreted->ram[i] != translated->ram[i])
+			return fprintf(stderr, "jittest: %s: $%04X is $%02X instead of $%02X\n", name, i, translated->ram[i], interpreted->ram[i]), 1;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static unsigned char memory[0x3000];
+	static Result interpreted, translated;
+	Machine *machines[2];
+	unsigned int seed = 1;
+	int program, state[6], i, failures = 0;
+	char name[32];
+
+	machines[0] = createTestMachine(0);
+	machines[1] = createTestMachine(1);
+
+	if (!machines[0] || !machines[1])
+		return 1;
+
+	if (!getJit(machines[1]))
+	{
+		printf("jittest: no JIT on this platform\n");
+		return 77;
+	}
+
+	for (program = 0; program < PROGRAMS && failures < 5; program++)
+	{
+		for (i = 0; i < (int)sizeof(memory); i++)
+			memory[i] = (unsigned char)nextRandom(&seed);
+
+		writeProgram(&memory[CODE], &seed, 8 + nextRandom(&seed) % 48);
+
+		state[0] = CODE;
+		state[1] = nextRandom(&seed) & 0xFF;
+		state[2] = nextRandom(&seed) & 0xFF;
+		state[3] = nextRandom(&seed) & 0xFF;
+		state[4] = nextRandom(&seed) & 0xFF;
+		state[5] = nextRandom(&seed) & 0xFF;
+
+		sprintf(name, "program %d", program);
+
+		for (i = 0; i < 2; i++)
+		{
+			setMemory(machines[i], memory, 0x0000, sizeof(memory));
+
+			if (!runProgram(machines[i], state, i ? &translated : &interpreted))
+				return 1;
+		}
+
+		failures += compareResults(name, &interpreted, &translated);
+	}
+
+	// The self-modifying program runs from RAM, which it can write to.
+	for (i = 0; i < 2; i++)
+	{
+		setRam8k(machines[i], 0);
+		setMemory(machines[i], selfModifying, 0x0300, sizeof(selfModifying));
+		state[0] = 0x0300;
+
+		if (!runProgram(machines[i], state, i ? &translated : &interpreted))
+			return 1;
+	}
+
+	failures += compareResults("self-modifying program", &interpreted, &translated);
+
+	for (i = 0; i < 256; i++)
+		if (translated.ram[0x1000 + i] != i)
+		{
+			fprintf(stderr, "jittest: self-modifying program: $%04X is $%02X instead of $%02X\n", 0x1000 + i, translated.ram[0x1000 + i], i);
+			failures++;
+			break;
+		}
+
+	destroyMachine(machines[0]);
+	destroyMachine(machines[1]);
+
+	if (!failures)
+		printf("jittest: %d programs ran the same interpreted and translated\n", PROGRAMS + 1);
+
+	return failures != 0;
+}
@@ -0,0 +1,216 @@
+// Pom1 Apple 1 Emulator
+// Copyright (C) 2000 Verhille Arnaud
+// Copyright (C) 2012 John D. Corrado
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Runs the same program on several machines at once, each driven by its own
+// thread as the UI thread would drive it, and checks that every one ends up
+// exactly as a machine running it alone does. Each machine is given its own
+// seed, so one that saw another's memory, output or events would differ.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+#include "m6502.h"
+#include "memory.h"
+#include "pia6820.h"
+#include "terminal.h"
+
+#define MACHINES 8
+#define HISTORY 500
+
+// Prints 64 lines of 256 characters worked out from the seed at $0200,
+// which it increments after each line, keeps the last line in $1000-$10FF
+// and halts on a KIL with the final seed in A and X.
+static const unsigned char program[] =
+{
+	0xA9, 0xA7,		// 0300	LDA #$A7
+	0x8D, 0x13, 0xD0,	// 0302	STA $D013
+	0xA0, 0x40,		// 0305	LDY #$40
+	0xA2, 0x00,		// 0307	LDX #$00
+	0x8A,			// 0309	TXA
+	0x18,			// 030A	CLC
+	0x6D, 0x00, 0x02,	// 030B	ADC $0200
+	0x9D, 0x00, 0x10,	// 030E	STA $1000,X
+	0x29, 0x1F,		// 0311	AND #$1F
+	0x09, 0xC0,		// 0313	ORA #$C0
+	0x20, 0x2C, 0x03,	// 0315	JSR $032C
+	0xE8,			// 0318	INX
+	0xD0, 0xEE,		// 0319	BNE $0309
+	0xA9, 0x8D,		// 031B	LDA #$8D
+	0x20, 0x2C, 0x03,	// 031D	JSR $032C
+	0xEE, 0x00, 0x02,	// 0320	INC $0200
+	0x88,			// 0323	DEY
+	0xD0, 0xE1,		// 0324	BNE $0307
+	0xAD, 0x00, 0x02,	// 0326	LDA $0200
+	0xAA,			// 0329	TAX
+	0x18,			// 032A	CLC
+	0x02,			// 032B	KIL
+	0x2C, 0x12, 0xD0,	// 032C	BIT $D012
+	0x30, 0xFB,		// 032F	BMI $032C
+	0x8D, 0x12, 0xD0,	// 0331	STA $D012
+	0x60			// 0334	RTS
+};
+
+static const unsigned char resetVector[] = { 0x00, 0x03 };
+
+typedef struct
+{
+	unsigned char seed;
+	Machine *machine;
+	int state[6], halts, foreignEvents;
+	unsigned char memory[65536];
+	unsigned char rows[24 + HISTORY][40];
+	int history, cursorX, cursorY;
+} Run;
+
+static Run runs[MACHINES], alone[MACHINES];
+
+// Every machine has its own run to count its events in; an event from a
+// machine the run does not belong to is counted against it.
+static Run *findRun(Machine *machine)
+{
+	int i;
+
+	for (i = 0; i < MACHINES; i++)
+	{
+		if (runs[i].machine == machine)
+			return &runs[i];
+		if (alone[i].machine == machine)
+			return &alone[i];
+	}
+
+	return NULL;
+}
+
+static void countEvent(Machine *machine, int event)
+{
+	Run *run = findRun(machine);
+
+	if (!run)
+		fprintf(stderr, "machinetest: event %d from an unknown machine\n", event);
+	else if (run->machine != machine)
+		run->foreignEvents++;
+	else if (event == EVENT_HALT)
+		run->halts++;
+}
+
+static int runMachine(void *data)
+{
+	Run *run = (Run *)data;
+	Machine *machine = createMachine();
+	unsigned short address;
+	long long cycles;
+	int *state, y;
+
+	if (!machine)
+		return 1;
+
+	machine->notify = countEvent;
+	run->machine = machine;
+
+	setMemory(machine, &run->seed, 0x0200, 1);
+	setMemory(machine, program, 0x0300, sizeof(program));
+	setMemory(machine, resetVector, 0xFFFC, sizeof(resetVector));
+	setScrollback(machine, HISTORY);
+	setSpeed(machine, 1000, 10);
+	setSpeedMultiplier(machine, 0);
+	resetM6502(machine);
+	startM6502(machine);
+
+	while (!getHalted(machine, &address, &cycles))
+	{
+		updateTerminal(machine, PIA_RING_SIZE);
+		SDL_Delay(1);
+	}
+
+	while (updateTerminal(machine, PIA_RING_SIZE));
+
+	stopM6502(machine);
+
+	state = dumpState(machine);
+	memcpy(run->state, state, sizeof(run->state));
+	free(state);
+
+	memcpy(run->memory, getMemory(machine), sizeof(run->memory));
+	run->history = getTerminalHistory(machine);
+
+	for (y = -run->history; y < 24; y++)
+		memcpy(run->rows[y + run->history], getTerminalRow(machine, y), 40);
+
+	getTerminalCursor(machine, &run->cursorX, &run->cursorY);
+
+	return 0;
+}
+
+static int compareRuns(const Run *run, const Run *expected)
+{
+	if (run->halts != 1 || run->foreignEvents)
+		return fprintf(stderr, "machinetest: seed %d: %d halts, %d events from other machines\n", run->seed, run->halts, run->foreignEvents), 0;
+	if (memcmp(run->state, expected->state, sizeof(run->state)))
+		return fprintf(stderr, "machinetest: seed %d: CPU state differs\n", run->seed), 0;
+	if (memcmp(run->memory, expected->memory, sizeof(run->memory)))
+		return fprintf(stderr, "machinetest: seed %d: memory differs\n", run->seed), 0;
+	if (run->history != expected->history || run->cursorX != expected->cursorX || run->cursorY != expected->cursorY || memcmp(run->rows, expected->rows, sizeof(run->rows)))
+		return fprintf(stderr, "machinetest: seed %d: terminal differs\n", run->seed), 0;
+
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	SDL_Thread *threads[MACHINES];
+	int i, failed = 0;
+
+	// The reference: every seed on its own, one machine at a time.
+	for (i = 0; i < MACHINES; i++)
+	{
+		alone[i].seed = (unsigned char)(i * 37);
+
+		if (runMachine(&alone[i]))
+			return 1;
+	}
+
+	// Then all of them at once, each on its own thread.
+	for (i = 0; i < MACHINES; i++)
+	{
+		runs[i].seed = alone[i].seed;
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+		threads[i] = SDL_CreateThread(runMachine, "machine", &runs[i]);
+#else
+		threads[i] = SDL_CreateThread(runMachine, &runs[i]);
+#endif
+	}
+
+	for (i = 0; i < MACHINES; i++)
+		SDL_WaitThread(threads[i], NULL);
+
+	for (i = 0; i < MACHINES; i++)
+		if (!compareRuns(&alone[i], &alone[i]) || !compareRuns(&runs[i], &alone[i]))
+			failed = 1;
+
+	for (i = 0; i < MACHINES; i++)
+	{
+		destroyMachine(runs[i].machine);
+		destroyMachine(alone[i].machine);
+	}
+
+	if (!failed)
+		printf("machinetest: %d machines ran concurrently without interfering\n", MACHINES);
+
+	return failed;
+}